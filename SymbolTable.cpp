@@ -3,9 +3,12 @@
 
 SymbolTable symbolTable;
 
+extern bool semanticError;
+
 SymbolTable::SymbolTable()
 {
     enterScope(); // Start with global scope
+    taskFrames.push_back({0, {}, {}, {}});
 }
 
 void SymbolTable::enterScope()
@@ -23,7 +26,7 @@ void SymbolTable::exitScope()
     scopes.pop_back();
 }
 
-void SymbolTable::declare(const std::string &name, const std::string &type, int line)
+void SymbolTable::declare(std::string_view name, std::string_view type, int line, bool readOnly)
 {
     if (scopes.empty())
     {
@@ -31,39 +34,83 @@ void SymbolTable::declare(const std::string &name, const std::string &type, int
         return;
     }
     auto &currentScope = scopes.back();
-    if (currentScope.count(name) > 0)
+    if (currentScope.count(key(name)) > 0)
     {
-        std::cout << "Error at line no " << line << ": ";
+        std::cerr << "Error at line no " << line << ": ";
         // throw std::runtime_error("Variable '" + name + "' already declared in this scope.");
-        std::cerr << "Variable '" + name + "' already declared in this scope.\n";
+        std::cerr << "Variable '" << name << "' already declared in this scope.\n";
+        semanticError = true;
         return;
     }
-    currentScope.emplace(name, Symbol(name, type, line));
+    currentScope.emplace(std::string(name), Symbol(name, type, line, readOnly));
+    if (scopes.size() == 1)
+        declaredGlobals.emplace_back(name);
 }
 
-const Symbol &SymbolTable::lookup(const std::string &name) const
+const std::string &SymbolTable::key(std::string_view name) const
 {
+    keyBuffer.assign(name);
+    return keyBuffer;
+}
+
+const Symbol &SymbolTable::lookup(std::string_view name) const
+{
+    const std::string &key = this->key(name);
     for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
     {
-        auto found = it->find(name);
+        auto found = it->find(key);
         if (found != it->end())
         {
             return found->second;
         }
     }
-    throw std::runtime_error("Variable '" + name + "' not declared.");
+    throw std::runtime_error("Variable '" + std::string(name) + "' not declared.");
+}
+
+size_t SymbolTable::scopeOf(std::string_view name) const
+{
+    const std::string &key = this->key(name);
+    for (size_t i = scopes.size(); i-- > 0;)
+    {
+        if (scopes[i].count(key) > 0)
+            return i;
+    }
+    throw std::runtime_error("Variable '" + std::string(name) + "' not declared.");
 }
 
-bool SymbolTable::isDeclared(const std::string &name) const
+bool SymbolTable::isSharedInParallel(std::string_view name) const
+{
+    if (parallelScope == 0 || !isDeclared(name) || scopeOf(name) >= parallelScope)
+        return false;
+    const ParallelReduction *reduction = reductionOf(name);
+    return !reduction || reduction->scope != parallelScope;
+}
+
+const SymbolTable::ParallelReduction *SymbolTable::reductionOf(std::string_view name) const
+{
+    if (parallelReductions.empty() || !isDeclared(name))
+        return nullptr;
+    size_t scope = scopeOf(name);
+    for (auto reduction = parallelReductions.rbegin(); reduction != parallelReductions.rend(); ++reduction)
+    {
+        // A declaration inside the loop hides the reduced variable.
+        if (reduction->name == name && scope < reduction->scope)
+            return &*reduction;
+    }
+    return nullptr;
+}
+
+bool SymbolTable::isDeclared(std::string_view name) const
 {
     if (scopes.empty())
     {
         std::cout << "we are empty (isDeclared) \n"
                   << name << "\n";
     }
+    const std::string &key = this->key(name);
     for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
     {
-        if (it->count(name) > 0)
+        if (it->count(key) > 0)
         {
             return true;
         }
@@ -101,3 +148,50 @@ bool SymbolTable::isInsideLoop() const
 {
     return loopDepth > 0;
 }
+
+void SymbolTable::enterTask()
+{
+    taskFrames.push_back({scopes.size(), {}, {}, {}});
+}
+
+SymbolTable::TaskFrame SymbolTable::exitTask()
+{
+    TaskFrame frame = taskFrames.back();
+    taskFrames.pop_back();
+    return frame;
+}
+
+static bool noteAccess(SymbolTable &symbols, std::string_view name, int line, bool write)
+{
+    if (!symbols.isDeclared(name))
+        return true;
+    size_t scope = symbols.scopeOf(name);
+
+    // Walk outwards while the variable lives outside the frame: each frame
+    // it escapes captures it, and must not race with its siblings.
+    for (size_t i = symbols.taskFrames.size(); i-- > 0;)
+    {
+        SymbolTable::TaskFrame &frame = symbols.taskFrames[i];
+        if (!frame.pendingWrites.empty() && frame.pendingWrites.count(std::string(name)))
+        {
+            std::cerr << "Line " << line << ": '" << name << "' is written by a spawned block; "
+                      << (write ? "writing" : "reading") << " it needs a sync first\n";
+            semanticError = true;
+            return false;
+        }
+        if (scope >= frame.scope)
+            break;
+        (write ? frame.writes : frame.reads).emplace(name);
+    }
+    return true;
+}
+
+bool SymbolTable::noteRead(std::string_view name, int line)
+{
+    return noteAccess(*this, name, line, false);
+}
+
+bool SymbolTable::noteWrite(std::string_view name, int line)
+{
+    return noteAccess(*this, name, line, true);
+}
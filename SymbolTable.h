@@ -1,10 +1,14 @@
 #pragma once
+#include <set>
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include <iostream>
 
+class ASTNode;
+
 // Represents a declared variable
 class Symbol
 {
@@ -12,9 +16,10 @@ public:
     std::string name;
     std::string type;
     int lineDeclared;
+    bool readOnly = false; // loop variables
 
-    Symbol(const std::string &name, const std::string &type, int lineDeclared)
-        : name(name), type(type), lineDeclared(lineDeclared) {}
+    Symbol(std::string_view name, std::string_view type, int lineDeclared, bool readOnly = false)
+        : name(name), type(type), lineDeclared(lineDeclared), readOnly(readOnly) {}
 };
 
 // Symbol table supporting nested scopes
@@ -30,16 +35,98 @@ public:
     void exitLoop();
     bool isInsideLoop() const;
 
-    void declare(const std::string &name, const std::string &type, int line);
-    const Symbol &lookup(const std::string &name) const;
-    bool isDeclared(const std::string &name) const;
+    // Names are copied in: the table outlives the tree and source they
+    // come from.
+    void declare(std::string_view name, std::string_view type, int line, bool readOnly = false);
+    const Symbol &lookup(std::string_view name) const;
+    bool isDeclared(std::string_view name) const;
+
+    // Index of the innermost scope declaring name (0 is global); throws like
+    // lookup when it is not declared.
+    size_t scopeOf(std::string_view name) const;
+    size_t depth() const { return scopes.size(); }
+
+    // The global scope, as a library interface records it.
+    const std::unordered_map<std::string, Symbol> &globals() const { return scopes.front(); }
+    // Its names in the order they were declared.
+    const std::vector<std::string> &globalOrder() const { return declaredGlobals; }
+
+    // Whether writing name from here would race with other iterations of the
+    // enclosing parallel repeat: it lives outside the loop and is not one of
+    // the loop's reductions.
+    bool isSharedInParallel(std::string_view name) const;
+
+    // A variable listed in reduce(...) of an enclosing parallel repeat holds
+    // a partial result of each thread inside the loop.
+    struct ParallelReduction
+    {
+        std::string name;
+        std::string op; // as written: +, *, min or max
+        size_t scope;   // the parallelScope of its loop
+    };
+
+    // The reduction name stands for from here, of whichever enclosing
+    // parallel repeat lists it, or null.
+    const ParallelReduction *reductionOf(std::string_view name) const;
 
     void print() const;
 
     int loopDepth = 0; // For tracking loop depth
 
+    // Innermost parallel repeat: scopes below parallelScope are shared between
+    // its iterations (0 outside any parallel loop).
+    size_t parallelScope = 0;
+    int parallelLoopDepth = 0;
+    std::vector<ParallelReduction> parallelReductions; // of every enclosing loop, innermost last
+    // While an assignment to a reduced variable s is analyzed: the read of s
+    // its update `s = s op e` makes, or s when the write was already
+    // reported for not having that form.
+    const ASTNode *reductionRead = nullptr;
+    std::string_view reductionReported;
+
+    // Code that may run concurrently with its parent: the program itself, a
+    // spawn block or a parallel repeat body. reads/writes collect the
+    // variables declared outside the frame that it uses; pendingWrites holds
+    // what the frame's own unsynced spawn blocks write.
+    struct TaskFrame
+    {
+        size_t scope; // scopes from here on belong to the frame
+        std::set<std::string> reads, writes, pendingWrites;
+    };
+    std::vector<TaskFrame> taskFrames;
+
+    // Element type of each enclosing generator body, innermost last; empty
+    // until its first yield fixes it.
+    std::vector<std::string> generatorYields;
+
+    // Blocks whose allocations are released when they exit, innermost last;
+    // temporaries counts the allocation sites that use the block's region.
+    // A generator body pushes an entry without a counter: it can suspend in
+    // the middle of a block, so everything it allocates is global.
+    struct Region
+    {
+        size_t scope;
+        int *temporaries;
+    };
+    std::vector<Region> regions;
+
+    void enterTask();
+    TaskFrame exitTask();
+
+    // Record a use of name and report (returning false) a use that races with
+    // an unsynced spawn block.
+    bool noteRead(std::string_view name, int line);
+    bool noteWrite(std::string_view name, int line);
+
 private:
+    // name as a key of scopes. The maps cannot be searched by string_view,
+    // and a name longer than std::string keeps inline would otherwise cost
+    // an allocation per lookup; this buffer keeps its capacity instead.
+    const std::string &key(std::string_view name) const;
+
     std::vector<std::unordered_map<std::string, Symbol>> scopes;
+    std::vector<std::string> declaredGlobals;
+    mutable std::string keyBuffer;
 };
 
 // Global instance of the symbol table
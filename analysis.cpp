@@ -0,0 +1,1060 @@
+#include "ast.h"
+#include "ast_interface.h"
+#include "SymbolTable.h"
+#include "builtins.h"
+#include "types.h"
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+
+using namespace std;
+
+bool semanticError = false;
+unique_ptr<ProgramNode> astRoot = nullptr;
+
+//---Symanitc Analysis---
+
+// Value of the digits of an integer literal.
+static unsigned long long literalMagnitude(string_view digits)
+{
+    unsigned long long magnitude = 0;
+    from_chars(digits.data(), digits.data() + digits.size(), magnitude);
+    return magnitude;
+}
+
+// If expr is an integer literal, possibly negated, report its value.
+static bool integerLiteral(ASTNode *expr, bool &negative, unsigned long long &magnitude, LiteralNode *&literal)
+{
+    negative = false;
+    if (auto *unary = dynamic_cast<UnaryExprNode *>(expr))
+    {
+        if (unary->op != UnaryExprNode::Op::Minus)
+            return false;
+        negative = true;
+        expr = unary->operand.get();
+    }
+    literal = dynamic_cast<LiteralNode *>(expr);
+    if (!literal || literal->type != LiteralNode::Type::Int)
+        return false;
+    magnitude = literalMagnitude(literal->value);
+    return true;
+}
+
+// Give an integer literal the type its context expects when the value fits,
+// so `int8 x = 5` and `x + 1` need no conversion.
+static bool adoptIntegerType(ASTNode *expr, string_view type)
+{
+    bool negative;
+    unsigned long long magnitude;
+    LiteralNode *literal;
+    if (!isIntegerType(type) || !integerLiteral(expr, negative, magnitude, literal))
+        return false;
+    if (!integerFits(negative, magnitude, type))
+        return false;
+    literal->intType = type;
+    return true;
+}
+
+// How the body of a parallel repeat may update a variable it reduces with op.
+static string reductionForm(string_view name, string_view op)
+{
+    string var(name);
+    if (op == "min" || op == "max")
+        return var + " = " + string(op) + "(" + var + ", e)";
+    return var + " = " + var + " " + string(op) + " e";
+}
+
+// The common type of integer operands of types a and b (promoteIntTypes), or
+// empty after reporting that there is none.
+static string commonIntType(string_view a, string_view b, int line)
+{
+    string type = promoteIntTypes(a, b);
+    if (type.empty())
+    {
+        cerr << "Line " << line << ": no integer type holds every value of both '" << a << "' and '" << b
+             << "'\n";
+        semanticError = true;
+    }
+    return type;
+}
+
+// Report a write to name that is not allowed from the current statement.
+// update is the reduction operator the write combines the old value with,
+// when it has that form: each thread of a parallel repeat holds a partial
+// result of its reductions, which only such an update keeps meaningful.
+static void checkWritable(SymbolTable &symbols, string_view name, int line, string_view update = {})
+{
+    if (!symbols.isDeclared(name))
+        return;
+    symbols.noteWrite(name, line);
+    const SymbolTable::ParallelReduction *reduction = symbols.reductionOf(name);
+    if (symbols.lookup(name).readOnly)
+    {
+        cerr << "Line " << line << ": '" << name << "' is read-only\n";
+        semanticError = true;
+    }
+    else if (reduction && reduction->op != update)
+    {
+        cerr << "Line " << line << ": '" << name << "' is reduced with " << reduction->op
+             << "; the parallel repeat can only update it as '" << reductionForm(name, reduction->op) << "'\n";
+        semanticError = true;
+    }
+    else if (symbols.isSharedInParallel(name))
+    {
+        cerr << "Line " << line << ": '" << name << "' is shared by all iterations of the parallel repeat; "
+             << "declare it inside the loop or list it in reduce(...)\n";
+        semanticError = true;
+    }
+}
+
+// Escape analysis for strings. An allocation starts out temporary when the
+// innermost region can hold it: as an operand or argument its value is used
+// up before the block exits. Only a store can make it escape.
+static bool claimTemporary(SymbolTable &symbols)
+{
+    if (symbols.regions.empty() || !symbols.regions.back().temporaries)
+        return false;
+    ++*symbols.regions.back().temporaries;
+    return true;
+}
+
+// Whether the innermost region belongs to the block of scope.
+static bool isRegionScope(const SymbolTable &symbols, size_t scope)
+{
+    return !symbols.regions.empty() && symbols.regions.back().temporaries &&
+           symbols.regions.back().scope == scope;
+}
+
+// The temporary flag of expr if it allocates a string, else null.
+static bool *allocationFlag(ASTNode *expr)
+{
+    if (auto *binary = dynamic_cast<BinaryExprNode *>(expr))
+        return binary->op == BinaryExprNode::Op::Add ? &binary->temporary : nullptr;
+    if (auto *call = dynamic_cast<BuiltinCallNode *>(expr))
+        return &call->temporary;
+    return nullptr;
+}
+
+// A string stored into a variable of scope must outlive the innermost region
+// unless the variable belongs to that region's block. An allocation stored
+// further out is made global; a variable declared further in than the target
+// may hold a temporary, so its value is promoted.
+static void checkEscape(SymbolTable &symbols, ASTNode *value, size_t scope, bool &promote)
+{
+    promote = false;
+    if (bool *temporary = allocationFlag(value))
+    {
+        if (*temporary && !isRegionScope(symbols, scope))
+        {
+            *temporary = false;
+            --*symbols.regions.back().temporaries;
+        }
+        return;
+    }
+    if (dynamic_cast<LiteralNode *>(value))
+        return;
+    auto *source = dynamic_cast<IdentifierNode *>(value);
+    promote = !source || !symbols.isDeclared(source->name) || symbols.scopeOf(source->name) > scope;
+}
+
+string ImportNode::analyze(SymbolTable &symbols)
+{
+    if (!exports)
+    {
+        cerr << "Line " << lineNumber << ": import of \"" << path << "\" was not resolved\n";
+        semanticError = true;
+        return "void";
+    }
+    for (const Symbol &symbol : *exports)
+    {
+        // Importing a library again, here or in an earlier file of the
+        // program, declares nothing new.
+        if (symbols.isDeclared(symbol.name) && symbols.scopeOf(symbol.name) == 0)
+        {
+            const Symbol &known = symbols.lookup(symbol.name);
+            if (known.type == symbol.type && known.lineDeclared == symbol.lineDeclared)
+                continue;
+        }
+        symbols.declare(symbol.name, symbol.type, symbol.lineDeclared, symbol.readOnly);
+    }
+    return "void";
+}
+
+string BreakNode::analyze(SymbolTable &symbols)
+{
+    if (symbols.loopDepth == 0)
+    {
+        cerr << "Semantic Error at line " << line << ": 'stop' used outside of loop.\n";
+        semanticError = true;
+    }
+    else if (symbols.parallelScope != 0 && symbols.loopDepth == symbols.parallelLoopDepth)
+    {
+        cerr << "Semantic Error at line " << line << ": 'stop' cannot leave a parallel repeat.\n";
+        semanticError = true;
+    }
+    return "void";
+}
+
+string ContinueNode::analyze(SymbolTable &symbols)
+{
+    if (symbols.loopDepth == 0)
+    {
+        cerr << "Semantic Error at line " << line << ": 'skip' used outside of loop.\n";
+        semanticError = true;
+    }
+    return "void";
+}
+
+string LiteralNode::analyze(SymbolTable &symbols)
+{
+    switch (type)
+    {
+    case Type::Int:
+    {
+        // Unsuffixed literals are int unless the value needs 64 bits.
+        unsigned long long magnitude = literalMagnitude(value);
+        if (integerFits(false, magnitude, "int"))
+            intType = "int";
+        else if (integerFits(false, magnitude, "int64"))
+            intType = "int64";
+        else
+            intType = "uint64";
+        return intType;
+    }
+    case Type::Float:
+        return "float";
+    case Type::String:
+        return "string";
+    case Type::Char:
+        return "char";
+    case Type::Bool:
+        return "bool";
+    }
+    return "unknown";
+}
+
+string IdentifierNode::analyze(SymbolTable &symbols)
+{
+    try
+    {
+        const Symbol &result = symbols.lookup(name);
+        type = result.type;
+        symbols.noteRead(name, lineNumber);
+        const SymbolTable::ParallelReduction *reduction = symbols.reductionOf(name);
+        if (reduction && symbols.reductionRead != this && symbols.reductionReported != name)
+        {
+            // It holds this thread's partial result, not the variable's value.
+            cerr << "Line " << lineNumber << ": '" << name << "' is reduced with " << reduction->op
+                 << "; the parallel repeat cannot read it except in '" << reductionForm(name, reduction->op)
+                 << "'\n";
+            semanticError = true;
+        }
+        if (isGeneratorType(type))
+        {
+            cerr << "Line " << lineNumber << ": generator '" << name
+                 << "' can only be used in `repeat <var> in " << name << "`\n";
+            semanticError = true;
+            return "error";
+        }
+        return result.type;
+    }
+    catch (const runtime_error &e)
+    {
+        cerr << "Error: " << e.what() << "\n";
+        semanticError = true;
+        return "error";
+    }
+}
+
+string DeclarationNode::analyze(SymbolTable &symbols)
+{
+    string exprType = expr->analyze(symbols);
+    if (exprType != typeName && adoptIntegerType(expr.get(), typeName))
+        exprType = typeName;
+    this->exprType = exprType;
+    if (!isImplicitlyConvertible(exprType, typeName))
+    {
+        cerr << "Type mismatch in declaration of '" << identifier
+             << "': expected " << typeName << ", got " << exprType << "\n";
+        semanticError = true;
+    }
+    if (typeName == "string")
+        checkEscape(symbols, expr.get(), symbols.depth() - 1, promote);
+    symbols.declare(identifier, typeName, lineNumber);
+    return "void";
+}
+
+// The read of name in value when value is `name op e` (or `e op name` for
+// + and *), or min/max(name, e) in either order, else null.
+static ASTNode *reductionUpdate(ASTNode *value, string_view name, string_view op)
+{
+    auto isName = [&](const ASTNodePtr &expr)
+    {
+        auto *identifier = dynamic_cast<IdentifierNode *>(expr.get());
+        return identifier && identifier->name == name;
+    };
+    ASTNode *left = nullptr, *right = nullptr;
+    if (auto *binary = dynamic_cast<BinaryExprNode *>(value))
+    {
+        if ((op == "+" && binary->op == BinaryExprNode::Op::Add) || (op == "*" && binary->op == BinaryExprNode::Op::Mul))
+        {
+            left = isName(binary->left) ? binary->left.get() : nullptr;
+            right = isName(binary->right) ? binary->right.get() : nullptr;
+        }
+    }
+    else if (auto *call = dynamic_cast<BuiltinCallNode *>(value))
+    {
+        if (call->funcName == op && call->args.size() == 2)
+        {
+            left = isName(call->args[0]) ? call->args[0].get() : nullptr;
+            right = isName(call->args[1]) ? call->args[1].get() : nullptr;
+        }
+    }
+    return left ? left : right;
+}
+
+string AssignmentNode::analyze(SymbolTable &symbols)
+{
+    try
+    {
+        const Symbol &declaredSymbol = symbols.lookup(name);
+        const SymbolTable::ParallelReduction *reduction = symbols.reductionOf(name);
+        ASTNode *read = reduction ? reductionUpdate(value.get(), name, reduction->op) : nullptr;
+        checkWritable(symbols, name, lineNumber, read ? string_view(reduction->op) : string_view());
+        symbols.reductionRead = read;
+        if (reduction && !read)
+            symbols.reductionReported = name;
+        string valueType = value->analyze(symbols);
+        symbols.reductionRead = nullptr;
+        symbols.reductionReported = {};
+        if (valueType != declaredSymbol.type && adoptIntegerType(value.get(), declaredSymbol.type))
+            valueType = declaredSymbol.type;
+        this->valueType = valueType;
+        this->targetType = declaredSymbol.type;
+
+        if (!isImplicitlyConvertible(valueType, declaredSymbol.type))
+        {
+            cerr << "Type mismatch in assignment to '" << name
+                 << "': expected " << declaredSymbol.type << ", got " << valueType << "\n";
+            semanticError = true;
+        }
+        if (targetType == "string")
+            checkEscape(symbols, value.get(), symbols.scopeOf(name), promote);
+
+        return "void";
+    }
+    catch (const runtime_error &e)
+    {
+        symbols.reductionRead = nullptr;
+        symbols.reductionReported = {};
+        cerr << "Error: " << e.what() << "\n";
+        semanticError = true;
+        return "error";
+    }
+}
+
+string InputStmtNode::analyze(SymbolTable &symbols)
+{
+    size_t scope = symbols.isDeclared(varName) ? symbols.scopeOf(varName) : symbols.depth() - 1;
+    temporary = inputType == "string" && isRegionScope(symbols, scope) && claimTemporary(symbols);
+    try
+    {
+        const Symbol &declared = symbols.lookup(varName);
+        checkWritable(symbols, varName, lineNumber);
+        if (declared.type != inputType)
+        {
+            cerr << "Line " << lineNumber << ": input(" << inputType << ") assigned to '" << varName
+                 << "' of type " << declared.type << "\n";
+            semanticError = true;
+        }
+    }
+    catch (const std::runtime_error &)
+    {
+        // Not declared yet, declare with the type being read
+        symbols.declare(varName, inputType, lineNumber);
+    }
+    return "void";
+}
+
+string OutputNode::analyze(SymbolTable &)
+{
+    return "void";
+}
+
+string BinaryExprNode::analyze(SymbolTable &symbols)
+{
+    temporary = false;
+    string leftType = left->analyze(symbols);
+    string rightType = right->analyze(symbols);
+
+    // An integer literal takes the type of the other operand when it fits.
+    if (leftType != rightType && isIntegerType(leftType) && isIntegerType(rightType))
+    {
+        if (adoptIntegerType(right.get(), leftType))
+            rightType = leftType;
+        else if (adoptIntegerType(left.get(), rightType))
+            leftType = rightType;
+    }
+    this->leftType = leftType;
+    this->rightType = rightType;
+
+    if (isIntegerType(leftType) && isIntegerType(rightType))
+    {
+        operandType = commonIntType(leftType, rightType, lineNumber);
+        if (operandType.empty())
+            return "error";
+    }
+    else if (leftType != rightType)
+    {
+        cerr << "Type mismatch in binary expression: " << leftType << " vs " << rightType << "\n";
+        semanticError = true;
+        return "error";
+    }
+    else
+    {
+        operandType = leftType;
+    }
+
+    switch (op)
+    {
+    case Op::Add:
+        if (operandType == "string")
+        {
+            temporary = claimTemporary(symbols); // concatenation
+            return operandType;
+        }
+        [[fallthrough]];
+    case Op::Sub:
+    case Op::Mul:
+    case Op::Div:
+        if (!isNumericType(operandType))
+        {
+            cerr << "Line " << lineNumber << ": Arithmetic requires integer or float operands, got '" << operandType << "'\n";
+            semanticError = true;
+            return "error";
+        }
+        return operandType;
+
+    case Op::Eq:
+    case Op::Neq:
+    case Op::Lt:
+    case Op::Gt:
+    case Op::Leq:
+    case Op::Geq:
+        return "bool";
+
+    case Op::And:
+    case Op::Or:
+        if (leftType != "bool")
+        {
+            cerr << "Logical operators require boolean types\n";
+            semanticError = true;
+        }
+        return "bool";
+    }
+    return "error";
+}
+
+string UnaryExprNode::analyze(SymbolTable &symbols)
+{
+    string operandType = operand->analyze(symbols);
+    if (op == Op::Not && operandType != "bool")
+    {
+        cerr << "Error: 'not' operator requires a boolean operand\n";
+        semanticError = true;
+        return "error";
+    }
+    if (op == Op::Minus && !isNumericType(operandType))
+    {
+        cerr << "Error: '-' operator requires an integer or float operand\n";
+        semanticError = true;
+        return "error";
+    }
+    return operandType;
+}
+
+string BlockNode::analyze(SymbolTable &symbols)
+{
+    symbols.enterScope();
+    temporaries = 0;
+    bool region = symbols.generatorYields.empty(); // see SymbolTable::regions
+    if (region)
+        symbols.regions.push_back({symbols.depth() - 1, &temporaries});
+    for (const auto &stmt : statements)
+    {
+        stmt->analyze(symbols);
+    }
+    // symbols.print();
+    if (region)
+        symbols.regions.pop_back();
+    symbols.exitScope();
+    return "void";
+}
+
+string ProgramNode::analyze(SymbolTable &symbols)
+{
+    // symbols.enterScope();
+    for (const auto &stmt : statements)
+    {
+        stmt->analyze(symbols);
+    }
+    // symbols.exitScope();
+    symbols.taskFrames.front().pendingWrites.clear(); // implicit sync at the end
+    return "void";
+}
+
+string IfStmtNode::analyze(SymbolTable &symbols)
+{
+    string condType = condition->analyze(symbols);
+    if (condType != "bool")
+    {
+        cerr << "Line " << lineNumber << ": Condition in if statement must be of type 'bool', got '" << condType << "'\n";
+        semanticError = true;
+    }
+
+    // A sync in one branch does not cover the other: afterwards, pending is
+    // whatever either branch left pending.
+    set<string> pendingBefore = symbols.taskFrames.back().pendingWrites;
+
+    // symbols.enterScope();
+    thenBlock->analyze(symbols);
+    // symbols.exitScope();
+    set<string> pendingThen = symbols.taskFrames.back().pendingWrites;
+    symbols.taskFrames.back().pendingWrites = pendingBefore;
+
+    if (elseBlock)
+    {
+        // symbols.enterScope();
+        elseBlock->analyze(symbols);
+        // symbols.exitScope();
+    }
+    symbols.taskFrames.back().pendingWrites.insert(pendingThen.begin(), pendingThen.end());
+
+    return "void";
+}
+
+string MatchNode::analyze(SymbolTable &symbols)
+{
+    subjectType = subject->analyze(symbols);
+    bool integer = isIntegerType(subjectType);
+    if (!integer)
+    {
+        cerr << "Line " << lineNumber << ": match needs an integer value, got '" << subjectType << "'\n";
+        semanticError = true;
+    }
+
+    map<unsigned long long, int> seen; // label value -> line of the arm listing it
+    for (auto &arm : arms)
+    {
+        arm.values.clear();
+        for (const auto &label : arm.labels)
+        {
+            bool negative;
+            unsigned long long magnitude;
+            LiteralNode *literal;
+            if (!integerLiteral(label.get(), negative, magnitude, literal))
+            {
+                cerr << "Line " << arm.line << ": match labels must be integer constants\n";
+                semanticError = true;
+                continue;
+            }
+            string text = (negative ? "-" : "") + string(literal->value);
+            if (integer && !integerFits(negative, magnitude, subjectType))
+            {
+                cerr << "Line " << arm.line << ": match label " << text << " is out of range for '" << subjectType
+                     << "'\n";
+                semanticError = true;
+                continue;
+            }
+            unsigned long long value = negative ? 0 - magnitude : magnitude;
+            auto inserted = seen.emplace(value, arm.line);
+            if (!inserted.second)
+            {
+                cerr << "Line " << arm.line << ": duplicate match label " << text << " (already listed on line "
+                     << inserted.first->second << ")\n";
+                semanticError = true;
+                continue;
+            }
+            arm.values.push_back(value);
+        }
+    }
+
+    // As for if: afterwards, pending is whatever any path left pending, and
+    // without an else one path runs no arm at all.
+    set<string> pendingBefore = symbols.taskFrames.back().pendingWrites;
+    set<string> pendingAfter;
+    if (!elseBlock)
+        pendingAfter = pendingBefore;
+    auto analyzeBranch = [&](ASTNode *body)
+    {
+        symbols.taskFrames.back().pendingWrites = pendingBefore;
+        body->analyze(symbols);
+        const set<string> &left = symbols.taskFrames.back().pendingWrites;
+        pendingAfter.insert(left.begin(), left.end());
+    };
+    for (auto &arm : arms)
+        analyzeBranch(arm.body.get());
+    if (elseBlock)
+        analyzeBranch(elseBlock.get());
+    symbols.taskFrames.back().pendingWrites = pendingAfter;
+
+    return "void";
+}
+
+// A block spawned in a loop body that writes a variable and is not synced
+// before the next iteration would race with its own next instance.
+static void checkLoopSpawns(SymbolTable &symbols, const set<string> &pendingBefore, int line)
+{
+    set<string> &pending = symbols.taskFrames.back().pendingWrites;
+    for (const auto &name : pending)
+    {
+        if (!pendingBefore.count(name))
+        {
+            cerr << "Line " << line << ": a block spawned in this loop writes '" << name
+                 << "'; sync before the end of the loop body\n";
+            semanticError = true;
+        }
+    }
+    pending.insert(pendingBefore.begin(), pendingBefore.end());
+}
+
+string RepeatStmtNode::analyze(SymbolTable &symbols)
+{
+    string condType = condition->analyze(symbols);
+    if (condType != "bool")
+    {
+        cerr << "Line " << lineNumber << ": Condition in repeat statement must be of type 'bool', got '" << condType << "'\n";
+        semanticError = true;
+    }
+
+    set<string> pendingBefore = symbols.taskFrames.back().pendingWrites;
+
+    symbols.enterLoop();
+    // symbols.enterScope();
+    body->analyze(symbols);
+    // symbols.exitScope();
+    symbols.exitLoop();
+
+    checkLoopSpawns(symbols, pendingBefore, lineNumber);
+
+    return "void";
+}
+
+string RepeatRangeNode::analyze(SymbolTable &symbols)
+{
+    loType = lo->analyze(symbols);
+    hiType = hi->analyze(symbols);
+    if (!isIntegerType(loType) || !isIntegerType(hiType))
+    {
+        cerr << "Line " << lineNumber << ": repeat range must be integers, got " << loType << ".." << hiType << "\n";
+        semanticError = true;
+    }
+    else
+    {
+        // A literal bound takes the type of the other one.
+        if (adoptIntegerType(lo.get(), hiType))
+            loType = hiType;
+        else if (adoptIntegerType(hi.get(), loType))
+            hiType = loType;
+        string common = commonIntType(loType, hiType, lineNumber);
+        if (!common.empty())
+            indexType = common;
+    }
+
+    if (step)
+    {
+        // A constant step is what makes the trip count computable up front.
+        LiteralNode *literal;
+        if (!integerLiteral(step.get(), descending, stepSize, literal))
+        {
+            cerr << "Line " << lineNumber << ": repeat step must be an integer constant\n";
+            semanticError = true;
+        }
+        else if (stepSize == 0 || !integerFits(false, stepSize, indexType))
+        {
+            cerr << "Line " << lineNumber << ": repeat step " << (descending ? "-" : "") << literal->value
+                 << " is zero or out of range for '" << indexType << "'\n";
+            semanticError = true;
+        }
+    }
+
+    set<string> pendingBefore = symbols.taskFrames.back().pendingWrites;
+
+    symbols.enterScope();
+    symbols.declare(var, indexType, lineNumber, true);
+    symbols.enterLoop();
+    body->analyze(symbols);
+    symbols.exitLoop();
+    symbols.exitScope();
+
+    checkLoopSpawns(symbols, pendingBefore, lineNumber);
+    return "void";
+}
+
+static const char *reduceOpName(ParallelRepeatNode::ReduceOp op)
+{
+    switch (op)
+    {
+    case ParallelRepeatNode::ReduceOp::Add:
+        return "+";
+    case ParallelRepeatNode::ReduceOp::Mul:
+        return "*";
+    case ParallelRepeatNode::ReduceOp::Min:
+        return "min";
+    case ParallelRepeatNode::ReduceOp::Max:
+        return "max";
+    }
+    return "";
+}
+
+string ParallelRepeatNode::analyze(SymbolTable &symbols)
+{
+    loType = lo->analyze(symbols);
+    hiType = hi->analyze(symbols);
+    if (!isIntegerType(loType) || !isIntegerType(hiType))
+    {
+        cerr << "Line " << lineNumber << ": parallel repeat range must be integers, got "
+             << loType << ".." << hiType << "\n";
+        semanticError = true;
+    }
+    else
+    {
+        // A literal bound takes the type of the other one.
+        if (adoptIntegerType(lo.get(), hiType))
+            loType = hiType;
+        else if (adoptIntegerType(hi.get(), loType))
+            hiType = loType;
+        string common = commonIntType(loType, hiType, lineNumber);
+        if (!common.empty())
+            indexType = common;
+        // The runtime splits the range as int64, which not every uint64 fits.
+        if (indexType == "uint64")
+        {
+            cerr << "Line " << lineNumber << ": parallel repeat range cannot be 'uint64'; use int64 bounds\n";
+            semanticError = true;
+        }
+    }
+
+    for (auto &reduction : reductions)
+    {
+        try
+        {
+            reduction.type = symbols.lookup(reduction.var).type;
+            // Reducing a variable an enclosing loop reduces the same way
+            // folds into that loop's partial result.
+            checkWritable(symbols, reduction.var, lineNumber, reduceOpName(reduction.op));
+            if (!isNumericType(reduction.type))
+            {
+                cerr << "Line " << lineNumber << ": cannot reduce '" << reduction.var << "' of type "
+                     << reduction.type << "\n";
+                semanticError = true;
+            }
+        }
+        catch (const runtime_error &e)
+        {
+            cerr << "Error: " << e.what() << "\n";
+            semanticError = true;
+        }
+    }
+
+    size_t outerScope = symbols.parallelScope;
+    int outerLoopDepth = symbols.parallelLoopDepth;
+    size_t outerReductions = symbols.parallelReductions.size();
+
+    symbols.enterScope();
+    symbols.declare(var, indexType, lineNumber, true);
+    symbols.parallelScope = symbols.depth() - 1;
+    symbols.enterLoop();
+    symbols.parallelLoopDepth = symbols.loopDepth;
+    for (const auto &reduction : reductions)
+        symbols.parallelReductions.push_back({string(reduction.var), reduceOpName(reduction.op), symbols.parallelScope});
+
+    // The body's own spawns are synced when each range finishes. Like a
+    // spawned block, it cannot yield for an enclosing generator.
+    vector<string> outerYields;
+    outerYields.swap(symbols.generatorYields);
+    symbols.enterTask();
+    body->analyze(symbols);
+    checkLoopSpawns(symbols, {}, lineNumber);
+    symbols.exitTask();
+    symbols.generatorYields.swap(outerYields);
+
+    symbols.exitLoop();
+    symbols.exitScope();
+    symbols.parallelScope = outerScope;
+    symbols.parallelLoopDepth = outerLoopDepth;
+    symbols.parallelReductions.resize(outerReductions);
+    return "void";
+}
+
+string SpawnNode::analyze(SymbolTable &symbols)
+{
+    // A spawned block runs on its own: a yield in it could not suspend the
+    // generator it is written in, nor `stop` or `skip` leave its loop.
+    vector<string> outerYields;
+    outerYields.swap(symbols.generatorYields);
+    int outerLoopDepth = symbols.loopDepth;
+    int outerParallelLoopDepth = symbols.parallelLoopDepth;
+    symbols.loopDepth = 0;
+    symbols.parallelLoopDepth = -1;
+    symbols.enterTask();
+    body->analyze(symbols);
+    SymbolTable::TaskFrame frame = symbols.exitTask();
+    symbols.loopDepth = outerLoopDepth;
+    symbols.parallelLoopDepth = outerParallelLoopDepth;
+    symbols.generatorYields.swap(outerYields);
+
+    // Everything used from outside is declared in an enclosing scope, so
+    // still visible here.
+    copied.clear();
+    shared.clear();
+    for (const auto &name : frame.reads)
+    {
+        if (!frame.writes.count(name))
+            copied.emplace_back(name, symbols.lookup(name).type);
+    }
+    for (const auto &name : frame.writes)
+        shared.emplace_back(name, symbols.lookup(name).type);
+
+    set<string> &pending = symbols.taskFrames.back().pendingWrites;
+    pending.insert(frame.writes.begin(), frame.writes.end());
+    return "void";
+}
+
+string SyncNode::analyze(SymbolTable &symbols)
+{
+    symbols.taskFrames.back().pendingWrites.clear();
+    return "void";
+}
+
+string GenNode::analyze(SymbolTable &symbols)
+{
+    // The body runs whenever a loop resumes it, not here: `stop` and `skip`
+    // cannot reach a loop the definition happens to be written in.
+    int outerLoopDepth = symbols.loopDepth;
+    int outerParallelLoopDepth = symbols.parallelLoopDepth;
+    symbols.loopDepth = 0;
+    symbols.parallelLoopDepth = -1;
+
+    symbols.generatorYields.push_back("");
+    symbols.regions.push_back({symbols.depth(), nullptr});
+    symbols.enterTask();
+    body->analyze(symbols);
+    SymbolTable::TaskFrame frame = symbols.exitTask();
+    symbols.regions.pop_back();
+    elementType = symbols.generatorYields.back();
+    symbols.generatorYields.pop_back();
+
+    symbols.loopDepth = outerLoopDepth;
+    symbols.parallelLoopDepth = outerParallelLoopDepth;
+
+    set<string> used = frame.reads;
+    used.insert(frame.writes.begin(), frame.writes.end());
+    captured.clear();
+    for (const auto &var : used)
+        captured.emplace_back(var, symbols.lookup(var).type);
+
+    if (elementType.empty())
+    {
+        cerr << "Line " << lineNumber << ": generator '" << name << "' never yields\n";
+        semanticError = true;
+        elementType = "int";
+    }
+    symbols.declare(name, generatorType(elementType), lineNumber, true);
+    return "void";
+}
+
+string YieldNode::analyze(SymbolTable &symbols)
+{
+    exprType = expr->analyze(symbols);
+    if (symbols.generatorYields.empty())
+    {
+        cerr << "Line " << lineNumber << ": 'yield' used outside of a generator\n";
+        semanticError = true;
+        return "void";
+    }
+
+    // The first yield fixes the element type; later ones must convert to it.
+    string &elementType = symbols.generatorYields.back();
+    if (elementType.empty())
+    {
+        elementType = exprType;
+        return "void";
+    }
+    if (exprType != elementType && adoptIntegerType(expr.get(), elementType))
+        exprType = elementType;
+    if (!isImplicitlyConvertible(exprType, elementType))
+    {
+        cerr << "Line " << lineNumber << ": generator yields " << elementType << ", got " << exprType << "\n";
+        semanticError = true;
+    }
+    return "void";
+}
+
+string RepeatInNode::analyze(SymbolTable &symbols)
+{
+    elementType = "int";
+    try
+    {
+        const Symbol &gen = symbols.lookup(generator);
+        symbols.noteRead(generator, lineNumber);
+        if (!isGeneratorType(gen.type))
+        {
+            cerr << "Line " << lineNumber << ": '" << generator << "' is not a generator\n";
+            semanticError = true;
+        }
+        else
+        {
+            elementType = generatorElementType(gen.type);
+        }
+    }
+    catch (const runtime_error &e)
+    {
+        cerr << "Error: " << e.what() << "\n";
+        semanticError = true;
+    }
+
+    set<string> pendingBefore = symbols.taskFrames.back().pendingWrites;
+
+    symbols.enterScope();
+    symbols.declare(var, elementType, lineNumber, true);
+    symbols.enterLoop();
+    body->analyze(symbols);
+    symbols.exitLoop();
+    symbols.exitScope();
+
+    checkLoopSpawns(symbols, pendingBefore, lineNumber);
+    return "void";
+}
+
+string ReturnStmtNode::analyze(SymbolTable &symbols)
+{
+    string exprType = expr->analyze(symbols);
+    cout << "Line " << lineNumber << ": return " << exprType << "\n";
+    // You can extend this later with function return type checking.
+    return exprType;
+}
+
+string PrintStmtNode::analyze(SymbolTable &symbols)
+{
+    exprType = expr->analyze(symbols); // Analyze the expression being printed
+    return "void";
+}
+
+string BuiltinCallNode::analyze(SymbolTable &symbols)
+{
+    argTypes.clear();
+    operandType.clear();
+    temporary = false;
+    for (auto &arg : args)
+        argTypes.push_back(arg->analyze(symbols));
+
+    builtin = findBuiltin(funcName);
+    if (!builtin)
+    {
+        cerr << "Line " << lineNumber << ": unknown function '" << funcName << "'\n";
+        semanticError = true;
+        return "error";
+    }
+    const vector<string> &params = builtin->params;
+    if (args.size() != params.size())
+    {
+        cerr << "Line " << lineNumber << ": " << funcName << "() takes " << params.size()
+             << " argument(s), got " << args.size() << "\n";
+        semanticError = true;
+        return "error";
+    }
+
+    auto reject = [&](size_t i, const string &expected)
+    {
+        cerr << "Line " << lineNumber << ": argument " << i + 1 << " of " << funcName
+             << "() must be " << expected << ", got " << argTypes[i] << "\n";
+        semanticError = true;
+        return "error";
+    };
+
+    // Generic arguments meet in one type the way binary operands do: the
+    // narrowest integer type holding all of them, where an integer literal
+    // takes the type of the others when it fits. Floats only combine with
+    // floats.
+    auto isGeneric = [&](size_t i)
+    {
+        return params[i] == BUILTIN_NUMERIC || params[i] == BUILTIN_INTEGER;
+    };
+    auto join = [&](size_t i) -> bool
+    {
+        const string &type = argTypes[i];
+        bool fits = params[i] == BUILTIN_INTEGER ? isIntegerType(type) : isNumericType(type);
+        if (!fits)
+            return false;
+        if (operandType.empty() || operandType == type)
+            operandType = type;
+        else if (isIntegerType(operandType) && isIntegerType(type) && !promoteIntTypes(operandType, type).empty())
+            operandType = promoteIntTypes(operandType, type);
+        else
+            return false;
+        return true;
+    };
+
+    bool negative;
+    unsigned long long magnitude;
+    LiteralNode *literal;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (isGeneric(i) && !integerLiteral(args[i].get(), negative, magnitude, literal) && !join(i))
+            return reject(i, operandType.empty() ? params[i] : operandType);
+    }
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (!isGeneric(i) || !integerLiteral(args[i].get(), negative, magnitude, literal))
+            continue;
+        if (!operandType.empty() && adoptIntegerType(args[i].get(), operandType))
+            argTypes[i] = operandType;
+        else if (!join(i))
+            return reject(i, operandType);
+    }
+
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (isGeneric(i) || params[i] == BUILTIN_ANY)
+            continue;
+        if (argTypes[i] != params[i] && adoptIntegerType(args[i].get(), params[i]))
+            argTypes[i] = params[i];
+        if (!isImplicitlyConvertible(argTypes[i], params[i]))
+            return reject(i, params[i]);
+    }
+
+    temporary = builtin->allocates && claimTemporary(symbols);
+    if (builtin->result == BUILTIN_NUMERIC || builtin->result == BUILTIN_INTEGER)
+        return operandType;
+    return builtin->result;
+}
+
+// These destructors must be defined even if they’re empty. This forces the compiler to emit the vtable.
+LiteralNode::~LiteralNode() {}
+IdentifierNode::~IdentifierNode() {}
+BinaryExprNode::~BinaryExprNode() {}
+UnaryExprNode::~UnaryExprNode() {}
+DeclarationNode::~DeclarationNode() {}
+PrintStmtNode::~PrintStmtNode() {}
+ReturnStmtNode::~ReturnStmtNode() {}
+IfStmtNode::~IfStmtNode() {}
+MatchNode::~MatchNode() {}
+RepeatStmtNode::~RepeatStmtNode() {}
+ParallelRepeatNode::~ParallelRepeatNode() {}
+SpawnNode::~SpawnNode() {}
+SyncNode::~SyncNode() {}
+GenNode::~GenNode() {}
+YieldNode::~YieldNode() {}
+RepeatInNode::~RepeatInNode() {}
+RepeatRangeNode::~RepeatRangeNode() {}
+AssignmentNode::~AssignmentNode() {}
+BlockNode::~BlockNode() {}
+ProgramNode::~ProgramNode() {}
+ImportNode::~ImportNode() {}
+BreakNode::~BreakNode() {}
+ContinueNode::~ContinueNode() {}
+BuiltinCallNode::~BuiltinCallNode() {}
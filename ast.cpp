@@ -2,10 +2,13 @@
 #include "codegen.h"
 #include "ast_interface.h"
 #include "SymbolTable.h"
+#include "types.h"
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IR/DerivedTypes.h> // For llvm::PointerType
 #include <iostream>
@@ -13,256 +16,20 @@
 
 using namespace std;
 
-unique_ptr<ProgramNode> astRoot = nullptr;
-
-//---Symanitc Analysis---
-
-string BreakNode::analyze(SymbolTable &symbols)
-{
-    if (symbols.loopDepth == 0)
-    {
-        cerr << "Semantic Error at line " << line << ": 'stop' used outside of loop.\n";
-    }
-    return "void";
-}
-
-string ContinueNode::analyze(SymbolTable &symbols)
-{
-    if (symbols.loopDepth == 0)
-    {
-        cerr << "Semantic Error at line " << line << ": 'skip' used outside of loop.\n";
-    }
-    return "void";
-}
-
-string LiteralNode::analyze(SymbolTable &symbols)
-{
-    switch (type)
-    {
-    case Type::Int:
-        return "int";
-    case Type::Float:
-        return "float";
-    case Type::String:
-        return "string";
-    case Type::Char:
-        return "char";
-    case Type::Bool:
-        return "bool";
-    }
-    return "unknown";
-}
-
-string IdentifierNode::analyze(SymbolTable &symbols)
-{
-    try
-    {
-        const Symbol &result = symbols.lookup(name);
-        type = result.type;
-        return result.type;
-    }
-    catch (const runtime_error &e)
-    {
-        cerr << "Error: " << e.what() << "\n";
-        return "error";
-    }
-}
-
-string DeclarationNode::analyze(SymbolTable &symbols)
-{
-    string exprType = expr->analyze(symbols);
-    if (exprType != typeName)
-    {
-        cerr << "Type mismatch in declaration of '" << identifier
-             << "': expected " << typeName << ", got " << exprType << "\n";
-    }
-    symbols.declare(identifier, typeName, lineNumber);
-    return "void";
-}
-
-string AssignmentNode::analyze(SymbolTable &symbols)
-{
-    try
-    {
-        const Symbol &declaredSymbol = symbols.lookup(name);
-        string valueType = value->analyze(symbols);
-
-        if (declaredSymbol.type != valueType)
-        {
-            cerr << "Type mismatch in assignment to '" << name
-                 << "': expected " << declaredSymbol.type << ", got " << valueType << "\n";
-        }
-
-        return "void";
-    }
-    catch (const runtime_error &e)
-    {
-        cerr << "Error: " << e.what() << "\n";
-        return "error";
-    }
-}
-
-string InputStmtNode::analyze(SymbolTable &symbols)
-{
-    try
-    {
-        symbols.lookup(varName); // already declared, do nothing
-    }
-    catch (const std::runtime_error &)
-    {
-        // Not declared yet, declare as default type
-        symbols.declare(varName, "int", lineNumber);
-    }
-    return "void";
-}
-
-string BinaryExprNode::analyze(SymbolTable &symbols)
-{
-    string leftType = left->analyze(symbols);
-    string rightType = right->analyze(symbols);
-
-    if (leftType != rightType)
-    {
-        cerr << "Type mismatch in binary expression: " << leftType << " vs " << rightType << "\n";
-        return "error";
-    }
-
-    switch (op)
-    {
-    case Op::Add:
-    case Op::Sub:
-    case Op::Mul:
-    case Op::Div:
-        return (leftType == "int" || leftType == "float") ? leftType : "error";
-
-    case Op::Eq:
-    case Op::Neq:
-    case Op::Lt:
-    case Op::Gt:
-    case Op::Leq:
-    case Op::Geq:
-        return "bool";
-
-    case Op::And:
-    case Op::Or:
-        if (leftType != "bool")
-            cerr << "Logical operators require boolean types\n";
-        return "bool";
-    }
-    return "error";
-}
-
-string UnaryExprNode::analyze(SymbolTable &symbols)
-{
-    string operandType = operand->analyze(symbols);
-    if (op == Op::Not && operandType != "bool")
-    {
-        cerr << "Error: 'not' operator requires a boolean operand\n";
-        return "error";
-    }
-    if (op == Op::Minus && operandType != "int" && operandType != "float")
-    {
-        cerr << "Error: '-' operator requires an integer or float operand\n";
-        return "error";
-    }
-    return operandType;
-}
-
-string BlockNode::analyze(SymbolTable &symbols)
-{
-    symbols.enterScope();
-    for (const auto &stmt : statements)
-    {
-        stmt->analyze(symbols);
-    }
-    // symbols.print();
-    symbols.exitScope();
-    return "void";
-}
-
-string ProgramNode::analyze(SymbolTable &symbols)
-{
-    // symbols.enterScope();
-    for (const auto &stmt : statements)
-    {
-        stmt->analyze(symbols);
-    }
-    // symbols.exitScope();
-    return "void";
-}
-
-string IfStmtNode::analyze(SymbolTable &symbols)
-{
-    string condType = condition->analyze(symbols);
-    if (condType != "bool")
-    {
-        cerr << "Line " << lineNumber << ": Condition in if statement must be of type 'bool', got '" << condType << "'\n";
-    }
-
-    // symbols.enterScope();
-    thenBlock->analyze(symbols);
-    // symbols.exitScope();
-
-    if (elseBlock)
-    {
-        // symbols.enterScope();
-        elseBlock->analyze(symbols);
-        // symbols.exitScope();
-    }
-
-    return "void";
-}
-
-string RepeatStmtNode::analyze(SymbolTable &symbols)
-{
-    string condType = condition->analyze(symbols);
-    if (condType != "bool")
-    {
-        cerr << "Line " << lineNumber << ": Condition in repeat statement must be of type 'bool', got '" << condType << "'\n";
-    }
-
-    symbols.enterLoop();
-    // symbols.enterScope();
-    body->analyze(symbols);
-    // symbols.exitScope();
-    symbols.exitLoop();
-
-    return "void";
-}
-
-string ReturnStmtNode::analyze(SymbolTable &symbols)
-{
-    string exprType = expr->analyze(symbols);
-    cout << "Line " << lineNumber << ": return " << exprType << "\n";
-    // You can extend this later with function return type checking.
-    return exprType;
-}
-
-string PrintStmtNode::analyze(SymbolTable &symbols)
-{
-    expr->analyze(symbols); // Analyze the expression being printed
-    return "void";
-}
-
-string BuiltinCallNode::analyze(SymbolTable &symbols)
-{
-
-    return "unknown"; // You can update this later with proper return types
-}
-
 // -------------------- Codegen for LiteralNode --------------------
 llvm::Value *LiteralNode::codegen(CodeGenContext &context)
 {
     switch (type)
     {
     case Type::Int:
-        return llvm::ConstantInt::get(llvm::Type::getInt32Ty(context.llvmContext), stoi(value));
+        return llvm::ConstantInt::get(
+            llvm::cast<llvm::IntegerType>(context.getLLVMType(intType)), value, 10);
     case Type::Float:
-        return llvm::ConstantFP::get(llvm::Type::getFloatTy(context.llvmContext), stof(value));
+        return llvm::ConstantFP::get(llvm::Type::getFloatTy(context.llvmContext), stof(string(value)));
     case Type::Bool:
         return llvm::ConstantInt::get(llvm::Type::getInt1Ty(context.llvmContext), value == "true");
     case Type::String:
-        return context.builder.CreateGlobalStringPtr(value);
+        return context.stringLiteral(value);
 
     default:
         return nullptr;
@@ -271,7 +38,7 @@ llvm::Value *LiteralNode::codegen(CodeGenContext &context)
 
 llvm::Value *IdentifierNode::codegen(CodeGenContext &context)
 {
-    llvm::Value *ptr = context.namedValues[name];
+    llvm::Value *ptr = context.namedValues[string(name)];
     if (!ptr)
     {
         std::cerr << "Error: Undefined variable '" << name << "'\n";
@@ -309,6 +76,85 @@ llvm::Value *BinaryExprNode::codegen(CodeGenContext &context)
     if (!L || !R)
         return nullptr;
 
+    // Bring both sides to the common type chosen by analysis.
+    L = context.convertValue(L, leftType, operandType);
+    R = context.convertValue(R, rightType, operandType);
+
+    if (operandType == "string")
+    {
+        if (op == Op::Add)
+            return context.callStringRuntime("flec_str_concat", context.stringType(),
+                                             {L, R, context.builder.getInt32(temporary)});
+
+        // Two literals compare at compile time.
+        auto *leftLiteral = dynamic_cast<LiteralNode *>(left.get());
+        auto *rightLiteral = dynamic_cast<LiteralNode *>(right.get());
+        if (leftLiteral && rightLiteral)
+        {
+            int order = leftLiteral->value.compare(rightLiteral->value);
+            bool result = op == Op::Eq    ? order == 0
+                          : op == Op::Neq ? order != 0
+                          : op == Op::Lt  ? order < 0
+                          : op == Op::Gt  ? order > 0
+                          : op == Op::Leq ? order <= 0
+                                          : order >= 0;
+            return context.builder.getInt1(result);
+        }
+
+        if (op == Op::Eq)
+            return context.stringEquals(L, R);
+        if (op == Op::Neq)
+            return context.builder.CreateNot(context.stringEquals(L, R), "netmp");
+
+        // Orderings go by flec_str_cmp's sign.
+        llvm::Value *order = context.callStringRuntime("flec_str_cmp", context.builder.getInt32Ty(), {L, R});
+        llvm::Value *zero = context.builder.getInt32(0);
+        switch (op)
+        {
+        case Op::Lt:
+            return context.builder.CreateICmpSLT(order, zero, "lttmp");
+        case Op::Gt:
+            return context.builder.CreateICmpSGT(order, zero, "gttmp");
+        case Op::Leq:
+            return context.builder.CreateICmpSLE(order, zero, "leqtmp");
+        case Op::Geq:
+            return context.builder.CreateICmpSGE(order, zero, "geqtmp");
+        default:
+            return nullptr;
+        }
+    }
+
+    if (operandType == "float")
+    {
+        switch (op)
+        {
+        case Op::Add:
+            return context.builder.CreateFAdd(L, R, "addtmp");
+        case Op::Sub:
+            return context.builder.CreateFSub(L, R, "subtmp");
+        case Op::Mul:
+            return context.builder.CreateFMul(L, R, "multmp");
+        case Op::Div:
+            return context.builder.CreateFDiv(L, R, "divtmp");
+        case Op::Eq:
+            return context.builder.CreateFCmpOEQ(L, R, "eqtmp");
+        case Op::Neq:
+            return context.builder.CreateFCmpONE(L, R, "netmp");
+        case Op::Lt:
+            return context.builder.CreateFCmpOLT(L, R, "lttmp");
+        case Op::Gt:
+            return context.builder.CreateFCmpOGT(L, R, "gttmp");
+        case Op::Leq:
+            return context.builder.CreateFCmpOLE(L, R, "leqtmp");
+        case Op::Geq:
+            return context.builder.CreateFCmpOGE(L, R, "geqtmp");
+        default:
+            return nullptr;
+        }
+    }
+
+    bool isUnsigned = isIntegerType(operandType) && !intTypeInfo(operandType).isSigned;
+
     switch (op)
     {
     case Op::Add:
@@ -318,19 +164,24 @@ llvm::Value *BinaryExprNode::codegen(CodeGenContext &context)
     case Op::Mul:
         return context.builder.CreateMul(L, R, "multmp");
     case Op::Div:
-        return context.builder.CreateSDiv(L, R, "divtmp");
+        return isUnsigned ? context.builder.CreateUDiv(L, R, "divtmp")
+                          : context.builder.CreateSDiv(L, R, "divtmp");
     case Op::Eq:
         return context.builder.CreateICmpEQ(L, R, "eqtmp");
     case Op::Neq:
         return context.builder.CreateICmpNE(L, R, "netmp");
     case Op::Lt:
-        return context.builder.CreateICmpSLT(L, R, "lttmp");
+        return isUnsigned ? context.builder.CreateICmpULT(L, R, "lttmp")
+                          : context.builder.CreateICmpSLT(L, R, "lttmp");
     case Op::Gt:
-        return context.builder.CreateICmpSGT(L, R, "gttmp");
+        return isUnsigned ? context.builder.CreateICmpUGT(L, R, "gttmp")
+                          : context.builder.CreateICmpSGT(L, R, "gttmp");
     case Op::Leq:
-        return context.builder.CreateICmpSLE(L, R, "leqtmp");
+        return isUnsigned ? context.builder.CreateICmpULE(L, R, "leqtmp")
+                          : context.builder.CreateICmpSLE(L, R, "leqtmp");
     case Op::Geq:
-        return context.builder.CreateICmpSGE(L, R, "geqtmp");
+        return isUnsigned ? context.builder.CreateICmpUGE(L, R, "geqtmp")
+                          : context.builder.CreateICmpSGE(L, R, "geqtmp");
     case Op::And:
         return context.builder.CreateAnd(L, R, "andtmp");
     case Op::Or:
@@ -351,6 +202,8 @@ llvm::Value *UnaryExprNode::codegen(CodeGenContext &context)
     case Op::Not:
         return context.builder.CreateNot(val, "nottmp");
     case Op::Minus:
+        if (val->getType()->isFloatingPointTy())
+            return context.builder.CreateFNeg(val, "negtmp");
         return context.builder.CreateNeg(val, "negtmp");
     default:
         return nullptr;
@@ -360,22 +213,26 @@ llvm::Value *UnaryExprNode::codegen(CodeGenContext &context)
 llvm::Value *DeclarationNode::codegen(CodeGenContext &context)
 {
     llvm::Type *llvmType = context.getLLVMType(typeName);
-    auto *alloca = context.builder.CreateAlloca(llvmType, nullptr, identifier);
-    llvm::Value *initVal = expr->codegen(context);
-    context.builder.CreateStore(initVal, alloca);
-    context.namedValues[identifier] = alloca;
-    return alloca;
+    llvm::Value *initVal = context.convertValue(expr->codegen(context), exprType, typeName);
+    if (promote)
+        initVal = context.callStringRuntime("flec_str_keep", context.stringType(), {initVal});
+    llvm::Value *storage = context.createVariable(llvmType, identifier);
+    context.describeVariable(storage, identifier, typeName, lineNumber);
+    context.builder.CreateStore(initVal, storage);
+    return storage;
 }
 
 llvm::Value *AssignmentNode::codegen(CodeGenContext &context)
 {
-    llvm::Value *ptr = context.namedValues[name];
+    llvm::Value *ptr = context.namedValues[string(name)];
     if (!ptr)
     {
         cerr << "Undefined variable: " << name << endl;
         return nullptr;
     }
-    llvm::Value *val = value->codegen(context);
+    llvm::Value *val = context.convertValue(value->codegen(context), valueType, targetType);
+    if (promote)
+        val = context.callStringRuntime("flec_str_keep", context.stringType(), {val});
     context.builder.CreateStore(val, ptr);
     return val;
 }
@@ -386,6 +243,12 @@ llvm::Value *PrintStmtNode::codegen(CodeGenContext &context)
     if (!val)
         return nullptr;
 
+    // A string built at run time is printed by the runtime; a literal needs
+    // only printf, so a program that prints nothing else runs without it.
+    auto *literal = dynamic_cast<LiteralNode *>(expr.get());
+    if (exprType == "string" && !literal)
+        return context.callStringRuntime("flec_str_print", context.builder.getVoidTy(), {val});
+
     // Declare printf if not already declared
     llvm::Function *printfFunc = context.module->getFunction("printf");
     if (!printfFunc)
@@ -401,9 +264,24 @@ llvm::Value *PrintStmtNode::codegen(CodeGenContext &context)
     llvm::Type *valType = val->getType();
     llvm::Value *formatStr = nullptr;
 
-    if (valType->isIntegerTy(32))
+    IntTypeInfo intInfo = intTypeInfo(exprType);
+    if (exprType == "string")
+    {
+        val = context.builder.CreateGlobalStringPtr(literal->value, "str");
+        formatStr = context.builder.CreateGlobalStringPtr("%s\n", "fmtstr");
+    }
+    else if (intInfo.bits)
     {
-        formatStr = context.builder.CreateGlobalStringPtr("%d\n", "fmtint");
+        // Narrow integers are promoted to int for varargs, as C would.
+        if (intInfo.bits < 32)
+        {
+            val = context.convertValue(val, exprType, intInfo.isSigned ? "int" : "uint32");
+            intInfo.bits = 32;
+        }
+        if (intInfo.bits == 64)
+            formatStr = context.builder.CreateGlobalStringPtr(intInfo.isSigned ? "%lld\n" : "%llu\n", "fmtint64");
+        else
+            formatStr = context.builder.CreateGlobalStringPtr(intInfo.isSigned ? "%d\n" : "%u\n", "fmtint");
     }
     else if (valType->isFloatTy())
     {
@@ -414,21 +292,6 @@ llvm::Value *PrintStmtNode::codegen(CodeGenContext &context)
     {
         formatStr = context.builder.CreateGlobalStringPtr("%d\n", "fmtbool");
     }
-    else if (valType->isPointerTy())
-    {
-        // In LLVM 18+, pointers are opaque, so no getElementType() anymore.
-        // Instead, compare type to i8* for strings
-        llvm::Type *i8PtrType = llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(context.llvmContext));
-        if (valType == i8PtrType)
-        {
-            formatStr = context.builder.CreateGlobalStringPtr("%s\n", "fmtstr");
-        }
-        else
-        {
-            std::cerr << "PrintStmtNode: Unsupported pointer type for printing.\n";
-            return nullptr;
-        }
-    }
     else
     {
         std::cerr << "PrintStmtNode: Unsupported type for printing.\n";
@@ -440,15 +303,38 @@ llvm::Value *PrintStmtNode::codegen(CodeGenContext &context)
 
 llvm::Value *BlockNode::codegen(CodeGenContext &context)
 {
+    bool wasTopLevel = context.topLevel;
+    context.topLevel = false;
+    if (temporaries > 0)
+        context.enterRegion();
     for (const auto &stmt : statements)
+    {
+        // Nothing after a stop or skip can run; the block it branched from
+        // must not get a second terminator.
+        if (context.builder.GetInsertBlock()->getTerminator())
+            break;
+        DebugLine here(context, stmt->lineNumber);
         stmt->codegen(context);
+    }
+    if (temporaries > 0)
+    {
+        if (!context.builder.GetInsertBlock()->getTerminator())
+            context.exitRegions(context.regionMarks.size() - 1);
+        context.regionMarks.pop_back();
+    }
+    context.topLevel = wasTopLevel;
     return nullptr;
 }
 
 llvm::Value *ProgramNode::codegen(CodeGenContext &context)
 {
     for (const auto &stmt : statements)
+    {
+        if (context.builder.GetInsertBlock()->getTerminator())
+            break;
+        DebugLine here(context, stmt->lineNumber);
         stmt->codegen(context);
+    }
     return nullptr;
 }
 
@@ -465,18 +351,72 @@ llvm::Value *IfStmtNode::codegen(CodeGenContext &context)
 
     context.builder.CreateCondBr(cond, thenBB, elseBB);
 
+    // A branch that ended in stop or skip already has its terminator.
     context.builder.SetInsertPoint(thenBB);
     thenBlock->codegen(context);
-    context.builder.CreateBr(mergeBB);
-    thenBB = context.builder.GetInsertBlock();
+    if (!context.builder.GetInsertBlock()->getTerminator())
+        context.builder.CreateBr(mergeBB);
 
     context.builder.SetInsertPoint(elseBB);
     if (elseBlock)
         elseBlock->codegen(context);
-    context.builder.CreateBr(mergeBB);
-    elseBB = context.builder.GetInsertBlock();
+    if (!context.builder.GetInsertBlock()->getTerminator())
+        context.builder.CreateBr(mergeBB);
 
+    // When neither branch falls through, the code after the if is dead:
+    // terminating the merge block tells the enclosing block to stop there.
     context.builder.SetInsertPoint(mergeBB);
+    if (llvm::pred_empty(mergeBB))
+        context.builder.CreateUnreachable();
+
+    return nullptr;
+}
+
+// One switch for the whole match, instead of a compare and branch per arm:
+// LLVM lowers it to a jump table when the labels are dense and to a tree of
+// compares when they are not.
+llvm::Value *MatchNode::codegen(CodeGenContext &context)
+{
+    llvm::Value *value = subject->codegen(context);
+    auto *valueType = llvm::cast<llvm::IntegerType>(value->getType());
+
+    llvm::Function *func = context.builder.GetInsertBlock()->getParent();
+
+    std::vector<llvm::BasicBlock *> armBBs;
+    for (size_t i = 0; i < arms.size(); ++i)
+        armBBs.push_back(llvm::BasicBlock::Create(context.llvmContext, "matchcase", func));
+    llvm::BasicBlock *elseBB = elseBlock ? llvm::BasicBlock::Create(context.llvmContext, "matchelse", func) : nullptr;
+    llvm::BasicBlock *mergeBB = llvm::BasicBlock::Create(context.llvmContext, "matchcont", func);
+
+    unsigned caseCount = 0;
+    for (const auto &arm : arms)
+        caseCount += arm.values.size();
+    llvm::SwitchInst *dispatch = context.builder.CreateSwitch(value, elseBB ? elseBB : mergeBB, caseCount);
+    for (size_t i = 0; i < arms.size(); ++i)
+    {
+        for (unsigned long long label : arms[i].values)
+            dispatch->addCase(llvm::ConstantInt::get(valueType, label), armBBs[i]);
+    }
+
+    // As for if: an arm that ended in stop or skip has its terminator.
+    for (size_t i = 0; i < arms.size(); ++i)
+    {
+        context.builder.SetInsertPoint(armBBs[i]);
+        arms[i].body->codegen(context);
+        if (!context.builder.GetInsertBlock()->getTerminator())
+            context.builder.CreateBr(mergeBB);
+    }
+    if (elseBB)
+    {
+        context.builder.SetInsertPoint(elseBB);
+        elseBlock->codegen(context);
+        if (!context.builder.GetInsertBlock()->getTerminator())
+            context.builder.CreateBr(mergeBB);
+    }
+
+    context.builder.SetInsertPoint(mergeBB);
+    if (llvm::pred_empty(mergeBB))
+        context.builder.CreateUnreachable();
 
     return nullptr;
 }
@@ -485,7 +425,9 @@ llvm::Value *RepeatStmtNode::codegen(CodeGenContext &context)
 {
     llvm::Function *func = context.builder.GetInsertBlock()->getParent();
 
-    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(context.llvmContext, "loop", func);
+    // The header carries the source line so optimization remarks can name it.
+    std::string lineSuffix = ".line" + std::to_string(lineNumber);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(context.llvmContext, "loop" + lineSuffix, func);
     llvm::BasicBlock *condBB = llvm::BasicBlock::Create(context.llvmContext, "loopcond", func);
     llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(context.llvmContext, "afterloop", func);
 
@@ -502,18 +444,23 @@ llvm::Value *RepeatStmtNode::codegen(CodeGenContext &context)
     // Set current loop's break/continue targets
     context.setBreakBlock(afterBB);
     context.setContinueBlock(condBB);
+    size_t outerLoopRegions = context.loopRegions;
+    context.loopRegions = context.regionMarks.size();
 
     body->codegen(context); // Inside loop
+    context.loopRegions = outerLoopRegions;
 
     // After body, jump to condition check
-    context.builder.CreateBr(condBB);
+    if (!context.builder.GetInsertBlock()->getTerminator())
+        context.builder.CreateBr(condBB);
 
     // --- Condition check ---
     context.builder.SetInsertPoint(condBB);
     llvm::Value *condVal = condition->codegen(context);
     condVal = context.builder.CreateICmpNE(condVal, llvm::ConstantInt::getFalse(context.llvmContext), "loopcond");
 
-    context.builder.CreateCondBr(condVal, loopBB, afterBB);
+    llvm::Instruction *backEdge = context.builder.CreateCondBr(condVal, loopBB, afterBB);
+    context.attachLoopHints(backEdge, hints, lineNumber);
 
     // --- After loop ---
     context.builder.SetInsertPoint(afterBB);
@@ -525,45 +472,731 @@ llvm::Value *RepeatStmtNode::codegen(CodeGenContext &context)
     return nullptr;
 }
 
-llvm::Value *BreakNode::codegen(CodeGenContext &context)
+// The counted loop LLVM's loop passes expect: the trip count is worked out
+// before the loop, a canonical counter runs from 0 up to it, and i is a
+// second induction variable, both stepped without wrapping. Exiting on the
+// counter rather than on i keeps a step that would carry i past the type's
+// range on the way out from mattering: that last value of i is never used.
+llvm::Value *RepeatRangeNode::codegen(CodeGenContext &context)
 {
-    if (!context.getBreakBlock())
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Type *type = context.getLLVMType(indexType);
+    bool isSigned = intTypeInfo(indexType).isSigned;
+
+    llvm::Value *first = context.convertValue(lo->codegen(context), loType, indexType);
+    llvm::Value *limit = context.convertValue(hi->codegen(context), hiType, indexType);
+    if (!first || !limit)
+        return nullptr;
+
+    // The distance from first to limit fits the type's width unsigned; so
+    // does the number of steps it takes.
+    llvm::Value *enter, *distance;
+    if (descending)
+    {
+        enter = isSigned ? builder.CreateICmpSGT(first, limit) : builder.CreateICmpUGT(first, limit);
+        distance = builder.CreateSub(first, limit, "distance");
+    }
+    else
+    {
+        enter = isSigned ? builder.CreateICmpSLT(first, limit) : builder.CreateICmpULT(first, limit);
+        distance = builder.CreateSub(limit, first, "distance");
+    }
+    llvm::Value *stepValue = llvm::ConstantInt::get(type, stepSize);
+    llvm::Value *tripCount = distance;
+    if (stepSize != 1)
+    {
+        llvm::Value *one = llvm::ConstantInt::get(type, 1);
+        tripCount = builder.CreateNUWAdd(builder.CreateUDiv(builder.CreateNUWSub(distance, one), stepValue), one);
+    }
+    tripCount->setName("tripcount");
+
+    llvm::Function *func = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *preheaderBB = builder.GetInsertBlock();
+    std::string lineSuffix = ".line" + std::to_string(lineNumber);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(context.llvmContext, "loop" + lineSuffix, func);
+    llvm::BasicBlock *latchBB = llvm::BasicBlock::Create(context.llvmContext, "loopnext", func);
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(context.llvmContext, "afterloop", func);
+    builder.CreateCondBr(enter, loopBB, afterBB);
+
+    builder.SetInsertPoint(loopBB);
+    llvm::PHINode *counter = builder.CreatePHI(type, 2, "counter");
+    llvm::PHINode *index = builder.CreatePHI(type, 2, var);
+    counter->addIncoming(llvm::ConstantInt::get(type, 0), preheaderBB);
+    index->addIncoming(first, preheaderBB);
+
+    // The body reads i like any variable; the slot is only ever stored i's
+    // value here, so it folds back into the phi.
+    llvm::Value *outerBinding = context.namedValues[string(var)];
+    llvm::AllocaInst *slot = context.createEntryAlloca(type, var);
+    context.namedValues[string(var)] = slot;
+    builder.CreateStore(index, slot);
+
+    llvm::BasicBlock *prevBreak = context.getBreakBlock();
+    llvm::BasicBlock *prevContinue = context.getContinueBlock();
+    size_t outerLoopRegions = context.loopRegions;
+    context.setBreakBlock(afterBB);
+    context.setContinueBlock(latchBB);
+    context.loopRegions = context.regionMarks.size();
+    body->codegen(context);
+    if (!builder.GetInsertBlock()->getTerminator())
+        builder.CreateBr(latchBB);
+    context.loopRegions = outerLoopRegions;
+    context.setBreakBlock(prevBreak);
+    context.setContinueBlock(prevContinue);
+    context.namedValues[string(var)] = outerBinding;
+
+    builder.SetInsertPoint(latchBB);
+    llvm::Value *nextIndex;
+    if (descending)
+        nextIndex = isSigned ? builder.CreateNSWSub(index, stepValue) : builder.CreateNUWSub(index, stepValue);
+    else
+        nextIndex = isSigned ? builder.CreateNSWAdd(index, stepValue) : builder.CreateNUWAdd(index, stepValue);
+    nextIndex->setName(var + ".next");
+    llvm::Value *nextCounter = builder.CreateNUWAdd(counter, llvm::ConstantInt::get(type, 1), "counter.next");
+    llvm::Value *more = builder.CreateICmpULT(nextCounter, tripCount, "loopcond");
+    llvm::Instruction *backEdge = builder.CreateCondBr(more, loopBB, afterBB);
+    context.attachLoopHints(backEdge, hints, lineNumber);
+    counter->addIncoming(nextCounter, latchBB);
+    index->addIncoming(nextIndex, latchBB);
+
+    builder.SetInsertPoint(afterBB);
+    return nullptr;
+}
+
+// Identity of a reduction: the value each worker's private copy starts from.
+static llvm::Constant *reductionIdentity(ParallelRepeatNode::ReduceOp op, const string &type, llvm::Type *llvmType)
+{
+    using Op = ParallelRepeatNode::ReduceOp;
+    if (type == "float")
     {
-        cerr << "Error: {stop} used outside of loop.\n";
+        if (op == Op::Add)
+            return llvm::ConstantFP::get(llvmType, 0.0);
+        if (op == Op::Mul)
+            return llvm::ConstantFP::get(llvmType, 1.0);
+        return llvm::ConstantFP::getInfinity(llvmType, op == Op::Max);
+    }
+
+    IntTypeInfo info = intTypeInfo(type);
+    unsigned bits = info.bits;
+    switch (op)
+    {
+    case Op::Add:
+        return llvm::ConstantInt::get(llvmType, 0);
+    case Op::Mul:
+        return llvm::ConstantInt::get(llvmType, 1);
+    case Op::Min:
+        return llvm::ConstantInt::get(llvmType->getContext(), info.isSigned ? llvm::APInt::getSignedMaxValue(bits)
+                                                                            : llvm::APInt::getMaxValue(bits));
+    case Op::Max:
+        return llvm::ConstantInt::get(llvmType->getContext(), info.isSigned ? llvm::APInt::getSignedMinValue(bits)
+                                                                            : llvm::APInt::getMinValue(bits));
+    }
+    return nullptr;
+}
+
+static llvm::Value *combineReduction(CodeGenContext &context, ParallelRepeatNode::ReduceOp op, const string &type,
+                                     llvm::Value *a, llvm::Value *b)
+{
+    using Op = ParallelRepeatNode::ReduceOp;
+    llvm::IRBuilder<> &builder = context.builder;
+    bool isFloat = type == "float";
+    bool isSigned = intTypeInfo(type).isSigned;
+    switch (op)
+    {
+    case Op::Add:
+        return isFloat ? builder.CreateFAdd(a, b) : builder.CreateAdd(a, b);
+    case Op::Mul:
+        return isFloat ? builder.CreateFMul(a, b) : builder.CreateMul(a, b);
+    case Op::Min:
+    case Op::Max:
+    {
+        llvm::Value *less = isFloat    ? builder.CreateFCmpOLT(a, b)
+                            : isSigned ? builder.CreateICmpSLT(a, b)
+                                       : builder.CreateICmpULT(a, b);
+        return op == Op::Min ? builder.CreateSelect(less, a, b) : builder.CreateSelect(less, b, a);
+    }
+    }
+    return nullptr;
+}
+
+// The body is outlined into `void flec.parallel.line<N>(i64 lo, i64 hi, i8* env)`
+// that runs iterations [lo, hi). env holds the address of every variable the
+// loop can see; reductions get a private copy in the outlined function that
+// is folded into the shared variable under the runtime lock once the range is
+// done. flec_parallel_for hands ranges of the iteration space to the pool.
+llvm::Value *ParallelRepeatNode::codegen(CodeGenContext &context)
+{
+    llvm::LLVMContext &ctx = context.llvmContext;
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Type *i64 = builder.getInt64Ty();
+    llvm::Type *i8Ptr = builder.getInt8PtrTy();
+
+    llvm::Value *loVal = context.convertValue(lo->codegen(context), loType, "int64");
+    llvm::Value *hiVal = context.convertValue(hi->codegen(context), hiType, "int64");
+    if (!loVal || !hiVal)
         return nullptr;
+
+    // Globals are visible from the outlined function as they are.
+    vector<pair<string, llvm::Value *>> captures;
+    for (const auto &entry : context.namedValues)
+    {
+        if (entry.second && !llvm::isa<llvm::GlobalValue>(entry.second))
+            captures.push_back(entry);
     }
-    return context.builder.CreateBr(context.getBreakBlock());
+
+    llvm::ArrayType *envType = llvm::ArrayType::get(i8Ptr, captures.size());
+    llvm::AllocaInst *env = context.createEntryAlloca(envType, "parallel.env");
+    for (size_t i = 0; i < captures.size(); ++i)
+    {
+        llvm::Value *slot = builder.CreateConstInBoundsGEP2_32(envType, env, 0, i);
+        builder.CreateStore(builder.CreateBitCast(captures[i].second, i8Ptr), slot);
+    }
+
+    llvm::FunctionType *bodyType = llvm::FunctionType::get(builder.getVoidTy(), {i64, i64, i8Ptr}, false);
+    llvm::Function *bodyFunc = llvm::Function::Create(bodyType, llvm::Function::InternalLinkage,
+                                                      "flec.parallel.line" + std::to_string(lineNumber),
+                                                      context.module.get());
+
+    // Generate the outlined body with its own view of the variables.
+    llvm::BasicBlock *callerBlock = builder.GetInsertBlock();
+    auto savedValues = context.namedValues;
+    llvm::BasicBlock *prevBreak = context.getBreakBlock();
+    llvm::BasicBlock *prevContinue = context.getContinueBlock();
+    bool wasTopLevel = context.topLevel;
+    llvm::Value *outerGroup = context.syncGroup;
+    CodeGenContext::GeneratorState *outerGenerator = context.generator;
+    vector<llvm::Value *> outerRegions;
+    outerRegions.swap(context.regionMarks);
+    size_t outerLoopRegions = context.loopRegions;
+    context.topLevel = false;
+    context.syncGroup = nullptr;
+    context.generator = nullptr;
+    context.loopRegions = 0;
+    DebugInfo::Outer outerDebug = context.enterDebugFunction(bodyFunc, lineNumber);
+
+    auto args = bodyFunc->arg_begin();
+    llvm::Value *rangeLo = &*args++;
+    llvm::Value *rangeHi = &*args++;
+    llvm::Value *envArg = &*args;
+    rangeLo->setName("lo");
+    rangeHi->setName("hi");
+    envArg->setName("env");
+
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(ctx, "entry", bodyFunc);
+    builder.SetInsertPoint(entryBB);
+    llvm::Value *envArray = builder.CreateBitCast(envArg, envType->getPointerTo());
+    for (size_t i = 0; i < captures.size(); ++i)
+    {
+        llvm::Value *slot = builder.CreateConstInBoundsGEP2_32(envType, envArray, 0, i);
+        llvm::Value *address = builder.CreateLoad(i8Ptr, slot);
+        context.namedValues[captures[i].first] =
+            builder.CreateBitCast(address, captures[i].second->getType(), captures[i].first);
+    }
+
+    vector<llvm::Value *> shared;
+    for (const auto &reduction : reductions)
+    {
+        llvm::Type *type = context.getLLVMType(reduction.type);
+        shared.push_back(context.namedValues[string(reduction.var)]);
+        llvm::Value *priv = context.createEntryAlloca(type, reduction.var + ".private");
+        builder.CreateStore(reductionIdentity(reduction.op, reduction.type, type), priv);
+        context.namedValues[string(reduction.var)] = priv;
+    }
+
+    llvm::AllocaInst *index = context.createEntryAlloca(i64, var + ".index");
+    builder.CreateStore(rangeLo, index);
+
+    std::string lineSuffix = ".line" + std::to_string(lineNumber);
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(ctx, "parallel.cond", bodyFunc);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(ctx, "loop" + lineSuffix, bodyFunc);
+    llvm::BasicBlock *latchBB = llvm::BasicBlock::Create(ctx, "parallel.next", bodyFunc);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(ctx, "parallel.done", bodyFunc);
+    builder.CreateBr(condBB);
+
+    builder.SetInsertPoint(condBB);
+    llvm::Value *current = builder.CreateLoad(i64, index);
+    builder.CreateCondBr(builder.CreateICmpSLT(current, rangeHi), loopBB, doneBB);
+
+    builder.SetInsertPoint(loopBB);
+    llvm::Value *loopVar = context.createVariable(context.getLLVMType(indexType), var);
+    builder.CreateStore(context.convertValue(current, "int64", indexType), loopVar);
+    context.setBreakBlock(nullptr);
+    context.setContinueBlock(latchBB);
+    body->codegen(context);
+    if (!builder.GetInsertBlock()->getTerminator())
+        builder.CreateBr(latchBB);
+
+    builder.SetInsertPoint(latchBB);
+    builder.CreateStore(builder.CreateNSWAdd(builder.CreateLoad(i64, index), builder.getInt64(1)), index);
+    builder.CreateBr(condBB);
+
+    builder.SetInsertPoint(doneBB);
+    context.emitImplicitSync();
+    if (!reductions.empty())
+    {
+        llvm::FunctionType *lockType = llvm::FunctionType::get(builder.getVoidTy(), false);
+        builder.CreateCall(context.runtimeFunction("flec_rt_lock", lockType));
+        for (size_t i = 0; i < reductions.size(); ++i)
+        {
+            const Reduction &reduction = reductions[i];
+            llvm::Type *type = context.getLLVMType(reduction.type);
+            llvm::Value *total = builder.CreateLoad(type, shared[i]);
+            llvm::Value *partial = builder.CreateLoad(type, context.namedValues[string(reduction.var)]);
+            builder.CreateStore(combineReduction(context, reduction.op, reduction.type, total, partial), shared[i]);
+        }
+        builder.CreateCall(context.runtimeFunction("flec_rt_unlock", lockType));
+    }
+    builder.CreateRetVoid();
+
+    context.leaveDebugFunction(outerDebug);
+    context.namedValues = savedValues;
+    context.setBreakBlock(prevBreak);
+    context.setContinueBlock(prevContinue);
+    context.topLevel = wasTopLevel;
+    context.syncGroup = outerGroup;
+    context.generator = outerGenerator;
+    context.regionMarks.swap(outerRegions);
+    context.loopRegions = outerLoopRegions;
+    builder.SetInsertPoint(callerBlock);
+
+    llvm::FunctionType *forType = llvm::FunctionType::get(
+        builder.getVoidTy(), {i64, i64, bodyType->getPointerTo(), i8Ptr}, false);
+    builder.CreateCall(context.runtimeFunction("flec_parallel_for", forType),
+                       {loVal, hiVal, bodyFunc, builder.CreateBitCast(env, i8Ptr)});
+    return nullptr;
 }
 
-llvm::Value *ContinueNode::codegen(CodeGenContext &context)
+// The block is outlined into `void flec.spawn.line<N>(i8* env)`. env is a
+// malloc'd struct holding the value of every outer variable the block only
+// reads, followed by the address of every one it writes; the runtime frees it
+// once the task has run.
+llvm::Value *SpawnNode::codegen(CodeGenContext &context)
 {
-    if (!context.getContinueBlock())
+    llvm::LLVMContext &ctx = context.llvmContext;
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Type *i8Ptr = builder.getInt8PtrTy();
+
+    vector<llvm::Type *> fields;
+    for (const auto &var : copied)
+        fields.push_back(context.getLLVMType(var.second));
+    for (const auto &var : shared)
+        fields.push_back(context.getLLVMType(var.second)->getPointerTo());
+    llvm::StructType *envType = llvm::StructType::get(ctx, fields);
+
+    llvm::FunctionType *mallocType = llvm::FunctionType::get(i8Ptr, {builder.getInt64Ty()}, false);
+    llvm::Constant *envSize = llvm::ConstantExpr::getSizeOf(envType);
+    llvm::Value *envMemory = builder.CreateCall(context.runtimeFunction("malloc", mallocType), {envSize}, "spawn.env");
+    llvm::Value *env = builder.CreateBitCast(envMemory, envType->getPointerTo());
+    for (size_t i = 0; i < copied.size(); ++i)
+    {
+        llvm::Value *value = builder.CreateLoad(fields[i], context.namedValues[copied[i].first]);
+        // The task may still run after the spawning block's region is gone.
+        if (copied[i].second == "string")
+            value = context.callStringRuntime("flec_str_keep", context.stringType(), {value});
+        builder.CreateStore(value, builder.CreateStructGEP(envType, env, i));
+    }
+    for (size_t i = 0; i < shared.size(); ++i)
+    {
+        unsigned field = copied.size() + i;
+        builder.CreateStore(context.namedValues[shared[i].first], builder.CreateStructGEP(envType, env, field));
+    }
+
+    llvm::FunctionType *taskType = llvm::FunctionType::get(builder.getVoidTy(), {i8Ptr}, false);
+    llvm::Function *taskFunc = llvm::Function::Create(taskType, llvm::Function::InternalLinkage,
+                                                      "flec.spawn.line" + std::to_string(lineNumber),
+                                                      context.module.get());
+
+    llvm::BasicBlock *callerBlock = builder.GetInsertBlock();
+    auto savedValues = context.namedValues;
+    llvm::BasicBlock *prevBreak = context.getBreakBlock();
+    llvm::BasicBlock *prevContinue = context.getContinueBlock();
+    bool wasTopLevel = context.topLevel;
+    llvm::Value *outerGroup = context.syncGroup;
+    CodeGenContext::GeneratorState *outerGenerator = context.generator;
+    vector<llvm::Value *> outerRegions;
+    outerRegions.swap(context.regionMarks);
+    size_t outerLoopRegions = context.loopRegions;
+    context.topLevel = false;
+    context.syncGroup = nullptr;
+    context.generator = nullptr;
+    context.loopRegions = 0;
+    context.setBreakBlock(nullptr);
+    context.setContinueBlock(nullptr);
+    DebugInfo::Outer outerDebug = context.enterDebugFunction(taskFunc, lineNumber);
+
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(ctx, "entry", taskFunc);
+    builder.SetInsertPoint(entryBB);
+    llvm::Value *envArg = taskFunc->getArg(0);
+    envArg->setName("env");
+    llvm::Value *taskEnv = builder.CreateBitCast(envArg, envType->getPointerTo());
+    for (size_t i = 0; i < copied.size(); ++i)
+    {
+        llvm::Value *value = builder.CreateLoad(fields[i], builder.CreateStructGEP(envType, taskEnv, i));
+        builder.CreateStore(value, context.createVariable(fields[i], copied[i].first));
+    }
+    for (size_t i = 0; i < shared.size(); ++i)
     {
-        cerr << "Error: {skip} used outside of loop.\n";
+        unsigned field = copied.size() + i;
+        context.namedValues[shared[i].first] =
+            builder.CreateLoad(fields[field], builder.CreateStructGEP(envType, taskEnv, field), shared[i].first);
+    }
+
+    body->codegen(context);
+    if (!builder.GetInsertBlock()->getTerminator())
+    {
+        context.emitImplicitSync();
+        builder.CreateRetVoid();
+    }
+
+    context.leaveDebugFunction(outerDebug);
+    context.namedValues = savedValues;
+    context.setBreakBlock(prevBreak);
+    context.setContinueBlock(prevContinue);
+    context.topLevel = wasTopLevel;
+    context.syncGroup = outerGroup;
+    context.generator = outerGenerator;
+    context.regionMarks.swap(outerRegions);
+    context.loopRegions = outerLoopRegions;
+    builder.SetInsertPoint(callerBlock);
+
+    llvm::FunctionType *spawnType = llvm::FunctionType::get(
+        builder.getVoidTy(), {builder.getInt64Ty()->getPointerTo(), taskType->getPointerTo(), i8Ptr}, false);
+    builder.CreateCall(context.runtimeFunction("flec_spawn", spawnType),
+                       {context.getSyncGroup(), taskFunc, envMemory});
+    return nullptr;
+}
+
+llvm::Value *SyncNode::codegen(CodeGenContext &context)
+{
+    context.getSyncGroup();
+    context.emitImplicitSync();
+    return nullptr;
+}
+
+// The body becomes a switched-resume LLVM coroutine
+// `i8* flec.gen.<name>(i8* env, T* out)`: the call sets up the frame and stops
+// at an initial suspend; each resume runs to the next yield, which leaves its
+// value in *out. env holds the addresses of the outer variables the body
+// uses, and lives in the defining function. Once the coroutine passes have
+// run, a loop that creates and destroys a generator in one function gets its
+// frame on the stack and the body inlined.
+llvm::Value *GenNode::codegen(CodeGenContext &context)
+{
+    llvm::LLVMContext &ctx = context.llvmContext;
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Module *module = context.module.get();
+    llvm::Type *i8Ptr = builder.getInt8PtrTy();
+    llvm::Type *elemType = context.getLLVMType(elementType);
+
+    vector<llvm::Type *> fields;
+    for (const auto &var : captured)
+        fields.push_back(context.namedValues[var.first]->getType());
+    llvm::StructType *envType = llvm::StructType::get(ctx, fields);
+    llvm::AllocaInst *env = context.createEntryAlloca(envType, name + ".env");
+    for (size_t i = 0; i < captured.size(); ++i)
+        builder.CreateStore(context.namedValues[captured[i].first], builder.CreateStructGEP(envType, env, i));
+
+    llvm::FunctionType *genType = llvm::FunctionType::get(i8Ptr, {i8Ptr, elemType->getPointerTo()}, false);
+    llvm::Function *genFunc = llvm::Function::Create(genType, llvm::Function::InternalLinkage,
+                                                     "flec.gen." + name, module);
+    // Marks the function for CoroSplit; LLVM 14 leaves this to the front end.
+    genFunc->addFnAttr("coroutine.presplit", "0");
+    context.generatorFunctions[string(name)] = genFunc;
+    context.usesCoroutines = true;
+
+    llvm::BasicBlock *callerBlock = builder.GetInsertBlock();
+    auto savedValues = context.namedValues;
+    llvm::BasicBlock *prevBreak = context.getBreakBlock();
+    llvm::BasicBlock *prevContinue = context.getContinueBlock();
+    bool wasTopLevel = context.topLevel;
+    llvm::Value *outerGroup = context.syncGroup;
+    CodeGenContext::GeneratorState *outerGenerator = context.generator;
+    vector<llvm::Value *> outerRegions;
+    outerRegions.swap(context.regionMarks);
+    size_t outerLoopRegions = context.loopRegions;
+    context.topLevel = false;
+    context.syncGroup = nullptr;
+    context.loopRegions = 0;
+    context.setBreakBlock(nullptr);
+    context.setContinueBlock(nullptr);
+    DebugInfo::Outer outerDebug = context.enterDebugFunction(genFunc, lineNumber);
+
+    llvm::Value *envArg = genFunc->getArg(0);
+    llvm::Value *outArg = genFunc->getArg(1);
+    envArg->setName("env");
+    outArg->setName("out");
+
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(ctx, "entry", genFunc);
+    llvm::BasicBlock *allocBB = llvm::BasicBlock::Create(ctx, "coro.alloc", genFunc);
+    llvm::BasicBlock *beginBB = llvm::BasicBlock::Create(ctx, "coro.begin", genFunc);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(ctx, "gen.body", genFunc);
+    llvm::BasicBlock *cleanupBB = llvm::BasicBlock::Create(ctx, "coro.cleanup", genFunc);
+    llvm::BasicBlock *freeBB = llvm::BasicBlock::Create(ctx, "coro.free", genFunc);
+    llvm::BasicBlock *suspendBB = llvm::BasicBlock::Create(ctx, "coro.suspend", genFunc);
+
+    auto intrinsic = [&](llvm::Intrinsic::ID id, llvm::ArrayRef<llvm::Type *> types = {})
+    {
+        return llvm::Intrinsic::getDeclaration(module, id, types);
+    };
+    llvm::Value *nullPtr = llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(i8Ptr));
+
+    // Allocate the frame unless CoroElide proves the caller can hold it.
+    builder.SetInsertPoint(entryBB);
+    llvm::Value *id = builder.CreateCall(intrinsic(llvm::Intrinsic::coro_id),
+                                         {builder.getInt32(0), nullPtr, nullPtr, nullPtr}, "id");
+    llvm::Value *needAlloc = builder.CreateCall(intrinsic(llvm::Intrinsic::coro_alloc), {id}, "need.alloc");
+    builder.CreateCondBr(needAlloc, allocBB, beginBB);
+
+    builder.SetInsertPoint(allocBB);
+    llvm::Value *size = builder.CreateCall(intrinsic(llvm::Intrinsic::coro_size, {builder.getInt64Ty()}), {}, "size");
+    llvm::FunctionType *mallocType = llvm::FunctionType::get(i8Ptr, {builder.getInt64Ty()}, false);
+    llvm::Value *memory = builder.CreateCall(context.runtimeFunction("malloc", mallocType), {size}, "frame");
+    builder.CreateBr(beginBB);
+
+    builder.SetInsertPoint(beginBB);
+    llvm::PHINode *frameMemory = builder.CreatePHI(i8Ptr, 2, "frame.memory");
+    frameMemory->addIncoming(nullPtr, entryBB);
+    frameMemory->addIncoming(memory, allocBB);
+    llvm::Value *handle = builder.CreateCall(intrinsic(llvm::Intrinsic::coro_begin), {id, frameMemory}, "handle");
+
+    llvm::Value *typedEnv = builder.CreateBitCast(envArg, envType->getPointerTo());
+    for (size_t i = 0; i < captured.size(); ++i)
+    {
+        context.namedValues[captured[i].first] =
+            builder.CreateLoad(fields[i], builder.CreateStructGEP(envType, typedEnv, i), captured[i].first);
+    }
+
+    CodeGenContext::GeneratorState state{elementType, outArg, cleanupBB, suspendBB};
+    context.generator = &state;
+
+    // Nothing runs until the first resume.
+    llvm::Value *token = llvm::ConstantTokenNone::get(ctx);
+    llvm::Function *suspend = intrinsic(llvm::Intrinsic::coro_suspend);
+    llvm::SwitchInst *initial = builder.CreateSwitch(builder.CreateCall(suspend, {token, builder.getFalse()}),
+                                                     suspendBB, 2);
+    initial->addCase(builder.getInt8(0), bodyBB);
+    initial->addCase(builder.getInt8(1), cleanupBB);
+
+    builder.SetInsertPoint(bodyBB);
+    body->codegen(context);
+    if (!builder.GetInsertBlock()->getTerminator())
+    {
+        context.emitImplicitSync();
+        llvm::BasicBlock *trapBB = llvm::BasicBlock::Create(ctx, "gen.resumed.after.end", genFunc);
+        llvm::SwitchInst *final = builder.CreateSwitch(builder.CreateCall(suspend, {token, builder.getTrue()}),
+                                                       suspendBB, 2);
+        final->addCase(builder.getInt8(0), trapBB);
+        final->addCase(builder.getInt8(1), cleanupBB);
+        builder.SetInsertPoint(trapBB);
+        builder.CreateUnreachable();
+    }
+
+    builder.SetInsertPoint(cleanupBB);
+    llvm::Value *toFree = builder.CreateCall(intrinsic(llvm::Intrinsic::coro_free), {id, handle}, "to.free");
+    builder.CreateCondBr(builder.CreateIsNotNull(toFree), freeBB, suspendBB);
+
+    builder.SetInsertPoint(freeBB);
+    llvm::FunctionType *freeType = llvm::FunctionType::get(builder.getVoidTy(), {i8Ptr}, false);
+    builder.CreateCall(context.runtimeFunction("free", freeType), {toFree});
+    builder.CreateBr(suspendBB);
+
+    builder.SetInsertPoint(suspendBB);
+    builder.CreateCall(intrinsic(llvm::Intrinsic::coro_end), {handle, builder.getFalse()});
+    builder.CreateRet(handle);
+
+    context.leaveDebugFunction(outerDebug);
+    context.namedValues = savedValues;
+    context.setBreakBlock(prevBreak);
+    context.setContinueBlock(prevContinue);
+    context.topLevel = wasTopLevel;
+    context.syncGroup = outerGroup;
+    context.generator = outerGenerator;
+    context.regionMarks.swap(outerRegions);
+    context.loopRegions = outerLoopRegions;
+    builder.SetInsertPoint(callerBlock);
+
+    llvm::Value *genVar = context.createVariable(i8Ptr, name);
+    builder.CreateStore(builder.CreateBitCast(env, i8Ptr), genVar);
+    return nullptr;
+}
+
+llvm::Value *YieldNode::codegen(CodeGenContext &context)
+{
+    CodeGenContext::GeneratorState *gen = context.generator;
+    if (!gen)
+    {
+        cerr << "Error: 'yield' used outside of a generator.\n";
+        return nullptr;
+    }
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Value *value = context.convertValue(expr->codegen(context), exprType, gen->elementType);
+    builder.CreateStore(value, gen->out);
+
+    llvm::Function *func = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *resumeBB = llvm::BasicBlock::Create(context.llvmContext, "gen.resume", func);
+    llvm::Function *suspend = llvm::Intrinsic::getDeclaration(context.module.get(), llvm::Intrinsic::coro_suspend);
+    llvm::Value *state = builder.CreateCall(suspend, {llvm::ConstantTokenNone::get(context.llvmContext),
+                                                      builder.getFalse()});
+    llvm::SwitchInst *dispatch = builder.CreateSwitch(state, gen->suspend, 2);
+    dispatch->addCase(builder.getInt8(0), resumeBB);
+    dispatch->addCase(builder.getInt8(1), gen->cleanup);
+
+    builder.SetInsertPoint(resumeBB);
+    return nullptr;
+}
+
+llvm::Value *RepeatInNode::codegen(CodeGenContext &context)
+{
+    llvm::LLVMContext &ctx = context.llvmContext;
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::Module *module = context.module.get();
+
+    auto found = context.generatorFunctions.find(string(generator));
+    if (found == context.generatorFunctions.end() || found->second->getParent() != module)
+    {
+        cerr << "Error: generator '" << generator << "' is not defined in this file.\n";
         return nullptr;
     }
+    llvm::Function *genFunc = found->second;
+    llvm::Type *elemType = context.getLLVMType(elementType);
+
+    llvm::Value *env = builder.CreateLoad(builder.getInt8PtrTy(), context.namedValues[string(generator)], generator);
+    llvm::AllocaInst *out = context.createEntryAlloca(elemType, var + ".next");
+    llvm::Value *handle = builder.CreateCall(genFunc, {env, out}, generator + ".handle");
+
+    llvm::Function *func = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *headerBB = llvm::BasicBlock::Create(ctx, "loop.line" + std::to_string(lineNumber), func);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(ctx, "gen.next", func);
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(ctx, "gen.done", func);
+    builder.CreateBr(headerBB);
+
+    builder.SetInsertPoint(headerBB);
+    builder.CreateCall(llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_resume), {handle});
+    llvm::Value *done = builder.CreateCall(llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_done),
+                                           {handle}, "done");
+    builder.CreateCondBr(done, afterBB, bodyBB);
+
+    builder.SetInsertPoint(bodyBB);
+    llvm::Value *loopVar = context.createVariable(elemType, var);
+    builder.CreateStore(builder.CreateLoad(elemType, out), loopVar);
+
+    llvm::BasicBlock *prevBreak = context.getBreakBlock();
+    llvm::BasicBlock *prevContinue = context.getContinueBlock();
+    size_t outerLoopRegions = context.loopRegions;
+    context.setBreakBlock(afterBB);
+    context.setContinueBlock(headerBB);
+    context.loopRegions = context.regionMarks.size();
+    body->codegen(context);
+    if (!builder.GetInsertBlock()->getTerminator())
+        builder.CreateBr(headerBB);
+    context.loopRegions = outerLoopRegions;
+    context.setBreakBlock(prevBreak);
+    context.setContinueBlock(prevContinue);
+
+    builder.SetInsertPoint(afterBB);
+    builder.CreateCall(llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_destroy), {handle});
+    return nullptr;
+}
+
+llvm::Value *BreakNode::codegen(CodeGenContext &context)
+{
+    // Analysis rejects this; a tree that gets here anyway must not compile
+    // with the jump left out.
+    if (!context.getBreakBlock())
+        throw std::runtime_error("line " + to_string(line) + ": 'stop' used outside of loop");
+    context.exitRegions(context.loopRegions);
+    return context.builder.CreateBr(context.getBreakBlock());
+}
+
+llvm::Value *ImportNode::codegen(CodeGenContext &context)
+{
+    // The driver links in the library's module, which defines these.
+    for (const Symbol &symbol : *exports)
+        context.importGlobal(symbol.name, context.getLLVMType(symbol.type));
+    return nullptr;
+}
+
+llvm::Value *ContinueNode::codegen(CodeGenContext &context)
+{
+    if (!context.getContinueBlock())
+        throw std::runtime_error("line " + to_string(line) + ": 'skip' used outside of loop");
+    context.exitRegions(context.loopRegions);
     return context.builder.CreateBr(context.getContinueBlock());
 }
 
 llvm::Value *BuiltinCallNode::codegen(CodeGenContext &context)
 {
+    if (!builtin)
+    {
+        cerr << "Error: unknown built-in function: " << funcName << endl;
+        return nullptr;
+    }
+    llvm::IRBuilder<> &builder = context.builder;
+
+    // Analysis already knows the answer; the argument is never evaluated.
+    if (builtin->id == BuiltinId::Typeof)
+        return context.stringLiteral(argTypes[0]);
+
     vector<llvm::Value *> argValues;
-    for (auto &arg : args)
+    for (size_t i = 0; i < args.size(); ++i)
     {
-        llvm::Value *val = arg->codegen(context);
+        llvm::Value *val = args[i]->codegen(context);
         if (!val)
             return nullptr;
-        argValues.push_back(val);
+        const string &param = builtin->params[i];
+        bool generic = param == BUILTIN_NUMERIC || param == BUILTIN_INTEGER;
+        argValues.push_back(context.convertValue(val, argTypes[i], generic ? operandType : param));
     }
 
-    llvm::Function *callee = context.module->getFunction(funcName);
-    if (!callee)
+    bool isFloat = operandType == "float";
+    bool isSigned = intTypeInfo(operandType).isSigned;
+    auto intrinsic = [&](llvm::Intrinsic::ID id, llvm::ArrayRef<llvm::Value *> operands, const char *name)
     {
-        cerr << "Error: unknown built-in function: " << funcName << endl;
-        return nullptr;
-    }
+        return builder.CreateIntrinsic(id, {operands[0]->getType()}, operands, nullptr, name);
+    };
 
-    return context.builder.CreateCall(callee, argValues, funcName + "_call");
+    switch (builtin->id)
+    {
+    case BuiltinId::Len:
+        return builder.CreateTrunc(context.stringLength(argValues[0]), builder.getInt32Ty(), "len_call");
+    case BuiltinId::Substr:
+        return context.callStringRuntime("flec_str_substr", context.stringType(),
+                                         {argValues[0], argValues[1], argValues[2], builder.getInt32(temporary)});
+    case BuiltinId::Abs:
+        if (isFloat)
+            return intrinsic(llvm::Intrinsic::fabs, argValues, "abs");
+        if (!isSigned)
+            return argValues[0];
+        return intrinsic(llvm::Intrinsic::abs, {argValues[0], builder.getFalse()}, "abs");
+    case BuiltinId::Min:
+        return intrinsic(isFloat    ? llvm::Intrinsic::minnum
+                         : isSigned ? llvm::Intrinsic::smin
+                                    : llvm::Intrinsic::umin,
+                         argValues, "min");
+    case BuiltinId::Max:
+        return intrinsic(isFloat    ? llvm::Intrinsic::maxnum
+                         : isSigned ? llvm::Intrinsic::smax
+                                    : llvm::Intrinsic::umax,
+                         argValues, "max");
+    case BuiltinId::Sqrt:
+        return intrinsic(llvm::Intrinsic::sqrt, argValues, "sqrt");
+    case BuiltinId::Pow:
+        return intrinsic(llvm::Intrinsic::pow, argValues, "pow");
+    case BuiltinId::Floor:
+        return intrinsic(llvm::Intrinsic::floor, argValues, "floor");
+    case BuiltinId::Randint:
+        return context.randomInRange(argValues[0], argValues[1], isSigned);
+    case BuiltinId::Clear:
+    {
+        // ANSI: erase the screen and move the cursor home.
+        llvm::FunctionType *printfType = llvm::FunctionType::get(builder.getInt32Ty(), {builder.getInt8PtrTy()}, true);
+        return builder.CreateCall(context.runtimeFunction("printf", printfType),
+                                  {builder.CreateGlobalStringPtr("\x1b[2J\x1b[H", "clearscreen")});
+    }
+    case BuiltinId::Typeof:
+        break;
+    }
+    return nullptr;
 }
 
 /*llvm::Value *InputStmtNode::codegen(CodeGenContext &context)
@@ -592,6 +1225,19 @@ llvm::Value *BuiltinCallNode::codegen(CodeGenContext &context)
 }*/
 llvm::Value *InputStmtNode::codegen(CodeGenContext &context)
 {
+    // A string is read by the runtime, so words of any length fit.
+    if (inputType == "string")
+    {
+        llvm::Value *ptr = context.namedValues[string(varName)];
+        if (!ptr)
+            ptr = context.createVariable(context.stringType(), varName);
+        llvm::Value *word = context.callStringRuntime("flec_str_input", context.stringType(),
+                                                      {context.builder.getInt32(temporary)});
+        context.builder.CreateStore(word, ptr);
+        context.symbolTable[string(varName)] = inputType;
+        return word;
+    }
+
     // Declare scanf if not already present
     llvm::Function *scanfFunc = context.module->getFunction("scanf");
     if (!scanfFunc)
@@ -610,10 +1256,14 @@ llvm::Value *InputStmtNode::codegen(CodeGenContext &context)
     llvm::Value *ptr = nullptr;
 
     // Choose LLVM type and format string
-    if (inputType == "int")
+    IntTypeInfo intInfo = intTypeInfo(inputType);
+    if (intInfo.bits)
     {
-        llvmType = llvm::Type::getInt32Ty(context.llvmContext);
-        fmt = "%d";
+        static const char *signedFormats[] = {"%hhd", "%hd", "%d", "%lld"};
+        static const char *unsignedFormats[] = {"%hhu", "%hu", "%u", "%llu"};
+        int index = intInfo.bits == 8 ? 0 : intInfo.bits == 16 ? 1 : intInfo.bits == 32 ? 2 : 3;
+        llvmType = context.getLLVMType(inputType);
+        fmt = intInfo.isSigned ? signedFormats[index] : unsignedFormats[index];
     }
     else if (inputType == "float")
     {
@@ -625,30 +1275,23 @@ llvm::Value *InputStmtNode::codegen(CodeGenContext &context)
         llvmType = llvm::Type::getInt32Ty(context.llvmContext); // use i32 for scanf
         fmt = "%d";
     }
-    else if (inputType == "string")
-    {
-        llvmType = llvm::ArrayType::get(llvm::Type::getInt8Ty(context.llvmContext), 256);
-        fmt = "%s";
-    }
     else
     {
         std::cerr << "Unsupported input type: " << inputType << std::endl;
         return nullptr;
     }
 
-    // Allocate variable if not already allocated
-    ptr = context.namedValues[varName];
-    if (!ptr)
+    // Allocate variable if not already allocated. A bool is read into an i32
+    // scratch slot and converted below, so its variable is created there.
+    if (inputType == "bool")
     {
-        ptr = context.builder.CreateAlloca(llvmType, nullptr, varName);
-        context.namedValues[varName] = ptr;
+        ptr = context.createEntryAlloca(llvmType, varName + "_raw");
     }
-
-    // For string, cast array ptr to i8*
-    if (inputType == "string")
+    else
     {
-        ptr = context.builder.CreatePointerCast(
-            ptr, llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(context.llvmContext)));
+        ptr = context.namedValues[string(varName)];
+        if (!ptr)
+            ptr = context.createVariable(llvmType, varName);
     }
 
     // Create format string for scanf
@@ -667,39 +1310,24 @@ llvm::Value *InputStmtNode::codegen(CodeGenContext &context)
             intVal,
             llvm::ConstantInt::get(llvm::Type::getInt32Ty(context.llvmContext), 0));
 
-        llvm::Value *boolPtr = context.namedValues[varName + "_bool"];
+        llvm::Value *boolPtr = context.namedValues[string(varName)];
         if (!boolPtr)
-        {
-            boolPtr = context.builder.CreateAlloca(
-                llvm::Type::getInt1Ty(context.llvmContext), nullptr, varName + "_bool");
-            context.namedValues[varName + "_bool"] = boolPtr;
-        }
+            boolPtr = context.createVariable(llvm::Type::getInt1Ty(context.llvmContext), varName);
 
         context.builder.CreateStore(boolVal, boolPtr);
-
-        // Optionally: update main varName to i1 bool pointer
-        context.namedValues[varName] = boolPtr;
     }
 
     // Update symbol table
-    context.symbolTable[varName] = inputType;
+    context.symbolTable[string(varName)] = inputType;
 
     return call;
 }
 
-// These destructors must be defined even if they’re empty. This forces the compiler to emit the vtable.
-LiteralNode::~LiteralNode() {}
-IdentifierNode::~IdentifierNode() {}
-BinaryExprNode::~BinaryExprNode() {}
-UnaryExprNode::~UnaryExprNode() {}
-DeclarationNode::~DeclarationNode() {}
-PrintStmtNode::~PrintStmtNode() {}
-ReturnStmtNode::~ReturnStmtNode() {}
-IfStmtNode::~IfStmtNode() {}
-RepeatStmtNode::~RepeatStmtNode() {}
-AssignmentNode::~AssignmentNode() {}
-BlockNode::~BlockNode() {}
-ProgramNode::~ProgramNode() {}
-BreakNode::~BreakNode() {}
-ContinueNode::~ContinueNode() {}
-BuiltinCallNode::~BuiltinCallNode() {}
\ No newline at end of file
+llvm::Value *OutputNode::codegen(CodeGenContext &context)
+{
+    llvm::IRBuilder<> &builder = context.builder;
+    llvm::FunctionType *printfType = llvm::FunctionType::get(builder.getInt32Ty(), {builder.getInt8PtrTy()}, true);
+    return builder.CreateCall(context.runtimeFunction("printf", printfType),
+                              {builder.CreateGlobalStringPtr("%s", "fmtoutput"),
+                               builder.CreateGlobalStringPtr(llvm::StringRef(text.data(), text.size()), "output")});
+}
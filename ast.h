@@ -1,12 +1,16 @@
 #pragma once
+#include <functional>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <vector>
 #include <iostream>
 #include "SymbolTable.h"
 #include <llvm/IR/Value.h>
 #include <llvm/IR/LLVMContext.h>
+#include "builtins.h"
 #include "codegen.h"
+#include "loop_hints.h"
 
 using namespace llvm;
 using namespace std;
@@ -21,11 +25,22 @@ public:
     virtual void print() const = 0;
     virtual string analyze(SymbolTable &symbols) = 0;
     virtual llvm::Value *codegen(CodeGenContext &context) = 0;
+
+    // For the passes over a whole program (ast_walk.cpp): the nodes directly
+    // below this one, statements and expressions alike, in source order, and
+    // the variables it uses by name rather than through an identifier node
+    // (captures, reductions, the generator a repeat-in loop resumes).
+    virtual void forEachChild(const function<void(ASTNode *)> &) {}
+    virtual void forEachCapture(const function<void(string_view)> &) {}
+
     int lineNumber;
 };
 
 using ASTNodePtr = unique_ptr<ASTNode>;
 
+// Names and literal text in the nodes are string_views into the source and
+// the text arena (see source.h): a tree must not outlive the next loadSource.
+
 // ===== Expression Nodes =====
 
 class LiteralNode : public ASTNode
@@ -40,11 +55,12 @@ public:
         Bool
     };
     Type type;
-    string value;
+    string_view value; // in the source, the text arena or static storage
+    string intType = "int"; // integer literals: the width chosen by analysis
 
     ~LiteralNode() override;
 
-    LiteralNode(Type t, const string &val) : type(t), value(val) {}
+    LiteralNode(Type t, string_view val) : type(t), value(val) {}
 
     void print() const override { cout << "Literal(" << value << ")"; }
     string analyze(SymbolTable &symbols) override;
@@ -54,12 +70,12 @@ public:
 class IdentifierNode : public ASTNode
 {
 public:
-    string name;
+    string_view name;
     string type;
 
     ~IdentifierNode() override;
 
-    IdentifierNode(const string &id) : name(id) {}
+    IdentifierNode(string_view id) : name(id) {}
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
@@ -88,6 +104,12 @@ public:
     ASTNodePtr left;
     ASTNodePtr right;
     Op op;
+    // Filled in by analysis: operand types and the common type both are
+    // converted to before the operation.
+    string leftType;
+    string rightType;
+    string operandType;
+    bool temporary = false; // string concatenation: allocate in the innermost region
 
     ~BinaryExprNode() override;
 
@@ -96,6 +118,7 @@ public:
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
 
     void print() const override
     {
@@ -177,6 +200,7 @@ public:
     }
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
 };
 
 // ===== Statement Nodes =====
@@ -184,17 +208,20 @@ public:
 class DeclarationNode : public ASTNode
 {
 public:
-    string typeName;
-    string identifier;
+    string_view typeName;
+    string_view identifier;
     ASTNodePtr expr;
+    string exprType; // set by analysis; converted to typeName in codegen
+    bool promote = false; // set by analysis: copy a string out of its region first
 
     ~DeclarationNode() override;
 
-    DeclarationNode(const string &type, const string &id, ASTNodePtr e)
+    DeclarationNode(string_view type, string_view id, ASTNodePtr e)
         : typeName(type), identifier(id), expr(move(e)) {}
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
 
     void print() const override
     {
@@ -208,6 +235,7 @@ class PrintStmtNode : public ASTNode
 {
 public:
     ASTNodePtr expr;
+    string exprType; // set by analysis; selects the printf format
 
     ~PrintStmtNode() override;
 
@@ -215,6 +243,7 @@ public:
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
 
     void print() const override
     {
@@ -235,6 +264,7 @@ public:
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
 
     void print() const override
     {
@@ -258,6 +288,7 @@ public:
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
 
     void print() const override
     {
@@ -273,11 +304,66 @@ public:
     }
 };
 
+// match (e) { 1 => { ... } 2, 3 => { ... } else => { ... } }: runs the block
+// of the arm that lists e's value, or the else block when none does. e is an
+// integer and the labels are integer constants, each listed once; codegen
+// turns the whole statement into one LLVM switch.
+class MatchNode : public ASTNode
+{
+public:
+    struct Arm
+    {
+        vector<ASTNodePtr> labels;
+        ASTNodePtr body;
+        int line;
+        vector<unsigned long long> values; // set by analysis: the labels, two's complement
+    };
+
+    ASTNodePtr subject;
+    vector<Arm> arms;
+    ASTNodePtr elseBlock;
+    string subjectType; // set by analysis
+
+    ~MatchNode() override;
+
+    MatchNode(ASTNodePtr subject, vector<Arm> arms, ASTNodePtr elseBlk)
+        : subject(move(subject)), arms(move(arms)), elseBlock(move(elseBlk)) {}
+
+    string analyze(SymbolTable &symbols) override;
+    llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
+
+    void print() const override
+    {
+        cout << "Match(";
+        subject->print();
+        cout << ")";
+        for (const auto &arm : arms)
+        {
+            const char *separator = " ";
+            for (const auto &label : arm.labels)
+            {
+                cout << separator;
+                label->print();
+                separator = ", ";
+            }
+            cout << " => ";
+            arm.body->print();
+        }
+        if (elseBlock)
+        {
+            cout << " Else => ";
+            elseBlock->print();
+        }
+    }
+};
+
 class RepeatStmtNode : public ASTNode
 {
 public:
     ASTNodePtr condition;
     ASTNodePtr body;
+    LoopHints hints;
 
     ~RepeatStmtNode() override;
 
@@ -286,9 +372,16 @@ public:
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
 
     void print() const override
     {
+        if (hints.unroll)
+            cout << "@unroll(" << hints.unrollCount << ") ";
+        if (hints.vectorize >= 0)
+            cout << (hints.vectorize ? "@vectorize " : "@novectorize ");
+        if (hints.interleaveCount)
+            cout << "@interleave(" << hints.interleaveCount << ") ";
         cout << "Repeat(";
         condition->print();
         cout << ") ";
@@ -296,19 +389,233 @@ public:
     }
 };
 
+// parallel repeat i in lo..hi reduce(+: s) { ... }
+// Iterations run on the runtime's thread pool in no particular order; i takes
+// every value from lo up to but not including hi.
+class ParallelRepeatNode : public ASTNode
+{
+public:
+    enum class ReduceOp
+    {
+        Add,
+        Mul,
+        Min,
+        Max
+    };
+    struct Reduction
+    {
+        ReduceOp op;
+        string_view var;
+        string type; // set by analysis
+    };
+
+    string_view var;
+    ASTNodePtr lo;
+    ASTNodePtr hi;
+    ASTNodePtr body;
+    vector<Reduction> reductions;
+    string indexType = "int"; // set by analysis
+    string loType, hiType;
+
+    ~ParallelRepeatNode() override;
+
+    ParallelRepeatNode(string_view var, ASTNodePtr lo, ASTNodePtr hi, ASTNodePtr body)
+        : var(var), lo(move(lo)), hi(move(hi)), body(move(body)) {}
+
+    string analyze(SymbolTable &symbols) override;
+    llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
+    void forEachCapture(const function<void(string_view)> &visit) override;
+
+    void print() const override
+    {
+        static const char *opNames[] = {"+", "*", "min", "max"};
+        cout << "ParallelRepeat(" << var << " in ";
+        lo->print();
+        cout << "..";
+        hi->print();
+        for (const auto &r : reductions)
+            cout << " reduce(" << opNames[static_cast<int>(r.op)] << ": " << r.var << ")";
+        cout << ") ";
+        body->print();
+    }
+};
+
+// spawn { ... }: the block runs as a task, concurrently with the code after
+// it, until the next sync (or the end of the enclosing program, spawn block or
+// parallel repeat body). It sees the outer variables it only reads as they
+// were at the spawn; the ones it writes are shared and may not be touched by
+// anyone else before the sync.
+class SpawnNode : public ASTNode
+{
+public:
+    ASTNodePtr body;
+    vector<pair<string, string>> copied; // name, type: set by analysis
+    vector<pair<string, string>> shared;
+
+    ~SpawnNode() override;
+
+    SpawnNode(ASTNodePtr body) : body(move(body)) {}
+
+    string analyze(SymbolTable &symbols) override;
+    llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
+    void forEachCapture(const function<void(string_view)> &visit) override;
+
+    void print() const override
+    {
+        cout << "Spawn ";
+        body->print();
+    }
+};
+
+class SyncNode : public ASTNode
+{
+public:
+    ~SyncNode() override;
+
+    string analyze(SymbolTable &symbols) override;
+    llvm::Value *codegen(CodeGenContext &context) override;
+
+    void print() const override { cout << "Sync"; }
+};
+
+// gen name { ... yield e ... }: defines a generator. Nothing runs until a
+// `repeat v in name` loop resumes it; each loop gets a fresh instance, which
+// sees the outer variables as they are at each resume.
+class GenNode : public ASTNode
+{
+public:
+    string_view name;
+    ASTNodePtr body;
+    string elementType;               // set by analysis
+    vector<pair<string, string>> captured; // outer variables used: name, type
+
+    ~GenNode() override;
+
+    GenNode(string_view name, ASTNodePtr body) : name(name), body(move(body)) {}
+
+    string analyze(SymbolTable &symbols) override;
+    llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
+    void forEachCapture(const function<void(string_view)> &visit) override;
+
+    void print() const override
+    {
+        cout << "Gen(" << name << ") ";
+        body->print();
+    }
+};
+
+class YieldNode : public ASTNode
+{
+public:
+    ASTNodePtr expr;
+    string exprType; // set by analysis
+
+    ~YieldNode() override;
+
+    YieldNode(ASTNodePtr expr) : expr(move(expr)) {}
+
+    string analyze(SymbolTable &symbols) override;
+    llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
+
+    void print() const override
+    {
+        cout << "Yield(";
+        expr->print();
+        cout << ")";
+    }
+};
+
+// repeat v in name { ... }: runs the body once per value the generator yields.
+class RepeatInNode : public ASTNode
+{
+public:
+    string_view var;
+    string_view generator;
+    ASTNodePtr body;
+    string elementType; // set by analysis
+
+    ~RepeatInNode() override;
+
+    RepeatInNode(string_view var, string_view generator, ASTNodePtr body)
+        : var(var), generator(generator), body(move(body)) {}
+
+    string analyze(SymbolTable &symbols) override;
+    llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
+    void forEachCapture(const function<void(string_view)> &visit) override;
+
+    void print() const override
+    {
+        cout << "RepeatIn(" << var << " in " << generator << ") ";
+        body->print();
+    }
+};
+
+// repeat i in a..b step s { ... }: i takes every value from a up to but not
+// including b, s apart; with a negative s, from a down to but not including
+// b. a and b are evaluated once and s is a constant (1 when left out), so the
+// trip count is known before the first iteration. i is read-only in the body.
+class RepeatRangeNode : public ASTNode
+{
+public:
+    string_view var;
+    ASTNodePtr lo;
+    ASTNodePtr hi;
+    ASTNodePtr step; // null: 1
+    ASTNodePtr body;
+    LoopHints hints;
+    // Set by analysis.
+    string indexType = "int";
+    string loType, hiType;
+    unsigned long long stepSize = 1;
+    bool descending = false;
+
+    ~RepeatRangeNode() override;
+
+    RepeatRangeNode(string_view var, ASTNodePtr lo, ASTNodePtr hi, ASTNodePtr step, ASTNodePtr body)
+        : var(var), lo(move(lo)), hi(move(hi)), step(move(step)), body(move(body)) {}
+
+    string analyze(SymbolTable &symbols) override;
+    llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
+
+    void print() const override
+    {
+        cout << "RepeatRange(" << var << " in ";
+        lo->print();
+        cout << "..";
+        hi->print();
+        if (step)
+        {
+            cout << " step ";
+            step->print();
+        }
+        cout << ") ";
+        body->print();
+    }
+};
+
 class AssignmentNode : public ASTNode
 {
 public:
-    string name;
+    string_view name;
     ASTNodePtr value;
+    string valueType;  // set by analysis
+    string targetType; // declared type of name
+    bool promote = false; // set by analysis: copy a string out of its region first
 
     ~AssignmentNode() override;
 
-    AssignmentNode(string name, ASTNodePtr value)
-        : name(move(name)), value(move(value)) {}
+    AssignmentNode(string_view name, ASTNodePtr value)
+        : name(name), value(move(value)) {}
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
 
     void print() const override
     {
@@ -322,6 +629,7 @@ class BlockNode : public ASTNode
 {
 public:
     vector<ASTNodePtr> statements;
+    int temporaries = 0; // set by analysis: allocations in this block's region
 
     ~BlockNode() override;
 
@@ -330,6 +638,7 @@ public:
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
 
     void print() const override
     {
@@ -346,12 +655,13 @@ public:
 class InputStmtNode : public ASTNode
 {
 public:
-    std::string inputType; // e.g., "int"
-    std::string varName;   // single variable name
+    std::string_view inputType; // e.g., "int"
+    std::string_view varName;   // single variable name
+    bool temporary = false; // set by analysis: a string goes in the innermost region
 
     ~InputStmtNode() override = default;
 
-    InputStmtNode(const std::string &type, const std::string &var)
+    InputStmtNode(std::string_view type, std::string_view var)
         : inputType(type), varName(var) {}
 
     void print() const override
@@ -364,6 +674,27 @@ public:
     llvm::Value *codegen(CodeGenContext &context) override;
 };
 
+// Text a run of the program writes at this point, worked out by the partial
+// evaluator (see evaluator.h). Never parsed: the evaluator puts it in place
+// of the statements that printed it. Written as is, with no newline added.
+class OutputNode : public ASTNode
+{
+public:
+    string_view text; // in the text arena; holds no zero byte
+
+    ~OutputNode() override = default;
+
+    OutputNode(string_view output) : text(output) {}
+
+    void print() const override
+    {
+        cout << "Output(" << text.size() << " bytes)";
+    }
+
+    string analyze(SymbolTable &symbols) override;
+    llvm::Value *codegen(CodeGenContext &context) override;
+};
+
 // ===== Program Node (Root) =====
 
 class ProgramNode : public ASTNode
@@ -390,6 +721,26 @@ public:
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
+};
+
+// import "lib.flec": declares the top-level variables of another file, whose
+// top-level statements run before the importing file's. The importer (see
+// interface.h) points the node at the library's symbols before analysis.
+class ImportNode : public ASTNode
+{
+public:
+    string_view path;
+    const vector<Symbol> *exports = nullptr;
+
+    ~ImportNode() override;
+
+    ImportNode(string_view path) : path(path) {}
+
+    string analyze(SymbolTable &symbols) override;
+    llvm::Value *codegen(CodeGenContext &context) override;
+
+    void print() const override { cout << "Import(\"" << path << "\")"; }
 };
 
 class BreakNode : public ASTNode
@@ -431,12 +782,16 @@ public:
 class BuiltinCallNode : public ASTNode
 {
 public:
-    string funcName;
+    string_view funcName;
     vector<ASTNodePtr> args;
+    vector<string> argTypes; // filled by analyze
+    const Builtin *builtin = nullptr; // set by analysis
+    string operandType;      // set by analysis: the common type of the generic arguments
+    bool temporary = false;  // set by analysis: a string result goes in the innermost region
 
     ~BuiltinCallNode() override;
 
-    BuiltinCallNode(const string &name, vector<ASTNodePtr> arguments)
+    BuiltinCallNode(string_view name, vector<ASTNodePtr> arguments)
         : funcName(name), args(move(arguments)) {}
 
     void print() const override
@@ -453,4 +808,5 @@ public:
 
     string analyze(SymbolTable &symbols) override;
     llvm::Value *codegen(CodeGenContext &context) override;
+    void forEachChild(const function<void(ASTNode *)> &visit) override;
 };
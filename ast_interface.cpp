@@ -1,4 +1,8 @@
 #include "ast_interface.h"
+#include "source.h"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
 
 // Global AST root
 // unique_ptr<ProgramNode> astRoot = nullptr;
@@ -41,9 +45,20 @@ void addToProgram(unique_ptr<ASTNode> stmt)
 }
 
 // -------------------- Literal Builders --------------------
-unique_ptr<LiteralNode> makeIntLiteral(int value, int line)
+// Literal text that is not in the source as written, such as a number
+// printed back from its value, goes in the text arena.
+static string_view keepText(const char *text, size_t length)
 {
-    auto node = make_unique<LiteralNode>(LiteralNode::Type::Int, to_string(value));
+    char *kept = allocateText(length);
+    memcpy(kept, text, length);
+    return string_view(kept, length);
+}
+
+unique_ptr<LiteralNode> makeIntLiteral(unsigned long long value, int line)
+{
+    char digits[24];
+    char *last = to_chars(digits, digits + sizeof(digits), value).ptr;
+    auto node = make_unique<LiteralNode>(LiteralNode::Type::Int, keepText(digits, last - digits));
     node->lineNumber = line;
 
     return node;
@@ -51,12 +66,14 @@ unique_ptr<LiteralNode> makeIntLiteral(int value, int line)
 
 unique_ptr<LiteralNode> makeFloatLiteral(float value, int line)
 {
-    auto node = make_unique<LiteralNode>(LiteralNode::Type::Float, to_string(value));
+    char text[64];
+    int length = snprintf(text, sizeof(text), "%f", value); // as to_string formats it
+    auto node = make_unique<LiteralNode>(LiteralNode::Type::Float, keepText(text, length));
     node->lineNumber = line;
     return node;
 }
 
-unique_ptr<LiteralNode> makeStringLiteral(const string &value, int line)
+unique_ptr<LiteralNode> makeStringLiteral(string_view value, int line)
 {
     auto node = make_unique<LiteralNode>(LiteralNode::Type::String, value);
     node->lineNumber = line;
@@ -65,7 +82,7 @@ unique_ptr<LiteralNode> makeStringLiteral(const string &value, int line)
 
 unique_ptr<LiteralNode> makeCharLiteral(char value, int line)
 {
-    auto node = make_unique<LiteralNode>(LiteralNode::Type::Char, string(1, value));
+    auto node = make_unique<LiteralNode>(LiteralNode::Type::Char, keepText(&value, 1));
     node->lineNumber = line;
     return node;
 }
@@ -78,7 +95,7 @@ unique_ptr<LiteralNode> makeBoolLiteral(bool value, int line)
 }
 
 // -------------------- Identifier --------------------
-unique_ptr<IdentifierNode> makeIdentifier(const string &name, int line)
+unique_ptr<IdentifierNode> makeIdentifier(string_view name, int line)
 {
     auto node = make_unique<IdentifierNode>(name);
     node->lineNumber = line;
@@ -106,8 +123,8 @@ unique_ptr<UnaryExprNode> makeUnaryExpr(UnaryExprNode::Op op, unique_ptr<ASTNode
 
 // -------------------- Statements --------------------
 unique_ptr<DeclarationNode> makeDeclaration(
-    const string &type,
-    const string &name,
+    string_view type,
+    string_view name,
     unique_ptr<ASTNode> expr,
     int line)
 {
@@ -124,7 +141,7 @@ unique_ptr<PrintStmtNode> makePrintStmt(unique_ptr<ASTNode> expr, int line)
     return node;
 }
 
-std::unique_ptr<InputStmtNode> makeInputStmt(const std::string &type, const std::string &name, int line)
+std::unique_ptr<InputStmtNode> makeInputStmt(std::string_view type, std::string_view name, int line)
 {
     auto node = std::make_unique<InputStmtNode>(type, name);
     node->lineNumber = line;
@@ -149,6 +166,22 @@ unique_ptr<IfStmtNode> makeIfStmt(
     return node;
 }
 
+unique_ptr<MatchNode> makeMatch(
+    unique_ptr<ASTNode> subject,
+    vector<MatchNode::Arm> arms,
+    unique_ptr<ASTNode> elseBlock,
+    int line)
+{
+    auto node = make_unique<MatchNode>(move(subject), move(arms), move(elseBlock));
+    node->lineNumber = line;
+    return node;
+}
+
+void addMatchArm(vector<MatchNode::Arm> &arms, vector<ASTNodePtr> labels, unique_ptr<ASTNode> body, int line)
+{
+    arms.push_back({move(labels), move(body), line, {}});
+}
+
 unique_ptr<RepeatStmtNode> makeRepeatStmt(
     unique_ptr<ASTNode> condition,
     unique_ptr<ASTNode> body,
@@ -159,8 +192,142 @@ unique_ptr<RepeatStmtNode> makeRepeatStmt(
     return node;
 }
 
+unique_ptr<RepeatStmtNode> makeRepeatStmt(
+    unique_ptr<ASTNode> condition,
+    unique_ptr<ASTNode> body,
+    const LoopHints &hints,
+    int line)
+{
+    auto node = makeRepeatStmt(move(condition), move(body), line);
+    node->hints = hints;
+    return node;
+}
+
+bool addLoopHint(LoopHints &hints, string_view name, long long argument, bool hasArgument, int line)
+{
+    if (hasArgument && (argument < 1 || argument > 1024))
+    {
+        cerr << "Line " << line << ": @" << name << " expects a count between 1 and 1024\n";
+        semanticError = true;
+        return false;
+    }
+
+    if (name == "unroll")
+    {
+        hints.unroll = true;
+        hints.unrollCount = hasArgument ? static_cast<int>(argument) : 0;
+    }
+    else if (name == "vectorize" && !hasArgument)
+    {
+        hints.vectorize = 1;
+    }
+    else if (name == "novectorize" && !hasArgument)
+    {
+        hints.vectorize = 0;
+    }
+    else if (name == "interleave" && hasArgument)
+    {
+        hints.interleaveCount = static_cast<int>(argument);
+    }
+    else
+    {
+        cerr << "Line " << line << ": unknown loop hint '@" << name << (hasArgument ? "(...)" : "") << "'\n";
+        semanticError = true;
+        return false;
+    }
+    return true;
+}
+
+// -------------------- Parallel Repeat --------------------
+unique_ptr<ParallelRepeatNode> makeParallelRepeat(
+    string_view var,
+    unique_ptr<ASTNode> lo,
+    unique_ptr<ASTNode> hi,
+    vector<ParallelRepeatNode::Reduction> reductions,
+    unique_ptr<ASTNode> body,
+    int line)
+{
+    auto node = make_unique<ParallelRepeatNode>(var, move(lo), move(hi), move(body));
+    node->reductions = move(reductions);
+    node->lineNumber = line;
+    return node;
+}
+
+bool addReduction(vector<ParallelRepeatNode::Reduction> &reductions, string_view op, string_view var, int line)
+{
+    ParallelRepeatNode::ReduceOp kind;
+    if (op == "+")
+        kind = ParallelRepeatNode::ReduceOp::Add;
+    else if (op == "*")
+        kind = ParallelRepeatNode::ReduceOp::Mul;
+    else if (op == "min")
+        kind = ParallelRepeatNode::ReduceOp::Min;
+    else if (op == "max")
+        kind = ParallelRepeatNode::ReduceOp::Max;
+    else
+    {
+        cerr << "Line " << line << ": unknown reduction '" << op << "' (expected +, *, min or max)\n";
+        semanticError = true;
+        return false;
+    }
+    reductions.push_back({kind, var, ""});
+    return true;
+}
+
+// -------------------- Spawn / Sync --------------------
+unique_ptr<SpawnNode> makeSpawn(unique_ptr<ASTNode> body, int line)
+{
+    auto node = make_unique<SpawnNode>(move(body));
+    node->lineNumber = line;
+    return node;
+}
+
+unique_ptr<SyncNode> makeSync(int line)
+{
+    auto node = make_unique<SyncNode>();
+    node->lineNumber = line;
+    return node;
+}
+
+// -------------------- Generators --------------------
+unique_ptr<GenNode> makeGen(string_view name, unique_ptr<ASTNode> body, int line)
+{
+    auto node = make_unique<GenNode>(name, move(body));
+    node->lineNumber = line;
+    return node;
+}
+
+unique_ptr<YieldNode> makeYield(unique_ptr<ASTNode> expr, int line)
+{
+    auto node = make_unique<YieldNode>(move(expr));
+    node->lineNumber = line;
+    return node;
+}
+
+unique_ptr<RepeatInNode> makeRepeatIn(string_view var, string_view generator, unique_ptr<ASTNode> body, int line)
+{
+    auto node = make_unique<RepeatInNode>(var, generator, move(body));
+    node->lineNumber = line;
+    return node;
+}
+
+unique_ptr<RepeatRangeNode> makeRepeatRange(
+    string_view var,
+    unique_ptr<ASTNode> lo,
+    unique_ptr<ASTNode> hi,
+    unique_ptr<ASTNode> step,
+    unique_ptr<ASTNode> body,
+    const LoopHints &hints,
+    int line)
+{
+    auto node = make_unique<RepeatRangeNode>(var, move(lo), move(hi), move(step), move(body));
+    node->hints = hints;
+    node->lineNumber = line;
+    return node;
+}
+
 // -------------------- Assignment --------------------
-unique_ptr<ASTNode> makeAssignment(const string &name, unique_ptr<ASTNode> expr, int line)
+unique_ptr<ASTNode> makeAssignment(string_view name, unique_ptr<ASTNode> expr, int line)
 {
     auto node = make_unique<AssignmentNode>(name, move(expr));
     node->lineNumber = line;
@@ -180,6 +347,14 @@ void addToBlock(BlockNode *block, unique_ptr<ASTNode> stmt)
     block->statements.push_back(move(stmt));
 }
 
+// -------------------- Import --------------------
+unique_ptr<ImportNode> makeImport(string_view path, int line)
+{
+    auto node = make_unique<ImportNode>(path);
+    node->lineNumber = line;
+    return node;
+}
+
 // -------------------- Break/Continue --------------------
 unique_ptr<BreakNode> makeBreak(int line)
 {
@@ -196,7 +371,7 @@ unique_ptr<ContinueNode> makeContinue(int line)
 }
 
 // -------------------- Builtin Call --------------------
-unique_ptr<BuiltinCallNode> makeBuiltinCall(const string &name, vector<ASTNodePtr> args, int line)
+unique_ptr<BuiltinCallNode> makeBuiltinCall(string_view name, vector<ASTNodePtr> args, int line)
 {
     auto node = make_unique<BuiltinCallNode>(name, move(args));
     node->lineNumber = line;
@@ -1,76 +1,128 @@
-#pragma once
-#include "ast.h"
-#include <memory>
-
-using namespace std;
-
-// an error flag
-extern bool semanticError;
-
-// The root of the AST will be stored here
-extern unique_ptr<ProgramNode> astRoot;
-
-// Functions to build AST nodes — called from parser actions
-unique_ptr<LiteralNode> makeIntLiteral(int value, int line);
-unique_ptr<LiteralNode> makeFloatLiteral(float value, int line);
-unique_ptr<LiteralNode> makeStringLiteral(const string &value, int line);
-unique_ptr<LiteralNode> makeCharLiteral(char value, int line);
-unique_ptr<LiteralNode> makeBoolLiteral(bool value, int line);
-
-unique_ptr<IdentifierNode> makeIdentifier(const string &name, int line);
-
-unique_ptr<BinaryExprNode> makeBinaryExpr(
-    unique_ptr<ASTNode> left,
-    BinaryExprNode::Op op,
-    unique_ptr<ASTNode> right,
-    int line);
-
-unique_ptr<UnaryExprNode> makeUnaryExpr(
-    UnaryExprNode::Op op,
-    unique_ptr<ASTNode> operand,
-    int line);
-
-unique_ptr<DeclarationNode> makeDeclaration(
-    const string &type,
-    const string &name,
-    unique_ptr<ASTNode> expr,
-    int line);
-
-unique_ptr<PrintStmtNode> makePrintStmt(unique_ptr<ASTNode> expr, int line);
-unique_ptr<ReturnStmtNode> makeReturnStmt(unique_ptr<ASTNode> expr, int line);
-
-unique_ptr<IfStmtNode> makeIfStmt(
-    unique_ptr<ASTNode> condition,
-    unique_ptr<ASTNode> thenBlock,
-    unique_ptr<ASTNode> elseBlock,
-    int line);
-
-unique_ptr<RepeatStmtNode> makeRepeatStmt(
-    unique_ptr<ASTNode> condition,
-    unique_ptr<ASTNode> body,
-    int line);
-
-unique_ptr<ASTNode> makeAssignment(
-    const string &name,
-    unique_ptr<ASTNode> expr,
-    int line);
-
-unique_ptr<BlockNode> makeBlock(
-    unique_ptr<vector<unique_ptr<ASTNode>>> stmts,
-    int line);
-
-void addToBlock(BlockNode *block, unique_ptr<ASTNode> stmt);
-
-ProgramNode *makeProgram();
-// unique_ptr<ProgramNode> makeProgram();
-void addToProgram(unique_ptr<ASTNode> stmt);
-
-unique_ptr<BreakNode> makeBreak(int line);
-unique_ptr<ContinueNode> makeContinue(int line);
-
-unique_ptr<BuiltinCallNode> makeBuiltinCall(
-    const string &name,
-    vector<ASTNodePtr> args,
-    int line);
-
-std::unique_ptr<InputStmtNode> makeInputStmt(const std::string &type, const std::string &name, int line);
+#pragma once
+#include "ast.h"
+#include <memory>
+
+using namespace std;
+
+// an error flag
+extern bool semanticError;
+
+// The root of the AST will be stored here
+extern unique_ptr<ProgramNode> astRoot;
+
+// Functions to build AST nodes — called from parser actions
+unique_ptr<LiteralNode> makeIntLiteral(unsigned long long value, int line);
+unique_ptr<LiteralNode> makeFloatLiteral(float value, int line);
+unique_ptr<LiteralNode> makeStringLiteral(string_view value, int line);
+unique_ptr<LiteralNode> makeCharLiteral(char value, int line);
+unique_ptr<LiteralNode> makeBoolLiteral(bool value, int line);
+
+unique_ptr<IdentifierNode> makeIdentifier(string_view name, int line);
+
+unique_ptr<BinaryExprNode> makeBinaryExpr(
+    unique_ptr<ASTNode> left,
+    BinaryExprNode::Op op,
+    unique_ptr<ASTNode> right,
+    int line);
+
+unique_ptr<UnaryExprNode> makeUnaryExpr(
+    UnaryExprNode::Op op,
+    unique_ptr<ASTNode> operand,
+    int line);
+
+unique_ptr<DeclarationNode> makeDeclaration(
+    string_view type,
+    string_view name,
+    unique_ptr<ASTNode> expr,
+    int line);
+
+unique_ptr<PrintStmtNode> makePrintStmt(unique_ptr<ASTNode> expr, int line);
+unique_ptr<ReturnStmtNode> makeReturnStmt(unique_ptr<ASTNode> expr, int line);
+
+unique_ptr<IfStmtNode> makeIfStmt(
+    unique_ptr<ASTNode> condition,
+    unique_ptr<ASTNode> thenBlock,
+    unique_ptr<ASTNode> elseBlock,
+    int line);
+
+unique_ptr<MatchNode> makeMatch(
+    unique_ptr<ASTNode> subject,
+    vector<MatchNode::Arm> arms,
+    unique_ptr<ASTNode> elseBlock,
+    int line);
+
+// Append `labels => body` to the arms of a match.
+void addMatchArm(vector<MatchNode::Arm> &arms, vector<ASTNodePtr> labels, unique_ptr<ASTNode> body, int line);
+
+unique_ptr<RepeatStmtNode> makeRepeatStmt(
+    unique_ptr<ASTNode> condition,
+    unique_ptr<ASTNode> body,
+    int line);
+
+unique_ptr<RepeatStmtNode> makeRepeatStmt(
+    unique_ptr<ASTNode> condition,
+    unique_ptr<ASTNode> body,
+    const LoopHints &hints,
+    int line);
+
+// Fold one @hint into hints; name is the hint without '@'. Returns false
+// (after reporting) for an unknown hint or a bad argument.
+bool addLoopHint(LoopHints &hints, string_view name, long long argument, bool hasArgument, int line);
+
+unique_ptr<ParallelRepeatNode> makeParallelRepeat(
+    string_view var,
+    unique_ptr<ASTNode> lo,
+    unique_ptr<ASTNode> hi,
+    vector<ParallelRepeatNode::Reduction> reductions,
+    unique_ptr<ASTNode> body,
+    int line);
+
+// Append `op: var` from a reduce clause; op is +, *, min or max. Returns false
+// (after reporting) for any other operator.
+bool addReduction(vector<ParallelRepeatNode::Reduction> &reductions, string_view op, string_view var, int line);
+
+unique_ptr<SpawnNode> makeSpawn(unique_ptr<ASTNode> body, int line);
+unique_ptr<SyncNode> makeSync(int line);
+
+unique_ptr<GenNode> makeGen(string_view name, unique_ptr<ASTNode> body, int line);
+unique_ptr<YieldNode> makeYield(unique_ptr<ASTNode> expr, int line);
+unique_ptr<RepeatInNode> makeRepeatIn(string_view var, string_view generator, unique_ptr<ASTNode> body, int line);
+
+// step may be null.
+unique_ptr<RepeatRangeNode> makeRepeatRange(
+    string_view var,
+    unique_ptr<ASTNode> lo,
+    unique_ptr<ASTNode> hi,
+    unique_ptr<ASTNode> step,
+    unique_ptr<ASTNode> body,
+    const LoopHints &hints,
+    int line);
+
+unique_ptr<ASTNode> makeAssignment(
+    string_view name,
+    unique_ptr<ASTNode> expr,
+    int line);
+
+unique_ptr<BlockNode> makeBlock(
+    unique_ptr<vector<unique_ptr<ASTNode>>> stmts,
+    int line);
+
+void addToBlock(BlockNode *block, unique_ptr<ASTNode> stmt);
+
+ProgramNode *makeProgram();
+// unique_ptr<ProgramNode> makeProgram();
+void addToProgram(unique_ptr<ASTNode> stmt);
+
+// The path is kept as written; the importer resolves it against the
+// directory of the importing file.
+unique_ptr<ImportNode> makeImport(string_view path, int line);
+
+unique_ptr<BreakNode> makeBreak(int line);
+unique_ptr<ContinueNode> makeContinue(int line);
+
+unique_ptr<BuiltinCallNode> makeBuiltinCall(
+    string_view name,
+    vector<ASTNodePtr> args,
+    int line);
+
+std::unique_ptr<InputStmtNode> makeInputStmt(std::string_view type, std::string_view name, int line);
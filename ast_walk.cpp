@@ -0,0 +1,148 @@
+// ast_walk.cpp
+// The children and captures of each node, for the passes that look at a
+// whole program rather than one node at a time: dead-code elimination, the
+// incremental build's partition and the globals a module imports.
+#include "ast.h"
+
+namespace
+{
+    void visitIf(const ASTNodePtr &child, const function<void(ASTNode *)> &visit)
+    {
+        if (child)
+            visit(child.get());
+    }
+}
+
+void BinaryExprNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(left, visit);
+    visitIf(right, visit);
+}
+
+void UnaryExprNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(operand, visit);
+}
+
+void BuiltinCallNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    for (const auto &arg : args)
+        visitIf(arg, visit);
+}
+
+void DeclarationNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(expr, visit);
+}
+
+void AssignmentNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(value, visit);
+}
+
+void PrintStmtNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(expr, visit);
+}
+
+void ReturnStmtNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(expr, visit);
+}
+
+void IfStmtNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(condition, visit);
+    visitIf(thenBlock, visit);
+    visitIf(elseBlock, visit);
+}
+
+void MatchNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(subject, visit);
+    for (const auto &arm : arms)
+    {
+        for (const auto &label : arm.labels)
+            visitIf(label, visit);
+        visitIf(arm.body, visit);
+    }
+    visitIf(elseBlock, visit);
+}
+
+void RepeatStmtNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(condition, visit);
+    visitIf(body, visit);
+}
+
+void RepeatRangeNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(lo, visit);
+    visitIf(hi, visit);
+    visitIf(step, visit);
+    visitIf(body, visit);
+}
+
+void ParallelRepeatNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(lo, visit);
+    visitIf(hi, visit);
+    visitIf(body, visit);
+}
+
+void ParallelRepeatNode::forEachCapture(const function<void(string_view)> &visit)
+{
+    for (const auto &reduction : reductions)
+        visit(reduction.var);
+}
+
+void SpawnNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(body, visit);
+}
+
+void SpawnNode::forEachCapture(const function<void(string_view)> &visit)
+{
+    for (const auto &var : copied)
+        visit(var.first);
+    for (const auto &var : shared)
+        visit(var.first);
+}
+
+void GenNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(body, visit);
+}
+
+void GenNode::forEachCapture(const function<void(string_view)> &visit)
+{
+    for (const auto &var : captured)
+        visit(var.first);
+}
+
+void YieldNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(expr, visit);
+}
+
+void RepeatInNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    visitIf(body, visit);
+}
+
+void RepeatInNode::forEachCapture(const function<void(string_view)> &visit)
+{
+    visit(generator);
+}
+
+void BlockNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    for (const auto &stmt : statements)
+        visitIf(stmt, visit);
+}
+
+void ProgramNode::forEachChild(const function<void(ASTNode *)> &visit)
+{
+    for (const auto &stmt : statements)
+        visitIf(stmt, visit);
+}
@@ -0,0 +1,29 @@
+// builtins.cpp
+#include "builtins.h"
+
+namespace
+{
+    const Builtin BUILTINS[] = {
+        {"len", BuiltinId::Len, {"string"}, "int"},
+        {"substr", BuiltinId::Substr, {"string", "int64", "int64"}, "string", true},
+        {"abs", BuiltinId::Abs, {BUILTIN_NUMERIC}, BUILTIN_NUMERIC},
+        {"min", BuiltinId::Min, {BUILTIN_NUMERIC, BUILTIN_NUMERIC}, BUILTIN_NUMERIC},
+        {"max", BuiltinId::Max, {BUILTIN_NUMERIC, BUILTIN_NUMERIC}, BUILTIN_NUMERIC},
+        {"sqrt", BuiltinId::Sqrt, {"float"}, "float"},
+        {"pow", BuiltinId::Pow, {"float", "float"}, "float"},
+        {"floor", BuiltinId::Floor, {"float"}, "float"},
+        {"randint", BuiltinId::Randint, {BUILTIN_INTEGER, BUILTIN_INTEGER}, BUILTIN_INTEGER, false, true},
+        {"typeof", BuiltinId::Typeof, {BUILTIN_ANY}, "string"},
+        {"clear", BuiltinId::Clear, {}, "void", false, true},
+    };
+}
+
+const Builtin *findBuiltin(std::string_view name)
+{
+    for (const Builtin &builtin : BUILTINS)
+    {
+        if (name == builtin.name)
+            return &builtin;
+    }
+    return nullptr;
+}
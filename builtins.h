@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Built-in functions. Analysis checks each call against the signature here
+// and BuiltinCallNode::codegen lowers it by id; none of them is a call into
+// the module, so adding one means a row here and a case there. Shared by
+// analysis and codegen, so it must not depend on LLVM.
+
+enum class BuiltinId
+{
+    Len,
+    Substr,
+    Abs,
+    Min,
+    Max,
+    Sqrt,
+    Pow,
+    Floor,
+    Randint,
+    Typeof,
+    Clear
+};
+
+// Parameter and result types are Flec type names or one of the generic
+// placeholders below. The arguments passed for placeholders are converted to
+// one common type, which is also the type of a placeholder result.
+inline const std::string BUILTIN_NUMERIC = "numeric"; // any integer type, or float
+inline const std::string BUILTIN_INTEGER = "integer"; // any integer type
+inline const std::string BUILTIN_ANY = "any";         // any type; the argument is not evaluated
+
+struct Builtin
+{
+    const char *name;
+    BuiltinId id;
+    std::vector<std::string> params;
+    std::string result;
+    bool allocates = false; // returns a new runtime string
+    bool effects = false;   // changes state besides returning a value: never removed as dead code
+};
+
+// The built-in called name, or null.
+const Builtin *findBuiltin(std::string_view name);
@@ -0,0 +1,23 @@
+// check_main.cpp
+//
+// Entry point of flec-check: parse and type-check only. Built without LLVM
+// libraries so pre-commit hooks do not pay for loading them.
+#include "driver.h"
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <source file>...\n";
+        return 1;
+    }
+
+    int result = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (checkFile(argv[i]) != 0) {
+            std::cerr << argv[i] << ": check failed\n";
+            result = 1;
+        }
+    }
+    return result;
+}
@@ -1,16 +1,28 @@
 // codegen.cpp
 #include "codegen.h"
 #include "ast.h"
+#include "runtime.h"
+#include "types.h"
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/DiagnosticPrinter.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/raw_os_ostream.h>
+#include <llvm/Support/raw_ostream.h>
 #include <iostream>
+#include <stdexcept>
+#include <unordered_set>
 
 using namespace llvm;
 
-llvm::Type *CodeGenContext::getLLVMType(const std::string &typeName)
+llvm::Type *CodeGenContext::getLLVMType(std::string_view typeName)
 {
-    if (typeName == "int")
+    IntTypeInfo intInfo = intTypeInfo(typeName);
+    if (intInfo.bits)
     {
-        return llvm::Type::getInt32Ty(llvmContext);
+        return llvm::Type::getIntNTy(llvmContext, intInfo.bits);
     }
     else if (typeName == "float")
     {
@@ -21,13 +33,25 @@ llvm::Type *CodeGenContext::getLLVMType(const std::string &typeName)
         return llvm::Type::getInt1Ty(llvmContext);
     }
     else if (typeName == "string")
-        return llvm::Type::getInt8Ty(llvmContext)->getPointerTo();
+        return stringType();
+    else if (isGeneratorType(typeName))
+        return llvm::Type::getInt8Ty(llvmContext)->getPointerTo(); // the generator's env
 
     // Add more types as needed
     return nullptr;
 }
 
-llvm::Value *CodeGenContext::generateCode(ProgramNode *root)
+// Report IR the verifier rejects as a codegen error; left alone it would
+// only show up later, as a crash in the optimizer or llc.
+static void verifyGenerated(const llvm::Module &module)
+{
+    std::string message;
+    llvm::raw_string_ostream out(message);
+    if (llvm::verifyModule(module, &out))
+        throw std::runtime_error("invalid IR generated: " + out.str());
+}
+
+llvm::Value *CodeGenContext::generateCode(ProgramNode *root, const std::string &sourcePath)
 {
     if (!root)
     {
@@ -35,13 +59,21 @@ llvm::Value *CodeGenContext::generateCode(ProgramNode *root)
         return nullptr;
     }
 
+    if (emitDebugInfo)
+        debugInfo = std::make_unique<DebugInfo>(*module, sourcePath);
+
     FunctionType *mainFuncType = FunctionType::get(Type::getInt32Ty(llvmContext), false);
     Function *mainFunction = Function::Create(mainFuncType, Function::ExternalLinkage, "main", module.get());
     BasicBlock *entry = BasicBlock::Create(llvmContext, "entry", mainFunction);
     builder.SetInsertPoint(entry);
+    enterDebugFunction(mainFunction, 1);
+    syncGroup = nullptr;
+    if (rtStats)
+        builder.CreateCall(runtimeFunction("flec_rt_stats", FunctionType::get(builder.getVoidTy(), false)));
 
     for (const auto &stmt : root->statements)
     {
+        DebugLine here(*this, stmt->lineNumber);
         stmt->codegen(*this);
         if (builder.GetInsertBlock()->getTerminator())
         {
@@ -53,17 +85,533 @@ llvm::Value *CodeGenContext::generateCode(ProgramNode *root)
 
     if (!builder.GetInsertBlock()->getTerminator())
     {
+        emitImplicitSync();
         builder.CreateRet(ConstantInt::get(Type::getInt32Ty(llvmContext), 0));
     }
 
-    verifyFunction(*mainFunction);
-    module->print(outs(), nullptr);
+    finishDebugInfo();
+    verifyGenerated(*module);
 
     return nullptr;
 }
 
+llvm::Value *CodeGenContext::convertValue(llvm::Value *value, std::string_view fromType, std::string_view toType)
+{
+    if (!value || fromType == toType)
+        return value;
+
+    IntTypeInfo from = intTypeInfo(fromType);
+    IntTypeInfo to = intTypeInfo(toType);
+    if (!from.bits || !to.bits || from.bits == to.bits)
+        return value;
+
+    llvm::Type *target = llvm::Type::getIntNTy(llvmContext, to.bits);
+    if (to.bits < from.bits)
+        return builder.CreateTrunc(value, target, "trunc");
+    return from.isSigned ? builder.CreateSExt(value, target, "sext")
+                         : builder.CreateZExt(value, target, "zext");
+}
+
+DebugInfo::Outer CodeGenContext::enterDebugFunction(llvm::Function *function, int line)
+{
+    return debugInfo ? debugInfo->enterFunction(builder, function, line) : DebugInfo::Outer();
+}
+
+void CodeGenContext::leaveDebugFunction(const DebugInfo::Outer &outer)
+{
+    if (debugInfo)
+        debugInfo->leaveFunction(builder, outer);
+}
+
+void CodeGenContext::describeVariable(llvm::Value *storage, std::string_view name, std::string_view type, int line)
+{
+    if (debugInfo)
+        debugInfo->declareVariable(builder, storage, name, type, line);
+}
+
+void CodeGenContext::finishDebugInfo()
+{
+    if (!debugInfo)
+        return;
+    debugInfo->finish();
+    debugInfo.reset();
+    // Whatever is generated next belongs to no function described so far.
+    builder.SetCurrentDebugLocation(llvm::DebugLoc());
+}
+
+void CodeGenContext::importGlobal(const std::string &name, llvm::Type *type)
+{
+    std::string globalName = "flec.g." + name;
+    llvm::GlobalVariable *global = module->getNamedGlobal(globalName);
+    if (!global)
+        global = new GlobalVariable(*module, type, false, GlobalValue::ExternalLinkage, nullptr, globalName);
+    namedValues[name] = global;
+
+    for (const auto &exported : exportedGlobals)
+    {
+        if (exported.first == name)
+            return;
+    }
+    exportedGlobals.emplace_back(name, type);
+}
+
+llvm::Value *CodeGenContext::createVariable(llvm::Type *type, std::string_view name)
+{
+    llvm::Value *storage = nullptr;
+    if (exportGlobals && topLevel)
+    {
+        storage = new GlobalVariable(*module, type, false, GlobalValue::ExternalLinkage,
+                                     Constant::getNullValue(type), "flec.g." + std::string(name));
+        exportedGlobals.emplace_back(name, type);
+    }
+    else
+    {
+        storage = createEntryAlloca(type, name);
+    }
+    namedValues[std::string(name)] = storage;
+    return storage;
+}
+
+llvm::AllocaInst *CodeGenContext::createEntryAlloca(llvm::Type *type, const llvm::Twine &name)
+{
+    // Slots live in the entry block so a declaration inside a loop reuses one
+    // slot instead of growing the stack on every iteration.
+    llvm::BasicBlock &entry = builder.GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> entryBuilder(&entry, entry.begin());
+    return entryBuilder.CreateAlloca(type, nullptr, name);
+}
+
+std::unique_ptr<llvm::Module> CodeGenContext::generateModule(ProgramNode *root, const std::string &moduleName,
+                                                             const std::string &initName)
+{
+    module = std::make_unique<Module>(moduleName, llvmContext);
+    namedValues.clear();
+    exportGlobals = true;
+    topLevel = true;
+    if (emitDebugInfo)
+        debugInfo = std::make_unique<DebugInfo>(*module, moduleName);
+
+    // Globals exported by earlier modules are visible here as declarations,
+    // of those the module uses: a program built from many modules would
+    // otherwise declare every global in every one of them.
+    std::unordered_set<std::string_view> used;
+    std::function<void(ASTNode *)> findUses = [&](ASTNode *node)
+    {
+        if (auto *id = dynamic_cast<IdentifierNode *>(node))
+            used.insert(id->name);
+        else if (auto *assign = dynamic_cast<AssignmentNode *>(node))
+            used.insert(assign->name);
+        else if (auto *input = dynamic_cast<InputStmtNode *>(node))
+            used.insert(input->varName);
+        node->forEachCapture([&](std::string_view name) { used.insert(name); });
+        node->forEachChild(findUses);
+    };
+    findUses(root);
+    for (const auto &exported : exportedGlobals)
+    {
+        if (!used.count(exported.first))
+            continue;
+        namedValues[exported.first] = new GlobalVariable(*module, exported.second, false,
+                                                         GlobalValue::ExternalLinkage, nullptr,
+                                                         "flec.g." + exported.first);
+    }
+
+    FunctionType *initType = FunctionType::get(Type::getVoidTy(llvmContext), false);
+    Function *initFunction = Function::Create(initType, Function::ExternalLinkage, initName, module.get());
+    BasicBlock *entry = BasicBlock::Create(llvmContext, "entry", initFunction);
+    builder.SetInsertPoint(entry);
+    enterDebugFunction(initFunction, 1);
+    syncGroup = nullptr;
+
+    for (const auto &stmt : root->statements)
+    {
+        DebugLine here(*this, stmt->lineNumber);
+        stmt->codegen(*this);
+        if (builder.GetInsertBlock()->getTerminator())
+            break;
+    }
+
+    if (!builder.GetInsertBlock()->getTerminator())
+    {
+        emitImplicitSync();
+        builder.CreateRetVoid();
+    }
+
+    finishDebugInfo();
+    verifyGenerated(*module);
+
+    auto result = std::move(module);
+    module = std::make_unique<Module>("Flec", llvmContext);
+    return result;
+}
+
+namespace
+{
+    // The linker reports a clash, such as two modules defining one symbol,
+    // to the context's diagnostic handler. The default one writes to
+    // llvm::errs(); this one writes to std::cerr, which the compile server
+    // sends back to its client.
+    class LinkDiagnostics : public DiagnosticHandler
+    {
+    public:
+        bool handleDiagnostics(const DiagnosticInfo &DI) override
+        {
+            llvm::raw_os_ostream out(std::cerr);
+            DiagnosticPrinterRawOStream printer(out);
+            switch (DI.getSeverity())
+            {
+            case DS_Error:
+                out << "link error: ";
+                break;
+            case DS_Warning:
+                out << "link warning: ";
+                break;
+            default:
+                out << "link note: ";
+                break;
+            }
+            DI.print(printer);
+            out << "\n";
+            return true;
+        }
+    };
+}
+
+bool CodeGenContext::linkProgram(std::vector<std::unique_ptr<llvm::Module>> modules,
+                                 const std::vector<std::string> &initNames)
+{
+    module = std::make_unique<Module>("Flec", llvmContext);
+    std::unique_ptr<DiagnosticHandler> previousHandler = llvmContext.getDiagnosticHandler();
+    llvmContext.setDiagnosticHandler(std::make_unique<LinkDiagnostics>());
+    Linker linker(*module);
+    bool linked = true;
+    for (auto &m : modules)
+    {
+        std::string name = m->getModuleIdentifier();
+        if (linker.linkInModule(std::move(m)))
+        {
+            std::cerr << "Failed to link module " << name << "\n";
+            linked = false;
+            break;
+        }
+    }
+    llvmContext.setDiagnosticHandler(std::move(previousHandler));
+    if (!linked)
+        return false;
+
+    FunctionType *mainFuncType = FunctionType::get(Type::getInt32Ty(llvmContext), false);
+    Function *mainFunction = Function::Create(mainFuncType, Function::ExternalLinkage, "main", module.get());
+    BasicBlock *entry = BasicBlock::Create(llvmContext, "entry", mainFunction);
+    builder.SetInsertPoint(entry);
+    if (rtStats)
+        builder.CreateCall(runtimeFunction("flec_rt_stats", FunctionType::get(builder.getVoidTy(), false)));
+    for (const auto &initName : initNames)
+        builder.CreateCall(module->getFunction(initName));
+    builder.CreateRet(ConstantInt::get(Type::getInt32Ty(llvmContext), 0));
+
+    // The program is complete: nothing outside it refers to the globals and
+    // init functions the modules shared, and the optimizer may treat them as
+    // it does the variables of a program built as one module.
+    for (GlobalVariable &global : module->globals())
+    {
+        if (global.getName().startswith("flec.g.") && !global.isDeclaration())
+            global.setLinkage(GlobalValue::InternalLinkage);
+    }
+    for (const auto &initName : initNames)
+        module->getFunction(initName)->setLinkage(GlobalValue::InternalLinkage);
+
+    // Each module was verified when it was generated.
+    std::string message;
+    llvm::raw_string_ostream out(message);
+    if (llvm::verifyFunction(*mainFunction, &out))
+        throw std::runtime_error("invalid IR generated: " + out.str());
+    return true;
+}
+
 llvm::Value *ReturnStmtNode::codegen(CodeGenContext &context)
 {
     // Implement return statement code generation
     return nullptr; // Replace with actual LLVM IR value
 }
+
+void CodeGenContext::attachLoopHints(llvm::Instruction *backEdge, const LoopHints &hints, int line)
+{
+    if (hints.empty())
+        return;
+
+    auto flag = [&](const char *name) -> llvm::Metadata *
+    {
+        return llvm::MDNode::get(llvmContext, {llvm::MDString::get(llvmContext, name)});
+    };
+    auto value = [&](const char *name, llvm::Constant *c) -> llvm::Metadata *
+    {
+        return llvm::MDNode::get(llvmContext, {llvm::MDString::get(llvmContext, name),
+                                               llvm::ConstantAsMetadata::get(c)});
+    };
+    llvm::Type *i32 = builder.getInt32Ty();
+
+    // The first operand of a loop ID is the node itself; it is filled in
+    // below so every loop gets a distinct ID.
+    llvm::SmallVector<llvm::Metadata *, 4> ops = {nullptr};
+    if (hints.unroll)
+    {
+        if (hints.unrollCount)
+            ops.push_back(value("llvm.loop.unroll.count", llvm::ConstantInt::get(i32, hints.unrollCount)));
+        else
+            ops.push_back(flag("llvm.loop.unroll.enable"));
+    }
+    if (hints.vectorize == 1)
+        ops.push_back(value("llvm.loop.vectorize.enable", builder.getTrue()));
+    else if (hints.vectorize == 0)
+        ops.push_back(value("llvm.loop.vectorize.width", llvm::ConstantInt::get(i32, 1)));
+    if (hints.interleaveCount)
+        ops.push_back(value("llvm.loop.interleave.count", llvm::ConstantInt::get(i32, hints.interleaveCount)));
+
+    llvm::MDNode *loopID = llvm::MDNode::getDistinct(llvmContext, ops);
+    loopID->replaceOperandWith(0, loopID);
+    backEdge->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+    hintedLoops.emplace_back(line, hints);
+}
+
+llvm::FunctionCallee CodeGenContext::runtimeFunction(const std::string &name, llvm::FunctionType *type)
+{
+    return module->getOrInsertFunction(name, type);
+}
+
+llvm::StructType *CodeGenContext::stringType()
+{
+    if (llvm::StructType *type = llvm::StructType::getTypeByName(llvmContext, "flec.str"))
+        return type;
+    llvm::Type *word = llvm::Type::getInt64Ty(llvmContext);
+    return llvm::StructType::create(llvmContext, {word, word}, "flec.str");
+}
+
+llvm::Constant *CodeGenContext::stringLiteral(std::string_view value)
+{
+    llvm::Type *word = llvm::Type::getInt64Ty(llvmContext);
+    llvm::Constant *len = llvm::ConstantInt::get(word, value.size());
+    llvm::Constant *data = nullptr;
+    if (value.size() <= 8)
+    {
+        // Short literals are stored inline: the bytes are the data word.
+        uint64_t packed = 0;
+        bool little = module->getDataLayout().isLittleEndian();
+        for (size_t i = 0; i < value.size(); ++i)
+        {
+            unsigned shift = little ? 8 * i : 8 * (7 - i);
+            packed |= uint64_t(static_cast<unsigned char>(value[i])) << shift;
+        }
+        data = llvm::ConstantInt::get(word, packed);
+    }
+    else
+    {
+        GlobalVariable *&global = internedStrings[std::string(value)];
+        if (!global || global->getParent() != module.get())
+        {
+            llvm::Constant *bytes = llvm::ConstantDataArray::getString(llvmContext, value, false);
+            global = new GlobalVariable(*module, bytes->getType(), true, GlobalValue::PrivateLinkage,
+                                        bytes, "str");
+            global->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+            global->setAlignment(llvm::Align(1));
+        }
+        data = llvm::ConstantExpr::getPtrToInt(global, word);
+    }
+    return llvm::ConstantStruct::get(stringType(), {len, data});
+}
+
+llvm::Value *CodeGenContext::stringEquals(llvm::Value *a, llvm::Value *b)
+{
+    llvm::Type *word = builder.getInt64Ty();
+    llvm::Value *aLen = builder.CreateExtractValue(a, 0, "len");
+    llvm::Value *bLen = builder.CreateExtractValue(b, 0, "len");
+    llvm::Value *aData = builder.CreateExtractValue(a, 1, "data");
+    llvm::Value *bData = builder.CreateExtractValue(b, 1, "data");
+
+    // A literal's length is known. A short one can only equal an inline
+    // string, and inline strings are zero-padded, so both words decide it;
+    // only long strings carry flag bits, so they cannot make the lengths
+    // match.
+    auto *aConst = llvm::dyn_cast<llvm::ConstantInt>(aLen);
+    auto *bConst = llvm::dyn_cast<llvm::ConstantInt>(bLen);
+    if ((aConst && aConst->getZExtValue() <= 8) || (bConst && bConst->getZExtValue() <= 8))
+    {
+        return builder.CreateAnd(builder.CreateICmpEQ(aLen, bLen, "samelen"),
+                                 builder.CreateICmpEQ(aData, bData, "samedata"), "streq");
+    }
+
+    llvm::Value *len = stringLength(a);
+    llvm::Value *sameLen = builder.CreateICmpEQ(len, stringLength(b), "samelen");
+
+    // Most unequal strings differ in length; only equal long ones are compared
+    // byte by byte. Against a long literal the short case cannot occur.
+    llvm::Function *func = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *entryBB = builder.GetInsertBlock();
+    llvm::BasicBlock *shortBB = nullptr;
+    llvm::BasicBlock *longBB = llvm::BasicBlock::Create(llvmContext, "streq.long", func);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(llvmContext, "streq.done", func);
+    llvm::Value *sameData = nullptr;
+    if (aConst || bConst)
+    {
+        builder.CreateCondBr(sameLen, longBB, doneBB);
+    }
+    else
+    {
+        llvm::BasicBlock *checkBB = llvm::BasicBlock::Create(llvmContext, "streq.samelen", func, longBB);
+        shortBB = llvm::BasicBlock::Create(llvmContext, "streq.short", func, longBB);
+        builder.CreateCondBr(sameLen, checkBB, doneBB);
+        builder.SetInsertPoint(checkBB);
+        builder.CreateCondBr(builder.CreateICmpULE(len, llvm::ConstantInt::get(word, 8)), shortBB, longBB);
+        builder.SetInsertPoint(shortBB);
+        sameData = builder.CreateICmpEQ(aData, bData, "samedata");
+        builder.CreateBr(doneBB);
+    }
+
+    builder.SetInsertPoint(longBB);
+    llvm::Value *bytesEqual = callStringRuntime("flec_str_eq", builder.getInt32Ty(), {a, b});
+    bytesEqual = builder.CreateICmpNE(bytesEqual, builder.getInt32(0));
+    builder.CreateBr(doneBB);
+
+    builder.SetInsertPoint(doneBB);
+    llvm::PHINode *result = builder.CreatePHI(builder.getInt1Ty(), 3, "streq");
+    result->addIncoming(builder.getFalse(), entryBB);
+    if (shortBB)
+        result->addIncoming(sameData, shortBB);
+    result->addIncoming(bytesEqual, longBB);
+    return result;
+}
+
+llvm::Value *CodeGenContext::stringLength(llvm::Value *s)
+{
+    return builder.CreateAnd(builder.CreateExtractValue(s, 0), FLEC_STR_LENGTH, "len");
+}
+
+llvm::Value *CodeGenContext::callStringRuntime(const std::string &name, llvm::Type *result,
+                                               const std::vector<llvm::Value *> &args)
+{
+    std::vector<llvm::Value *> words;
+    for (llvm::Value *arg : args)
+    {
+        if (arg->getType() == stringType())
+        {
+            words.push_back(builder.CreateExtractValue(arg, 0, "len"));
+            words.push_back(builder.CreateExtractValue(arg, 1, "data"));
+        }
+        else
+        {
+            words.push_back(arg);
+        }
+    }
+    std::vector<llvm::Type *> params;
+    for (llvm::Value *word : words)
+        params.push_back(word->getType());
+    llvm::FunctionType *type = llvm::FunctionType::get(result, params, false);
+    return builder.CreateCall(runtimeFunction(name, type), words);
+}
+
+bool CodeGenContext::usesRuntime() const
+{
+    for (const llvm::Function &function : *module)
+    {
+        if (function.isDeclaration() && function.getName().startswith("flec_"))
+            return true;
+    }
+    return false;
+}
+
+llvm::Value *CodeGenContext::randomWord()
+{
+    // The state's address only depends on the thread, like errno's, so
+    // optimization may hoist the lookup out of loops.
+    llvm::Type *word = builder.getInt64Ty();
+    llvm::FunctionType *stateType = FunctionType::get(word->getPointerTo(), false);
+    llvm::FunctionCallee stateFunc = runtimeFunction("flec_rng_state", stateType);
+    if (auto *func = llvm::dyn_cast<llvm::Function>(stateFunc.getCallee()))
+    {
+        func->setDoesNotAccessMemory();
+        func->setDoesNotThrow();
+        func->addFnAttr(llvm::Attribute::WillReturn);
+    }
+    llvm::Value *state = builder.CreateCall(stateFunc, {}, "rng");
+
+    llvm::Value *slots[4], *s[4];
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        slots[i] = builder.CreateConstInBoundsGEP1_64(word, state, i);
+        s[i] = builder.CreateLoad(word, slots[i], "rng.s" + std::to_string(i));
+    }
+    auto rotl = [&](llvm::Value *x, uint64_t k)
+    {
+        return builder.CreateIntrinsic(llvm::Intrinsic::fshl, {word}, {x, x, builder.getInt64(k)});
+    };
+
+    // xoshiro256** (Blackman and Vigna).
+    llvm::Value *result = builder.CreateMul(rotl(builder.CreateMul(s[1], builder.getInt64(5)), 7),
+                                            builder.getInt64(9), "random");
+    llvm::Value *t = builder.CreateShl(s[1], 17);
+    s[2] = builder.CreateXor(s[2], s[0]);
+    s[3] = builder.CreateXor(s[3], s[1]);
+    s[1] = builder.CreateXor(s[1], s[2]);
+    s[0] = builder.CreateXor(s[0], s[3]);
+    s[2] = builder.CreateXor(s[2], t);
+    s[3] = rotl(s[3], 45);
+    for (unsigned i = 0; i < 4; ++i)
+        builder.CreateStore(s[i], slots[i]);
+    return result;
+}
+
+llvm::Value *CodeGenContext::randomInRange(llvm::Value *lo, llvm::Value *hi, bool isSigned)
+{
+    llvm::Type *type = lo->getType();
+    llvm::Value *swap = isSigned ? builder.CreateICmpSGT(lo, hi) : builder.CreateICmpUGT(lo, hi);
+    llvm::Value *low = builder.CreateSelect(swap, hi, lo, "rand.lo");
+    llvm::Value *high = builder.CreateSelect(swap, lo, hi, "rand.hi");
+
+    // Scale a random word into the span by a widening multiply (Lemire),
+    // which needs no division; the bias is below span / 2^64. A span of
+    // 2^64 wraps to 0 and takes the word as it is.
+    llvm::Type *word = builder.getInt64Ty();
+    llvm::Type *wide = builder.getInt128Ty();
+    llvm::Value *low64 = isSigned ? builder.CreateSExt(low, word) : builder.CreateZExt(low, word);
+    llvm::Value *high64 = isSigned ? builder.CreateSExt(high, word) : builder.CreateZExt(high, word);
+    llvm::Value *span = builder.CreateAdd(builder.CreateSub(high64, low64), builder.getInt64(1), "rand.span");
+    llvm::Value *x = randomWord();
+    llvm::Value *product = builder.CreateMul(builder.CreateZExt(x, wide), builder.CreateZExt(span, wide));
+    llvm::Value *scaled = builder.CreateTrunc(builder.CreateLShr(product, 64), word);
+    scaled = builder.CreateSelect(builder.CreateICmpEQ(span, builder.getInt64(0)), x, scaled);
+    return builder.CreateTrunc(builder.CreateAdd(low64, scaled), type, "randint");
+}
+
+void CodeGenContext::enterRegion()
+{
+    FunctionType *enterType = FunctionType::get(builder.getInt64Ty(), false);
+    regionMarks.push_back(builder.CreateCall(runtimeFunction("flec_region_enter", enterType), {}, "region"));
+}
+
+void CodeGenContext::exitRegions(size_t first)
+{
+    if (regionMarks.size() <= first)
+        return;
+    FunctionType *exitType = FunctionType::get(builder.getVoidTy(), {builder.getInt64Ty()}, false);
+    builder.CreateCall(runtimeFunction("flec_region_exit", exitType), {regionMarks[first]});
+}
+
+llvm::Value *CodeGenContext::getSyncGroup()
+{
+    if (!syncGroup)
+    {
+        llvm::AllocaInst *group = createEntryAlloca(builder.getInt64Ty(), "sync.group");
+        llvm::IRBuilder<> init(group->getParent(), std::next(group->getIterator()));
+        init.CreateStore(init.getInt64(0), group);
+        syncGroup = group;
+    }
+    return syncGroup;
+}
+
+void CodeGenContext::emitImplicitSync()
+{
+    if (!syncGroup)
+        return;
+    llvm::FunctionType *syncType = llvm::FunctionType::get(
+        builder.getVoidTy(), {builder.getInt64Ty()->getPointerTo()}, false);
+    builder.CreateCall(runtimeFunction("flec_sync", syncType), {syncGroup});
+}
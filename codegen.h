@@ -1,6 +1,8 @@
 #pragma once
 
 #include "SymbolTable.h"
+#include "debuginfo.h"
+#include "loop_hints.h"
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/IRBuilder.h>
@@ -11,6 +13,8 @@
 #include <memory>
 #include <map>
 #include <string>
+#include <string_view>
+#include <vector>
 
 class ASTNode;
 class ProgramNode;
@@ -25,6 +29,50 @@ public:
     std::map<std::string, llvm::Value *> namedValues;
     std::map<std::string, std::string> symbolTable; // variable name → type ✅ NEW
 
+    // Multi-file programs: top-level variables of each module become exported
+    // globals (flec.g.<name>) so later modules can refer to them.
+    bool exportGlobals = false;
+    bool topLevel = true;
+    std::vector<std::pair<std::string, llvm::Type *>> exportedGlobals;
+
+    // Loops that carry @unroll/@vectorize/@interleave hints, by source line,
+    // so the optimizer can report whether each hint was honored.
+    std::vector<std::pair<int, LoopHints>> hintedLoops;
+
+    // Counter of the tasks spawned by the function being generated; created
+    // by the first spawn or sync in it.
+    llvm::Value *syncGroup = nullptr;
+
+    // The generator body being generated: where a yield stores its value and
+    // the blocks its suspend point branches to.
+    struct GeneratorState
+    {
+        std::string elementType;
+        llvm::Value *out;
+        llvm::BasicBlock *cleanup;
+        llvm::BasicBlock *suspend;
+    };
+    GeneratorState *generator = nullptr;
+    std::map<std::string, llvm::Function *> generatorFunctions;
+
+    // Coroutine intrinsics must be lowered before the module can run, even
+    // when no optimization was asked for.
+    bool usesCoroutines = false;
+
+    // Marks of the regions open in the function being generated, innermost
+    // last, and how many were already open when the innermost loop started:
+    // stop and skip leave the ones opened since.
+    std::vector<llvm::Value *> regionMarks;
+    size_t loopRegions = 0;
+
+    // --rt-stats: main turns on the runtime's allocation counters.
+    bool rtStats = false;
+
+    // -g: every module generated gets debug info, kept in debugInfo while
+    // its code is generated.
+    bool emitDebugInfo = false;
+    std::unique_ptr<DebugInfo> debugInfo;
+
     llvm::Function *currentFunction = nullptr;
     llvm::BasicBlock *breakBlock = nullptr;
     llvm::BasicBlock *continueBlock = nullptr;
@@ -34,8 +82,97 @@ public:
     CodeGenContext()
         : builder(llvmContext), module(std::make_unique<llvm::Module>("Flec", llvmContext)) {}
 
-    llvm::Type *getLLVMType(const std::string &typeName);
-    llvm::Value *generateCode(ProgramNode *root);
+    llvm::Type *getLLVMType(std::string_view typeName);
+
+    // Convert a value between Flec types: integer widening (sign- or
+    // zero-extended by the source type) or truncation. Other types pass through.
+    llvm::Value *convertValue(llvm::Value *value, std::string_view fromType, std::string_view toType);
+    llvm::Value *generateCode(ProgramNode *root, const std::string &sourcePath);
+
+    // Lower one file of a multi-file program into its own module, with its
+    // top-level statements in a `void initName()` function.
+    std::unique_ptr<llvm::Module> generateModule(ProgramNode *root, const std::string &moduleName,
+                                                 const std::string &initName);
+
+    // Link the per-file modules into `module` and add a main that runs their
+    // init functions in order. Returns false if linking failed.
+    bool linkProgram(std::vector<std::unique_ptr<llvm::Module>> modules,
+                     const std::vector<std::string> &initNames);
+
+    // Refer to a global exported by another module (a library this one
+    // imports) as name, and export it on to the modules after this one.
+    void importGlobal(const std::string &name, llvm::Type *type);
+
+    // Storage for a declared variable: an exported global at the top level of
+    // a multi-file module, otherwise a stack slot. Registers it in namedValues.
+    llvm::Value *createVariable(llvm::Type *type, std::string_view name);
+
+    // With -g, attribute the code generated from here on to function,
+    // defined at line, until leaveDebugFunction gets what this returned.
+    DebugInfo::Outer enterDebugFunction(llvm::Function *function, int line);
+    void leaveDebugFunction(const DebugInfo::Outer &outer);
+
+    // With -g, describe the storage of a declared variable.
+    void describeVariable(llvm::Value *storage, std::string_view name, std::string_view type, int line);
+
+    // Complete the debug info of the module just generated, if any.
+    void finishDebugInfo();
+
+    // Stack slot in the entry block of the current function.
+    llvm::AllocaInst *createEntryAlloca(llvm::Type *type, const llvm::Twine &name);
+
+    // Declaration of a libflecrt entry point (see runtime.h).
+    llvm::FunctionCallee runtimeFunction(const std::string &name, llvm::FunctionType *type);
+
+    // Flec strings are the runtime's flec_str, {len, data}, held in
+    // registers. A literal is a constant of this type.
+    llvm::StructType *stringType();
+    llvm::Constant *stringLiteral(std::string_view value);
+
+    // Bytes of the long literals of the current module, one global per
+    // distinct value, so equal literals share a data pointer.
+    std::map<std::string, llvm::GlobalVariable *> internedStrings;
+
+    // a == b for strings: lengths first, short strings by their data word,
+    // and flec_str_eq only for long strings of equal length.
+    llvm::Value *stringEquals(llvm::Value *a, llvm::Value *b);
+
+    // Byte length of a string, without the flag bits of its len word.
+    llvm::Value *stringLength(llvm::Value *s);
+
+    // Call a flec_str_* runtime function. Each string argument is passed as
+    // its two words, as the C ABI passes the struct.
+    llvm::Value *callStringRuntime(const std::string &name, llvm::Type *result,
+                                   const std::vector<llvm::Value *> &args);
+
+    // Next 64 random bits: xoshiro256** inlined on the calling thread's
+    // state, which the runtime seeds on first use.
+    llvm::Value *randomWord();
+
+    // Uniform integer between lo and hi inclusive, in either order; both
+    // have the same integer type.
+    llvm::Value *randomInRange(llvm::Value *lo, llvm::Value *hi, bool isSigned);
+
+    // Open a region for the block being generated and push its mark.
+    void enterRegion();
+
+    // Exit regionMarks[first] and every region opened after it. The marks
+    // stay pushed: the blocks that own them pop them.
+    void exitRegions(size_t first);
+
+    // The current function's task group, created on first use.
+    llvm::Value *getSyncGroup();
+
+    // Wait for the current function's spawned tasks, if it spawned any. Every
+    // function that may spawn calls this before returning.
+    void emitImplicitSync();
+
+    // Whether the module calls into libflecrt and so must be run with it.
+    bool usesRuntime() const;
+
+    // Attach the llvm.loop metadata for hints to the back-edge branch of a
+    // loop and record the loop in hintedLoops.
+    void attachLoopHints(llvm::Instruction *backEdge, const LoopHints &hints, int line);
 
     void pushBreakBlock(llvm::BasicBlock *block) { breakBlock = block; }
     void popBreakBlock() { breakBlock = nullptr; }
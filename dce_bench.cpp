@@ -0,0 +1,55 @@
+// dce_bench.cpp
+// Front-end pass times. `make dcebench` builds this without LLVM libraries,
+// as flec-check is. For each file it reports the best of several rounds of
+// semantic analysis and of eliminateDeadCode on the analyzed tree, so that
+// the cost of the whole-program pass can be weighed against the pass every
+// compile needs anyway.
+#include "ast_interface.h"
+#include "deadcode.h"
+#include "driver.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    const int rounds = 5;
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <source file>...\n";
+        return 1;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto millis = [](Clock::time_point from, Clock::time_point to)
+    { return std::chrono::duration<double, std::milli>(to - from).count(); };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        double analysis = 0, deadCode = 0;
+        size_t statements = 0;
+        for (int round = 0; round < rounds; ++round)
+        {
+            // Dead-code elimination changes the tree, so every round starts
+            // from the source.
+            resetFrontEnd();
+            if (!parseFile(argv[i]))
+                return 1;
+
+            auto start = Clock::now();
+            if (!analyzeProgram())
+                return 1;
+            auto analyzed = Clock::now();
+            statements = astRoot->statements.size();
+            eliminateDeadCode(astRoot.get(), nullptr);
+            auto eliminated = Clock::now();
+
+            auto best = [&](double &slot, double time) { slot = round == 0 ? time : std::min(slot, time); };
+            best(analysis, millis(start, analyzed));
+            best(deadCode, millis(analyzed, eliminated));
+        }
+        std::cout << argv[i] << ": " << statements << " top-level statements, analysis " << analysis
+                  << " ms, dead code " << deadCode << " ms\n";
+    }
+    return 0;
+}
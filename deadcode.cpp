@@ -0,0 +1,222 @@
+// deadcode.cpp
+#include "deadcode.h"
+#include "ast.h"
+#include "SymbolTable.h"
+#include <algorithm>
+#include <typeinfo>
+#include <unordered_map>
+
+namespace
+{
+    // node as a T, or null. No node class derives from another, so comparing
+    // the dynamic type is enough, and it is much cheaper than the search of
+    // the class hierarchy a failed dynamic_cast makes. These passes test
+    // every node of the program several times.
+    template <class T, class Node>
+    T *nodeAs(Node *node)
+    {
+        return node && typeid(*node) == typeid(T) ? static_cast<T *>(node) : nullptr;
+    }
+
+    // The statement list of a block or of the program, or null.
+    vector<ASTNodePtr> *statementList(ASTNode *node)
+    {
+        if (auto *block = nodeAs<BlockNode>(node))
+            return &block->statements;
+        if (auto *program = nodeAs<ProgramNode>(node))
+            return &program->statements;
+        return nullptr;
+    }
+
+    // Whether control never reaches the statement after stmt.
+    bool leavesBlock(const ASTNode *stmt)
+    {
+        if (nodeAs<const BreakNode>(stmt) || nodeAs<const ContinueNode>(stmt))
+            return true;
+        if (auto *block = nodeAs<const BlockNode>(stmt))
+            return !block->statements.empty() && leavesBlock(block->statements.back().get());
+        if (auto *ifStmt = nodeAs<const IfStmtNode>(stmt))
+            return ifStmt->elseBlock && leavesBlock(ifStmt->thenBlock.get()) && leavesBlock(ifStmt->elseBlock.get());
+        if (auto *match = nodeAs<const MatchNode>(stmt))
+        {
+            // Without an else, a value no arm lists goes on.
+            if (!match->elseBlock || !leavesBlock(match->elseBlock.get()))
+                return false;
+            return std::all_of(match->arms.begin(), match->arms.end(),
+                               [](const MatchNode::Arm &arm) { return leavesBlock(arm.body.get()); });
+        }
+        return false;
+    }
+
+    // Drop the statements after one that leaves its block, innermost blocks
+    // first so an if or match sees whether its branches still fall through.
+    void removeUnreachable(ASTNode *node, vector<int> &unreachable)
+    {
+        node->forEachChild([&](ASTNode *child) { removeUnreachable(child, unreachable); });
+
+        vector<ASTNodePtr> *list = statementList(node);
+        if (!list)
+            return;
+        for (size_t i = 0; i + 1 < list->size(); ++i)
+        {
+            if (leavesBlock((*list)[i].get()))
+            {
+                unreachable.push_back((*list)[i + 1]->lineNumber);
+                list->erase(list->begin() + i + 1, list->end());
+                break;
+            }
+        }
+    }
+
+    // What the program does with one variable name. Names are not resolved to
+    // scopes: a read of any variable called x keeps every variable called x.
+    struct VariableUse
+    {
+        uint32_t reads = 0;
+        bool declared = false;
+        bool effects = false;   // some value stored to it must still be computed
+        vector<ASTNode *> writes; // its declarations and assignments
+    };
+
+    class UseCounter
+    {
+    public:
+        unordered_map<string_view, VariableUse> uses;
+
+        // Count the uses in node. stmt is the declaration or assignment whose
+        // value node is part of, if any: reading a variable to compute its own
+        // next value (a counter nobody looks at) is no use.
+        void collect(ASTNode *node, ASTNode *stmt = nullptr)
+        {
+            node->forEachCapture([&](string_view name) { ++uses[name].reads; });
+            if (auto *id = nodeAs<IdentifierNode>(node))
+            {
+                if (isRead(id, stmt))
+                    ++uses[id->name].reads;
+                return;
+            }
+            if (auto *decl = nodeAs<DeclarationNode>(node))
+            {
+                VariableUse &use = uses[decl->identifier];
+                use.declared = true;
+                use.writes.push_back(node);
+                stmt = node;
+            }
+            else if (auto *assign = nodeAs<AssignmentNode>(node))
+            {
+                uses[assign->name].writes.push_back(node);
+                stmt = node;
+            }
+            else if (auto *input = nodeAs<InputStmtNode>(node))
+                ++uses[input->varName].reads; // the input is consumed either way
+            else if (auto *call = nodeAs<BuiltinCallNode>(node))
+            {
+                if (stmt && (!call->builtin || call->builtin->effects))
+                    uses[writtenName(stmt)].effects = true;
+            }
+            node->forEachChild([&](ASTNode *child) { collect(child, stmt); });
+        }
+
+        static bool isDead(const VariableUse &use) { return use.declared && !use.effects && use.reads == 0; }
+
+        // Mark every variable that is declared, never read and only ever
+        // given values without effects, with its declarations and
+        // assignments. Dropping a statement drops its reads, which can leave
+        // the variables it read unused in turn.
+        void markUnused(vector<ASTNode *> &removed)
+        {
+            for (const auto &use : uses)
+            {
+                if (isDead(use.second))
+                    dead.push_back(use.first);
+            }
+            while (!dead.empty())
+            {
+                string_view name = dead.back();
+                dead.pop_back();
+                for (ASTNode *write : uses.at(name).writes)
+                {
+                    removed.push_back(write);
+                    write->forEachChild([this, write](ASTNode *value) { release(value, write); });
+                }
+            }
+        }
+
+    private:
+        vector<string_view> dead; // names markUnused has yet to remove
+
+        static string_view writtenName(ASTNode *stmt)
+        {
+            if (auto *decl = nodeAs<DeclarationNode>(stmt))
+                return decl->identifier;
+            return static_cast<AssignmentNode *>(stmt)->name;
+        }
+
+        static bool isRead(IdentifierNode *id, ASTNode *stmt)
+        {
+            auto *assign = nodeAs<AssignmentNode>(stmt);
+            return !assign || assign->name != id->name;
+        }
+
+        // Take back the reads in node, part of the value stmt stores. The
+        // callbacks capture no more than two pointers, which std::function
+        // keeps without allocating.
+        void release(ASTNode *node, ASTNode *stmt)
+        {
+            if (auto *id = nodeAs<IdentifierNode>(node))
+            {
+                if (!isRead(id, stmt))
+                    return;
+                VariableUse &use = uses.at(id->name);
+                if (--use.reads == 0 && isDead(use))
+                    dead.push_back(id->name);
+                return;
+            }
+            node->forEachChild([this, stmt](ASTNode *child) { release(child, stmt); });
+        }
+    };
+
+    // Erase the marked statements, sorted, from their lists.
+    void applyRemovals(ASTNode *node, const vector<ASTNode *> &removed)
+    {
+        if (vector<ASTNodePtr> *list = statementList(node))
+        {
+            auto marked = [&](const ASTNodePtr &stmt)
+            { return std::binary_search(removed.begin(), removed.end(), stmt.get()); };
+            list->erase(std::remove_if(list->begin(), list->end(), marked), list->end());
+        }
+        node->forEachChild([&](ASTNode *child) { applyRemovals(child, removed); });
+    }
+}
+
+void eliminateDeadCode(ProgramNode *root, const SymbolTable *exported)
+{
+    if (!root)
+        return;
+
+    vector<int> unreachable;
+    removeUnreachable(root, unreachable);
+    std::sort(unreachable.begin(), unreachable.end());
+    for (int line : unreachable)
+        cerr << "Line " << line << ": warning: statement is unreachable.\n";
+
+    UseCounter counter;
+    counter.collect(root);
+    if (exported)
+    {
+        for (auto &use : counter.uses)
+        {
+            if (exported->isDeclared(use.first))
+                ++use.second.reads;
+        }
+    }
+    // A statement is marked once: a variable's writes are marked when it
+    // dies, and it dies once.
+    vector<ASTNode *> removed;
+    counter.markUnused(removed);
+    if (!removed.empty())
+    {
+        std::sort(removed.begin(), removed.end());
+        applyRemovals(root, removed);
+    }
+}
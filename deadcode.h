@@ -0,0 +1,15 @@
+#pragma once
+
+class ProgramNode;
+class SymbolTable;
+
+// Remove statements from an analyzed program that cannot change its output:
+// statements after a `stop` or `skip` (or an if or match whose branches all
+// end in one) in the same block, and variables that are never read together with
+// their assignments, as long as no initializer or assigned value has an
+// effect of its own. Unreachable statements are reported as warnings.
+//
+// The top-level variables of one file of a multi-file program are read by the
+// files after it; pass the program's symbols as exported so every global
+// declared so far is kept. Null for a single-file program.
+void eliminateDeadCode(ProgramNode *root, const SymbolTable *exported);
@@ -0,0 +1,123 @@
+// debuginfo.cpp
+#include "debuginfo.h"
+#include "codegen.h"
+#include "types.h"
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <filesystem>
+
+DebugInfo::DebugInfo(llvm::Module &module, const std::string &sourcePath)
+    : llvmContext(module.getContext()), builder(module)
+{
+    std::filesystem::path path = std::filesystem::absolute(sourcePath);
+    file = builder.createFile(path.filename().string(), path.parent_path().string());
+    // DWARF has no code for Flec; C is what debuggers handle best.
+    unit = builder.createCompileUnit(llvm::dwarf::DW_LANG_C, file, "flec", false, "", 0);
+
+    module.addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+    module.addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+}
+
+DebugInfo::Outer DebugInfo::enterFunction(llvm::IRBuilder<> &ir, llvm::Function *function, int line)
+{
+    Outer outer{scope, ir.getCurrentDebugLocation()};
+
+    llvm::DISubroutineType *type = builder.createSubroutineType(builder.getOrCreateTypeArray({}));
+    llvm::DISubprogram::DISPFlags flags = llvm::DISubprogram::SPFlagDefinition;
+    if (function->hasLocalLinkage())
+        flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+    llvm::DISubprogram *subprogram = builder.createFunction(unit, function->getName(), function->getName(), file,
+                                                            line, type, line, llvm::DINode::FlagPrototyped, flags);
+    function->setSubprogram(subprogram);
+
+    scope = subprogram;
+    ir.SetCurrentDebugLocation(location(line));
+    return outer;
+}
+
+void DebugInfo::leaveFunction(llvm::IRBuilder<> &ir, const Outer &outer)
+{
+    scope = outer.scope;
+    ir.SetCurrentDebugLocation(outer.location);
+}
+
+llvm::DILocation *DebugInfo::location(int line) const
+{
+    return scope ? llvm::DILocation::get(llvmContext, line, 0, scope) : nullptr;
+}
+
+llvm::DIType *DebugInfo::typeOf(std::string_view type)
+{
+    auto found = types.find(type);
+    if (found != types.end())
+        return found->second;
+
+    llvm::DIType *result = nullptr;
+    IntTypeInfo intInfo = intTypeInfo(type);
+    if (intInfo.bits)
+    {
+        result = builder.createBasicType(type, intInfo.bits,
+                                         intInfo.isSigned ? llvm::dwarf::DW_ATE_signed : llvm::dwarf::DW_ATE_unsigned);
+    }
+    else if (type == "float")
+    {
+        result = builder.createBasicType("float", 32, llvm::dwarf::DW_ATE_float);
+    }
+    else if (type == "bool")
+    {
+        result = builder.createBasicType("bool", 8, llvm::dwarf::DW_ATE_boolean);
+    }
+    else if (type == "string")
+    {
+        // flec_str as it is: a length word with flag bits, and a word that
+        // is either the bytes of a short string or a pointer to them.
+        llvm::DIType *word = builder.createBasicType("uint64", 64, llvm::dwarf::DW_ATE_unsigned);
+        llvm::Metadata *members[] = {
+            builder.createMemberType(unit, "len", file, 0, 64, 64, 0, llvm::DINode::FlagZero, word),
+            builder.createMemberType(unit, "data", file, 0, 64, 64, 64, llvm::DINode::FlagZero, word),
+        };
+        result = builder.createStructType(unit, "string", file, 0, 128, 64, llvm::DINode::FlagZero, nullptr,
+                                          builder.getOrCreateArray(members));
+    }
+
+    types.emplace(std::string(type), result);
+    return result;
+}
+
+void DebugInfo::declareVariable(llvm::IRBuilder<> &ir, llvm::Value *storage, std::string_view name,
+                                std::string_view type, int line)
+{
+    llvm::DIType *diType = typeOf(type);
+    if (!diType || !scope)
+        return;
+
+    if (auto *global = llvm::dyn_cast<llvm::GlobalVariable>(storage))
+    {
+        global->addDebugInfo(builder.createGlobalVariableExpression(unit, name, global->getName(), file, line,
+                                                                    diType, false));
+    }
+    else if (auto *slot = llvm::dyn_cast<llvm::AllocaInst>(storage))
+    {
+        llvm::DILocalVariable *variable = builder.createAutoVariable(scope, name, file, line, diType);
+        builder.insertDeclare(slot, variable, builder.createExpression(), location(line), ir.GetInsertBlock());
+    }
+}
+
+void DebugInfo::finish()
+{
+    builder.finalize();
+}
+
+DebugLine::DebugLine(CodeGenContext &context, int line) : context(context)
+{
+    if (!context.debugInfo || line <= 0)
+        return;
+    active = true;
+    outer = context.builder.getCurrentDebugLocation();
+    context.builder.SetCurrentDebugLocation(context.debugInfo->location(line));
+}
+
+DebugLine::~DebugLine()
+{
+    if (active)
+        context.builder.SetCurrentDebugLocation(outer);
+}
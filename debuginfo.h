@@ -0,0 +1,77 @@
+#pragma once
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/DebugLoc.h>
+#include <llvm/IR/IRBuilder.h>
+#include <map>
+#include <string>
+#include <string_view>
+
+class CodeGenContext;
+
+// DWARF debug info for -g, so profilers and debuggers can attribute code to
+// Flec source lines. Each module gets a compile unit for its source file,
+// each generated function (main, an init function, the outlined body of a
+// parallel repeat or spawn, a generator) a subprogram, each statement's
+// instructions its line, and each variable a declaration or input statement
+// creates a description of its slot or global.
+//
+// Only metadata is added: the instructions and their order are the same
+// with or without it. (At -O0 the coroutine splitter keeps a generator's
+// frame pointer in a slot of its own for the debugger; optimization removes
+// it again.)
+class DebugInfo
+{
+public:
+    DebugInfo(llvm::Module &module, const std::string &sourcePath);
+
+    // What enterFunction replaced, for leaveFunction to put back.
+    struct Outer
+    {
+        llvm::DIScope *scope = nullptr;
+        llvm::DebugLoc location;
+    };
+
+    // Give function a subprogram starting at line and attribute the code the
+    // builder generates from here on to it.
+    Outer enterFunction(llvm::IRBuilder<> &builder, llvm::Function *function, int line);
+    void leaveFunction(llvm::IRBuilder<> &builder, const Outer &outer);
+
+    // line in the function being generated.
+    llvm::DILocation *location(int line) const;
+
+    // Describe the storage createVariable made for a variable of the Flec
+    // type, declared at line. Types without a description are skipped.
+    void declareVariable(llvm::IRBuilder<> &builder, llvm::Value *storage, std::string_view name,
+                         std::string_view type, int line);
+
+    // Complete the metadata; call once the module's code is generated.
+    void finish();
+
+private:
+    llvm::LLVMContext &llvmContext;
+    llvm::DIBuilder builder;
+    llvm::DIFile *file;
+    llvm::DICompileUnit *unit;
+    llvm::DIScope *scope = nullptr; // the function being generated
+    std::map<std::string, llvm::DIType *, std::less<>> types;
+
+    llvm::DIType *typeOf(std::string_view type);
+};
+
+// Attributes the instructions generated while it is alive to line, in the
+// current function, then goes back to the line before. Does nothing
+// without -g.
+class DebugLine
+{
+public:
+    DebugLine(CodeGenContext &context, int line);
+    ~DebugLine();
+
+    DebugLine(const DebugLine &) = delete;
+    DebugLine &operator=(const DebugLine &) = delete;
+
+private:
+    CodeGenContext &context;
+    llvm::DebugLoc outer;
+    bool active = false;
+};
@@ -0,0 +1,451 @@
+// driver.cpp
+#include "driver.h"
+#include "ast_interface.h"
+#include "codegen.h"
+#include "deadcode.h"
+#include "incremental.h"
+#include "interface.h"
+#include "jit.h"
+#include "optimizer.h"
+#include "source.h"
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/raw_os_ostream.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/FileSystem.h>
+#include <cstdio>
+#include <iostream>
+#include <exception>
+#include <filesystem>
+
+std::string CompileOptions::resolvedOutputPath() const
+{
+    if (!outputPath.empty())
+        return outputPath;
+    return emit == EmitKind::Bitcode ? "output.bc" : "output.ll";
+}
+
+bool parseEmitKind(const std::string &name, EmitKind &kind)
+{
+    if (name == "ll")
+        kind = EmitKind::LLVMIR;
+    else if (name == "bc")
+        kind = EmitKind::Bitcode;
+    else
+        return false;
+    return true;
+}
+
+const char *emitKindName(EmitKind kind)
+{
+    return kind == EmitKind::Bitcode ? "bc" : "ll";
+}
+
+std::string optionsConfig(const CompileOptions &options)
+{
+    std::string config = std::string(emitKindName(options.emit)) + " -O" + std::to_string(options.optLevel) +
+                         (options.rtStats ? " --rt-stats" : "") + (options.debugInfo ? " -g" : "") +
+                         (options.cpu.empty() ? "" : " -mcpu=" + options.cpu) +
+                         (options.multiversion ? " --multiversion" : "");
+    if (options.optLevel > 0)
+        config += " --eval-steps=" + std::to_string(options.evalBudget.steps) +
+                  " --eval-memory=" + std::to_string(options.evalBudget.memory);
+    return config;
+}
+
+// Optimize the finished module if asked to and write it in the requested
+// format, or run it with --run.
+static int writeOutput(CodeGenContext &context, const CompileOptions &options)
+{
+    const std::string outputPath = options.resolvedOutputPath();
+
+    if (options.optLevel > 0 || options.remarks || context.usesCoroutines || !options.cpu.empty() ||
+        options.multiversion) {
+        CodeTarget target;
+        target.cpu = options.cpu;
+        target.multiversion = options.multiversion;
+        if (!optimizeModule(*context.module, options.optLevel, target, options.remarks, options.remarkFilter,
+                            context.hintedLoops))
+            return 1;
+    }
+
+    // Through std::cout, which the compile server sends back to its client.
+    if (options.printIR) {
+        llvm::raw_os_ostream out(std::cout);
+        context.module->print(out, nullptr);
+    }
+
+    if (options.run)
+        return runModule(*context.module, context.usesRuntime(), options.perfMap);
+
+    // Bitcode is binary; textual IR gets the platform's text mode.
+    std::error_code EC;
+    llvm::raw_fd_ostream outFile(outputPath, EC,
+                                 options.emit == EmitKind::Bitcode ? llvm::sys::fs::OF_None
+                                                                   : llvm::sys::fs::OF_Text);
+    if (EC) {
+        std::cerr << "Error opening output file: " << EC.message() << "\n";
+        return 1;
+    }
+    if (options.emit == EmitKind::Bitcode)
+        llvm::WriteBitcodeToFile(*context.module, outFile);
+    else
+        context.module->print(outFile, nullptr);
+    outFile.close();
+
+    std::cout << (options.emit == EmitKind::Bitcode ? "LLVM bitcode" : "LLVM IR")
+              << " written to " << outputPath << "\n";
+    if (context.usesRuntime())
+        std::cout << "Run it using: lli -load=./libflecrt.so " << outputPath << "\n";
+    else
+        std::cout << "Run it using: lli " << outputPath << "\n";
+    return 0;
+}
+
+namespace
+{
+    // Gives every imported library a module: read lazily from the bitcode in
+    // its interface, or compiled here, after which the interface is written.
+    class LibraryCompiler : public Importer
+    {
+    public:
+        explicit LibraryCompiler(CodeGenContext &context) : context(context)
+        {
+            config = context.emitDebugInfo ? "-g" : "";
+        }
+
+        // Put the module and init function of every library in front of the
+        // program's own.
+        void addModules(std::vector<std::unique_ptr<llvm::Module>> &modules, std::vector<std::string> &initNames);
+
+    protected:
+        bool loadLibrary(Library &library) override;
+        bool buildLibrary(Library &library) override;
+
+    private:
+        CodeGenContext &context;
+        std::map<const Library *, std::unique_ptr<llvm::Module>> built;
+    };
+}
+
+bool LibraryCompiler::buildLibrary(Library &library)
+{
+    eliminateDeadCode(astRoot.get(), &symbolTable);
+
+    // A library sees only the globals it imports, and its loops are not
+    // reported on: the ones of a library loaded from its interface are not.
+    auto exported = std::move(context.exportedGlobals);
+    auto hinted = std::move(context.hintedLoops);
+    context.exportedGlobals.clear();
+    std::unique_ptr<llvm::Module> module;
+    try {
+        module = context.generateModule(astRoot.get(), library.path, library.initName);
+    } catch (const std::exception &e) {
+        std::cerr << "Code generation error: " << e.what() << "\n";
+    }
+    context.exportedGlobals = std::move(exported);
+    context.hintedLoops = std::move(hinted);
+    if (!module)
+        return false;
+
+    std::string bitcode;
+    llvm::raw_string_ostream out(bitcode);
+    llvm::WriteBitcodeToFile(*module, out);
+    out.flush();
+
+    std::vector<ModuleInterface::Import> imports;
+    for (size_t i : library.imports)
+        imports.push_back({libraries[i]->path, libraries[i]->stamp});
+    // Without an interface the library is built again next time; this
+    // compile goes on with the module it has.
+    if (ModuleInterface::write(library.path, config, library.stamp, imports, library.symbols, library.initName,
+                               bitcode))
+        std::cout << "Wrote interface " << interfacePath(library.path) << "\n";
+
+    built[&library] = std::move(module);
+    return true;
+}
+
+bool LibraryCompiler::loadLibrary(Library &library)
+{
+    // Function bodies stay in the mapping until the linker needs them. The
+    // module is read now, before any code is generated, so its types keep
+    // their names, as they do when the library is built in this compile.
+    llvm::MemoryBufferRef buffer(library.interface->bitcode, library.path);
+    auto module = llvm::getLazyBitcodeModule(buffer, context.llvmContext);
+    if (!module) {
+        std::cerr << "Could not read " << interfacePath(library.path) << ": "
+                  << llvm::toString(module.takeError()) << "\n";
+        return false;
+    }
+    // The compile that generated it knew whether it needed coroutines lowered.
+    for (const llvm::Function &function : **module) {
+        if (function.getName().startswith("llvm.coro."))
+            context.usesCoroutines = true;
+    }
+    built[&library] = std::move(*module);
+    return true;
+}
+
+void LibraryCompiler::addModules(std::vector<std::unique_ptr<llvm::Module>> &modules,
+                                 std::vector<std::string> &initNames)
+{
+    std::vector<std::unique_ptr<llvm::Module>> allModules;
+    std::vector<std::string> allInitNames;
+    for (const auto &library : libraries) {
+        allModules.push_back(std::move(built[library.get()]));
+        allInitNames.push_back(library->initName);
+    }
+
+    for (auto &module : modules)
+        allModules.push_back(std::move(module));
+    allInitNames.insert(allInitNames.end(), initNames.begin(), initNames.end());
+    modules = std::move(allModules);
+    initNames = std::move(allInitNames);
+}
+
+// Link the program's modules after those of the libraries it imports and
+// write the result.
+static int linkAndWrite(CodeGenContext &context, LibraryCompiler &importer,
+                        std::vector<std::unique_ptr<llvm::Module>> modules,
+                        std::vector<std::string> initNames, const CompileOptions &options)
+{
+    importer.addModules(modules, initNames);
+    size_t count = modules.size();
+    if (!context.linkProgram(std::move(modules), initNames))
+        return 1;
+    std::cout << "Linked " << count << " modules\n";
+    return writeOutput(context, options);
+}
+
+// Build the parsed file in regions, reusing the analysis and the modules of
+// those the cache holds (see incremental.h).
+static int compileIncremental(const char *path, const CompileOptions &options, IncrementalCache &cache,
+                              CodeGenContext &context)
+{
+    const std::string outputPath = options.resolvedOutputPath();
+    ProgramNode *root = astRoot.get();
+    std::cout << "Parsed successfully.\n";
+    std::cout << "Running semantic analysis...\n";
+
+    std::vector<size_t> starts = IncrementalCache::partition(root);
+    std::vector<uint64_t> hashes = IncrementalCache::hashRegions(root, sourceText(), starts);
+    size_t count = starts.size();
+    starts.push_back(root->statements.size());
+
+    // Each region's key depends on the symbols the regions before it leave,
+    // so regions are analyzed, or restored from the cache, in order.
+    std::vector<IncrementalCache::Region> regions(count);
+    std::vector<std::unique_ptr<ProgramNode>> parts(count);
+    std::vector<bool> reused(count, false);
+    std::vector<uint64_t> keys;
+    uint64_t state = 0;
+    size_t rebuilt = 0;
+    for (size_t k = 0; k < count; ++k) {
+        IncrementalCache::Region &region = regions[k];
+        region.key = IncrementalCache::regionKey(hashes[k], state);
+        keys.push_back(region.key);
+        if (const IncrementalCache::Region *cached = cache.find(region.key)) {
+            region = *cached;
+            reused[k] = true;
+            for (const Symbol &symbol : region.exports)
+                symbolTable.declare(symbol.name, symbol.type, symbol.lineDeclared, symbol.readOnly);
+            symbolTable.taskFrames.front().pendingWrites =
+                std::set<std::string>(region.pendingWrites.begin(), region.pendingWrites.end());
+        } else {
+            parts[k] = std::make_unique<ProgramNode>();
+            for (size_t i = starts[k]; i < starts[k + 1]; ++i)
+                parts[k]->statements.push_back(std::move(root->statements[i]));
+            size_t declared = symbolTable.globalOrder().size();
+            analyzeStatements(parts[k].get());
+            const auto &order = symbolTable.globalOrder();
+            for (size_t i = declared; i < order.size(); ++i)
+                region.exports.push_back(symbolTable.lookup(order[i]));
+            const auto &pending = symbolTable.taskFrames.front().pendingWrites;
+            region.pendingWrites.assign(pending.begin(), pending.end());
+            ++rebuilt;
+        }
+        state = IncrementalCache::nextState(state, region);
+    }
+    if (semanticError) {
+        std::cerr << "Semantic analysis failed. Aborting.\n";
+        return 1;
+    }
+
+    if (rebuilt == 0 && !options.printIR && cache.upToDate(path, outputPath, keys)) {
+        std::cout << outputPath << " is up to date (" << count << " regions unchanged)\n";
+        return 0;
+    }
+    if (rebuilt == 0)
+        std::cout << "Relinking " << count << " unchanged regions\n";
+    else
+        std::cout << "Rebuilding " << rebuilt << " of " << count << " regions\n";
+
+    try {
+        // Cached modules are read before any code is generated, so their
+        // types keep their names.
+        std::vector<std::unique_ptr<llvm::Module>> modules(count);
+        bool cachedCoroutines = false;
+        for (size_t k = 0; k < count; ++k) {
+            if (!reused[k])
+                continue;
+            llvm::MemoryBufferRef buffer(regions[k].bitcode, path);
+            auto module = llvm::getLazyBitcodeModule(buffer, context.llvmContext);
+            if (!module) {
+                std::cerr << "Could not read the cached module of line " << root->statements[starts[k]]->lineNumber
+                          << ": " << llvm::toString(module.takeError()) << "\n";
+                cache.clear();
+                return 1;
+            }
+            for (const llvm::Function &function : **module) {
+                if (function.getName().startswith("llvm.coro."))
+                    cachedCoroutines = true;
+            }
+            modules[k] = std::move(*module);
+        }
+
+        // At -O0 the pipeline runs only to lower the coroutines of
+        // generators, which can as well be done once per region, before it
+        // is cached, as over the whole program on every build.
+        bool lowerRegions = options.optLevel == 0 && !options.remarks && options.cpu.empty() &&
+                            !options.multiversion;
+        std::vector<std::string> initNames;
+        for (size_t k = 0; k < count; ++k) {
+            IncrementalCache::Region &region = regions[k];
+            // Named after the key, which a cached module keeps wherever its
+            // region ends up in the program.
+            char initName[32];
+            snprintf(initName, sizeof(initName), "flec.init.%016llx", static_cast<unsigned long long>(region.key));
+            initNames.push_back(initName);
+            if (reused[k]) {
+                for (const Symbol &symbol : region.exports)
+                    context.exportedGlobals.emplace_back(symbol.name, context.getLLVMType(symbol.type));
+                context.hintedLoops.insert(context.hintedLoops.end(), region.hintedLoops.begin(),
+                                           region.hintedLoops.end());
+                continue;
+            }
+
+            ProgramNode *part = parts[k].get();
+            if (options.optLevel > 0)
+                evaluatePrefix(part, options.evalBudget, options.remarks);
+            eliminateDeadCode(part, &symbolTable);
+            size_t hinted = context.hintedLoops.size();
+            modules[k] = context.generateModule(part, path, initName);
+            region.hintedLoops.assign(context.hintedLoops.begin() + hinted, context.hintedLoops.end());
+            if (lowerRegions && context.usesCoroutines) {
+                optimizeModule(*modules[k], 0, CodeTarget(), false, "", region.hintedLoops);
+                context.usesCoroutines = false;
+            }
+
+            llvm::raw_string_ostream out(region.bitcode);
+            llvm::WriteBitcodeToFile(*modules[k], out);
+            out.flush();
+        }
+        if (cachedCoroutines)
+            context.usesCoroutines = true;
+
+        if (!context.linkProgram(std::move(modules), initNames) || writeOutput(context, options) != 0) {
+            cache.clear();
+            return 1;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Code generation error: " << e.what() << "\n";
+        cache.clear();
+        return 1;
+    }
+
+    cache.store(path, outputPath, std::move(regions));
+    return 0;
+}
+
+int compileFile(const char *path, const CompileOptions &options, IncrementalCache *cache)
+{
+    resetFrontEnd();
+    CodeGenContext context;
+    context.rtStats = options.rtStats;
+    context.emitDebugInfo = options.debugInfo;
+    LibraryCompiler importer(context);
+    if (!importer.parse(path)) {
+        if (cache)
+            cache->clear();
+        return 1;
+    }
+
+    if (!importer.libraries.empty()) {
+        // The cache covers this file only, not what it imports.
+        if (cache)
+            cache->clear();
+        std::cout << "Parsed successfully.\n";
+        std::cout << "Running semantic analysis...\n";
+        if (!analyzeProgram())
+            return 1;
+        if (options.optLevel > 0)
+            evaluatePrefix(astRoot.get(), options.evalBudget, options.remarks);
+        eliminateDeadCode(astRoot.get(), nullptr);
+        try {
+            std::vector<std::unique_ptr<llvm::Module>> modules;
+            modules.push_back(context.generateModule(astRoot.get(), path, "flec.init.main"));
+            return linkAndWrite(context, importer, std::move(modules), {"flec.init.main"}, options);
+        } catch (const std::exception &e) {
+            std::cerr << "Code generation error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (cache)
+        return compileIncremental(path, options, *cache, context);
+
+    std::cout << "Parsed successfully.\n";
+    std::cout << "Running semantic analysis...\n";
+    if (!analyzeProgram())
+        return 1;
+    if (options.optLevel > 0)
+        evaluatePrefix(astRoot.get(), options.evalBudget, options.remarks);
+    eliminateDeadCode(astRoot.get(), nullptr);
+
+    try {
+        context.generateCode(astRoot.get(), path);
+        return writeOutput(context, options);
+    } catch (const std::exception &e) {
+        std::cerr << "Code generation error: " << e.what() << "\n";
+        return 1;
+    }
+}
+
+int compileProgram(const std::vector<std::string> &paths, const CompileOptions &options)
+{
+    if (paths.size() == 1)
+        return compileFile(paths[0].c_str(), options, nullptr);
+
+    resetFrontEnd();
+    try {
+        CodeGenContext context;
+        context.rtStats = options.rtStats;
+        context.emitDebugInfo = options.debugInfo;
+        LibraryCompiler importer(context);
+        std::vector<std::unique_ptr<llvm::Module>> modules;
+        std::vector<std::string> initNames;
+
+        for (size_t i = 0; i < paths.size(); ++i) {
+            DiagnosticFile file(paths[i]);
+            if (!importer.parse(paths[i]))
+                return 1;
+            std::cout << "Parsed " << paths[i] << "\n";
+            if (!analyzeProgram())
+                return 1;
+            if (options.optLevel > 0)
+                evaluatePrefix(astRoot.get(), options.evalBudget, options.remarks);
+            eliminateDeadCode(astRoot.get(), &symbolTable);
+
+            std::string initName = "flec.init." + std::to_string(i) + "." +
+                                   std::filesystem::path(paths[i]).stem().string();
+            modules.push_back(context.generateModule(astRoot.get(), paths[i], initName));
+            initNames.push_back(initName);
+        }
+
+        return linkAndWrite(context, importer, std::move(modules), std::move(initNames), options);
+    } catch (const std::exception &e) {
+        std::cerr << "Code generation error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "evaluator.h"
+#include <string>
+#include <vector>
+
+class IncrementalCache;
+
+// Output format of a compile.
+enum class EmitKind
+{
+    LLVMIR,  // textual .ll
+    Bitcode  // binary .bc
+};
+
+struct CompileOptions
+{
+    EmitKind emit = EmitKind::LLVMIR;
+    std::string outputPath; // empty: output.ll or output.bc depending on emit
+    bool printIR = false;   // also print the module to stdout
+    int optLevel = 0;       // -O0 .. -O3
+    bool remarks = false;   // -Rpass: print optimization remarks and loop hint results
+    std::string remarkFilter; // -Rpass=<regex>: passes to report; empty: the loop passes
+    bool rtStats = false;   // --rt-stats: the program reports its allocations at exit
+    bool debugInfo = false; // -g: DWARF line and variable info
+    bool run = false;       // --run: run the program with the JIT instead of writing it (see jit.h)
+    bool perfMap = false;   // --perf-map: with --run, let perf name the JIT-compiled code
+    EvalBudget evalBudget;  // --eval-steps= / --eval-memory=: partial evaluation at -O1 and up; 0 steps: none
+    std::string cpu;        // -march= / -mcpu=: processor to tune for, "native" for the host (see optimizer.h)
+    bool multiversion = false; // --multiversion: loop functions for SSE2, AVX2 and AVX-512, picked at load time
+
+    std::string resolvedOutputPath() const;
+};
+
+// Parse the value of --emit=. Returns false for an unknown kind.
+bool parseEmitKind(const std::string &name, EmitKind &kind);
+const char *emitKindName(EmitKind kind);
+
+// Options that change the generated output, for the incremental cache.
+std::string optionsConfig(const CompileOptions &options);
+
+// ---- Front end (frontend.cpp, no LLVM dependency) ----
+
+// Reset the global front-end state so the same process can compile again.
+void resetFrontEnd();
+
+// Parse path into astRoot, keeping the symbols declared so far. Reports and
+// returns false on failure. The tree is valid until the next parseFile, which
+// replaces the source it points into.
+bool parseFile(const char *path);
+
+// Run semantic analysis over astRoot. Returns false if any error was reported.
+bool analyzeProgram();
+
+// Run semantic analysis over the top-level statements of part, which follow
+// those analyzed so far. Unlike analyzeProgram it leaves what they spawn
+// pending for the statements after them, and it does not report failure
+// itself. Returns false if any error was reported.
+bool analyzeStatements(ProgramNode *part);
+
+// Parse and type-check path without generating code. Returns the exit code.
+int checkFile(const char *path);
+
+// ---- Full pipeline (driver.cpp) ----
+
+// Compile one source file to IR or bitcode as selected by options. With a
+// cache, only the regions of the file that changed since the last successful
+// build are analyzed and generated again (see incremental.h). A file that
+// imports libraries is linked with their modules (see interface.h) and built
+// in full, as a library can change without it. Returns the process exit code.
+int compileFile(const char *path, const CompileOptions &options, IncrementalCache *cache);
+
+// Compile several source files as one program: each file becomes its own
+// module whose top-level variables are exported to the files after it, and
+// the modules are linked with a main that runs them in order.
+int compileProgram(const std::vector<std::string> &paths, const CompileOptions &options);
@@ -0,0 +1,712 @@
+// evaluator.cpp
+#include "evaluator.h"
+#include "ast.h"
+#include "ast_interface.h"
+#include "builtins.h"
+#include "source.h"
+#include "types.h"
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    // A value as the generated code holds it. An integer is kept sign- or
+    // zero-extended from the width of its type, so comparing the words as
+    // int64_t or uint64_t agrees with icmp on the narrow value.
+    struct Value
+    {
+        string_view type;  // a type name owned by the tree or static storage
+        uint64_t bits = 0; // integers; bools are 0 or 1
+        float number = 0;
+        string text;
+    };
+
+    // Thrown where evaluation cannot go on. The top-level statement it
+    // happens in is put back as it was and left for the program to run.
+    struct Stop
+    {
+        int line;
+        const char *reason;
+    };
+
+    enum class Flow
+    {
+        Next,
+        Break,
+        Continue
+    };
+
+    // bits cut to the width of the integer type and extended back to 64 as
+    // the type is signed or not: trunc, then sext or zext.
+    uint64_t fit(uint64_t bits, string_view type)
+    {
+        IntTypeInfo info = intTypeInfo(type);
+        if (info.bits == 0 || info.bits == 64)
+            return bits;
+        uint64_t mask = (uint64_t(1) << info.bits) - 1;
+        bits &= mask;
+        if (info.isSigned && (bits >> (info.bits - 1)))
+            bits |= ~mask;
+        return bits;
+    }
+
+    Value boolean(bool value)
+    {
+        Value result;
+        result.type = "bool";
+        result.bits = value;
+        return result;
+    }
+
+    Value compared(int order, BinaryExprNode::Op op)
+    {
+        using Op = BinaryExprNode::Op;
+        return boolean(op == Op::Eq    ? order == 0
+                       : op == Op::Neq ? order != 0
+                       : op == Op::Lt  ? order < 0
+                       : op == Op::Gt  ? order > 0
+                       : op == Op::Leq ? order <= 0
+                                       : order >= 0);
+    }
+
+    class Evaluator
+    {
+    public:
+        string output;
+        // Top-level variables in the order they were declared.
+        vector<DeclarationNode *> globals;
+
+        explicit Evaluator(const EvalBudget &budget) : budget(budget) {}
+
+        // Run top-level statement stmt. On a Stop everything it changed is
+        // put back before the Stop is passed on.
+        void runTopLevel(ASTNode *stmt)
+        {
+            size_t outputSize = output.size();
+            size_t globalCount = globals.size();
+            uint64_t heldBefore = held;
+            saved.clear();
+            current = stmt;
+            try
+            {
+                if (exec(stmt) != Flow::Next)
+                    throw Stop{stmt->lineNumber, "leaves the program"};
+            }
+            catch (const Stop &)
+            {
+                while (!scopes.empty())
+                    leaveScope();
+                // A name saved while only a block declared it went with the block.
+                for (size_t k = saved.size(); k-- > 0;)
+                {
+                    if (!bindings[saved[k].first].empty())
+                        bindings[saved[k].first].front() = move(saved[k].second);
+                }
+                for (size_t k = globals.size(); k-- > globalCount;)
+                    bindings[globals[k]->identifier].pop_back();
+                globals.resize(globalCount);
+                output.resize(outputSize);
+                held = heldBefore;
+                throw;
+            }
+        }
+
+        const Value &valueOf(string_view name) const { return bindings.at(name).front(); }
+
+    private:
+        const EvalBudget &budget;
+        uint64_t steps = 0;
+        uint64_t held = 0; // bytes in the strings variables hold
+
+        // The values of each variable name, innermost last; a top-level
+        // variable's is the first, as nothing encloses the program's scope.
+        unordered_map<string_view, vector<Value>> bindings;
+        // The names declared in each block being run, innermost last.
+        vector<vector<string_view>> scopes;
+        // Top-level values as they were before the statement being run
+        // assigned them, once per variable.
+        vector<pair<string_view, Value>> saved;
+        unordered_map<string_view, ASTNode *> savedIn; // the statement a name was last saved in
+        ASTNode *current = nullptr;                    // the top-level statement being run
+
+        void step(const ASTNode *node)
+        {
+            if (++steps > budget.steps)
+                throw Stop{node->lineNumber, "step budget exhausted"};
+        }
+
+        // Make room for bytes more of text.
+        void charge(size_t bytes, const ASTNode *node)
+        {
+            if (output.size() + held + bytes > budget.memory)
+                throw Stop{node->lineNumber, "memory budget exhausted"};
+        }
+
+        void declare(string_view name, Value value, DeclarationNode *node)
+        {
+            held += value.text.size();
+            bindings[name].push_back(move(value));
+            if (scopes.empty())
+                globals.push_back(node);
+            else
+                scopes.back().push_back(name);
+        }
+
+        void assign(string_view name, Value value, const ASTNode *node)
+        {
+            vector<Value> &values = bindings[name];
+            if (values.empty())
+                throw Stop{node->lineNumber, "assigns a variable declared in another file"};
+            ASTNode *&savedBy = savedIn[name];
+            if (values.size() == 1 && savedBy != current)
+            {
+                saved.emplace_back(name, values.back());
+                savedBy = current;
+            }
+            held = held - values.back().text.size() + value.text.size();
+            values.back() = move(value);
+        }
+
+        void leaveScope()
+        {
+            for (string_view name : scopes.back())
+            {
+                held -= bindings[name].back().text.size();
+                bindings[name].pop_back();
+            }
+            scopes.pop_back();
+        }
+
+        Value convert(Value value, string_view type, const ASTNode *node)
+        {
+            if (value.type == type)
+                return value;
+            if (!isIntegerType(value.type) || !isIntegerType(type))
+                throw Stop{node->lineNumber, "converts between types"};
+            value.bits = fit(value.bits, type);
+            value.type = type;
+            return value;
+        }
+
+        Value eval(ASTNode *expr)
+        {
+            step(expr);
+            if (auto *literal = dynamic_cast<LiteralNode *>(expr))
+                return this->literal(literal);
+            if (auto *id = dynamic_cast<IdentifierNode *>(expr))
+            {
+                const vector<Value> &values = bindings[id->name];
+                if (values.empty())
+                    throw Stop{expr->lineNumber, "reads a variable declared in another file"};
+                return values.back();
+            }
+            if (auto *binary = dynamic_cast<BinaryExprNode *>(expr))
+                return this->binary(binary);
+            if (auto *unary = dynamic_cast<UnaryExprNode *>(expr))
+                return this->unary(unary);
+            if (auto *call = dynamic_cast<BuiltinCallNode *>(expr))
+                return builtin(call);
+            throw Stop{expr->lineNumber, "not evaluated at compile time"};
+        }
+
+        Value literal(const LiteralNode *node)
+        {
+            Value result;
+            switch (node->type)
+            {
+            case LiteralNode::Type::Int:
+                result.type = node->intType;
+                from_chars(node->value.data(), node->value.data() + node->value.size(), result.bits);
+                result.bits = fit(result.bits, result.type);
+                return result;
+            case LiteralNode::Type::Float:
+                result.type = "float";
+                result.number = stof(string(node->value));
+                return result;
+            case LiteralNode::Type::Bool:
+                return boolean(node->value == "true");
+            case LiteralNode::Type::String:
+                charge(node->value.size(), node);
+                result.type = "string";
+                result.text = node->value;
+                return result;
+            default:
+                throw Stop{node->lineNumber, "uses a character literal"};
+            }
+        }
+
+        Value binary(BinaryExprNode *node)
+        {
+            using Op = BinaryExprNode::Op;
+            const string &type = node->operandType;
+            Value left = convert(eval(node->left.get()), type, node);
+            Value right = convert(eval(node->right.get()), type, node);
+
+            if (type == "string")
+            {
+                if (node->op != Op::Add)
+                    return compared(left.text.compare(right.text), node->op);
+                charge(left.text.size() + right.text.size(), node);
+                left.text += right.text;
+                return left;
+            }
+
+            if (type == "float")
+            {
+                float x = left.number, y = right.number;
+                switch (node->op)
+                {
+                case Op::Add:
+                    left.number = x + y;
+                    return left;
+                case Op::Sub:
+                    left.number = x - y;
+                    return left;
+                case Op::Mul:
+                    left.number = x * y;
+                    return left;
+                case Op::Div:
+                    left.number = x / y;
+                    return left;
+                // Ordered comparisons: false when either side is NaN.
+                case Op::Eq:
+                    return boolean(x == y);
+                case Op::Neq:
+                    return boolean(x < y || x > y);
+                case Op::Lt:
+                    return boolean(x < y);
+                case Op::Gt:
+                    return boolean(x > y);
+                case Op::Leq:
+                    return boolean(x <= y);
+                case Op::Geq:
+                    return boolean(x >= y);
+                default:
+                    throw Stop{node->lineNumber, "not evaluated at compile time"};
+                }
+            }
+
+            IntTypeInfo info = intTypeInfo(type);
+            if (!info.bits && type != "bool")
+                throw Stop{node->lineNumber, "not evaluated at compile time"};
+            uint64_t x = left.bits, y = right.bits;
+            // icmp on a bool compares it as a 1-bit signed number: true is -1.
+            int64_t sx = info.bits ? static_cast<int64_t>(x) : -static_cast<int64_t>(x);
+            int64_t sy = info.bits ? static_cast<int64_t>(y) : -static_cast<int64_t>(y);
+            bool isUnsigned = info.bits && !info.isSigned;
+            switch (node->op)
+            {
+            case Op::And:
+                left.bits = x & y;
+                return left;
+            case Op::Or:
+                left.bits = x | y;
+                return left;
+            case Op::Eq:
+            case Op::Neq:
+            case Op::Lt:
+            case Op::Gt:
+            case Op::Leq:
+            case Op::Geq:
+                if (isUnsigned)
+                    return compared(x < y ? -1 : x > y, node->op);
+                return compared(sx < sy ? -1 : sx > sy, node->op);
+            default:
+                break;
+            }
+
+            if (!info.bits)
+                throw Stop{node->lineNumber, "not evaluated at compile time"};
+            switch (node->op)
+            {
+            case Op::Add:
+                left.bits = fit(x + y, type);
+                return left;
+            case Op::Sub:
+                left.bits = fit(x - y, type);
+                return left;
+            case Op::Mul:
+                left.bits = fit(x * y, type);
+                return left;
+            case Op::Div:
+                // Both trap at run time, and the program should get to.
+                if (y == 0)
+                    throw Stop{node->lineNumber, "divides by zero"};
+                if (isUnsigned)
+                {
+                    left.bits = x / y;
+                    return left;
+                }
+                if (sy == -1 && x == fit(uint64_t(1) << (info.bits - 1), type))
+                    throw Stop{node->lineNumber, "overflows a division"};
+                left.bits = fit(static_cast<uint64_t>(sx / sy), type);
+                return left;
+            default:
+                throw Stop{node->lineNumber, "not evaluated at compile time"};
+            }
+        }
+
+        Value unary(UnaryExprNode *node)
+        {
+            Value value = eval(node->operand.get());
+            bool isInteger = isIntegerType(value.type);
+            if (node->op == UnaryExprNode::Op::Not && (isInteger || value.type == "bool"))
+            {
+                value.bits = isInteger ? fit(~value.bits, value.type) : !value.bits;
+                return value;
+            }
+            if (node->op == UnaryExprNode::Op::Minus && value.type == "float")
+            {
+                value.number = -value.number;
+                return value;
+            }
+            if (node->op == UnaryExprNode::Op::Minus && isInteger)
+            {
+                value.bits = fit(0 - value.bits, value.type);
+                return value;
+            }
+            throw Stop{node->lineNumber, "not evaluated at compile time"};
+        }
+
+        Value builtin(BuiltinCallNode *node)
+        {
+            const Builtin *builtin = node->builtin;
+            Value result;
+            switch (builtin->id)
+            {
+            case BuiltinId::Typeof:
+                charge(node->argTypes[0].size(), node);
+                result.type = "string";
+                result.text = node->argTypes[0];
+                return result;
+            case BuiltinId::Randint:
+                throw Stop{node->lineNumber, "draws random numbers"};
+            case BuiltinId::Clear:
+            {
+                static const char CLEAR[] = "\x1b[2J\x1b[H";
+                charge(sizeof(CLEAR) - 1, node);
+                output += CLEAR;
+                result.type = "void";
+                return result;
+            }
+            default:
+                break;
+            }
+
+            vector<Value> args;
+            for (size_t k = 0; k < node->args.size(); ++k)
+            {
+                const string &param = builtin->params[k];
+                bool generic = param == BUILTIN_NUMERIC || param == BUILTIN_INTEGER;
+                args.push_back(convert(eval(node->args[k].get()), generic ? node->operandType : param, node));
+            }
+
+            bool generic = builtin->result == BUILTIN_NUMERIC || builtin->result == BUILTIN_INTEGER;
+            result.type = generic ? string_view(node->operandType) : string_view(builtin->result);
+            bool isFloat = node->operandType == "float";
+            bool isSigned = intTypeInfo(node->operandType).isSigned;
+            switch (builtin->id)
+            {
+            case BuiltinId::Len:
+                result.bits = fit(args[0].text.size(), result.type);
+                return result;
+            case BuiltinId::Substr:
+            {
+                // As flec_str_substr clamps them.
+                int64_t n = static_cast<int64_t>(args[0].text.size());
+                int64_t start = std::min(std::max<int64_t>(static_cast<int64_t>(args[1].bits), 0), n);
+                int64_t count = std::min(std::max<int64_t>(static_cast<int64_t>(args[2].bits), 0), n - start);
+                charge(count, node);
+                result.text = args[0].text.substr(start, count);
+                return result;
+            }
+            case BuiltinId::Abs:
+                if (isFloat)
+                    result.number = std::fabs(args[0].number);
+                else if (isSigned && static_cast<int64_t>(args[0].bits) < 0)
+                    result.bits = fit(0 - args[0].bits, result.type);
+                else
+                    result.bits = args[0].bits;
+                return result;
+            case BuiltinId::Min:
+            case BuiltinId::Max:
+            {
+                bool max = builtin->id == BuiltinId::Max;
+                if (isFloat)
+                {
+                    result.number = max ? std::fmax(args[0].number, args[1].number)
+                                        : std::fmin(args[0].number, args[1].number);
+                    return result;
+                }
+                uint64_t x = args[0].bits, y = args[1].bits;
+                bool less = isSigned ? static_cast<int64_t>(x) < static_cast<int64_t>(y) : x < y;
+                result.bits = less != max ? x : y;
+                return result;
+            }
+            case BuiltinId::Sqrt:
+                result.number = std::sqrt(args[0].number);
+                return result;
+            case BuiltinId::Pow:
+                result.number = std::pow(args[0].number, args[1].number);
+                return result;
+            case BuiltinId::Floor:
+                result.number = std::floor(args[0].number);
+                return result;
+            default:
+                throw Stop{node->lineNumber, "not evaluated at compile time"};
+            }
+        }
+
+        // Append what printing value as type writes.
+        void print(string_view type, const Value &value, const ASTNode *node)
+        {
+            char text[64]; // FLT_MAX takes 47 with %f
+            int length;
+            IntTypeInfo info = intTypeInfo(type);
+            if (info.bits && info.isSigned)
+                length = snprintf(text, sizeof(text), "%lld\n", static_cast<long long>(value.bits));
+            else if (info.bits)
+                length = snprintf(text, sizeof(text), "%llu\n", static_cast<unsigned long long>(value.bits));
+            else if (type == "float")
+                length = snprintf(text, sizeof(text), "%f\n", static_cast<double>(value.number));
+            else if (type == "bool")
+                length = snprintf(text, sizeof(text), "%d\n", static_cast<int>(value.bits));
+            else if (type == "string")
+            {
+                // The replacement writes the output as a C string.
+                if (value.text.find('\0') != string::npos)
+                    throw Stop{node->lineNumber, "prints a zero byte"};
+                charge(value.text.size() + 1, node);
+                output += value.text;
+                output += '\n';
+                return;
+            }
+            else
+                throw Stop{node->lineNumber, "not evaluated at compile time"};
+            charge(length, node);
+            output.append(text, length);
+        }
+
+        Flow exec(ASTNode *stmt)
+        {
+            step(stmt);
+            if (auto *node = dynamic_cast<DeclarationNode *>(stmt))
+            {
+                // The generated code keeps one binding per name, so after the
+                // block the name still means the inner variable.
+                if (!bindings[node->identifier].empty())
+                    throw Stop{stmt->lineNumber, "declares a variable an outer one already names"};
+                declare(node->identifier, convert(eval(node->expr.get()), node->typeName, node), node);
+                return Flow::Next;
+            }
+            if (auto *node = dynamic_cast<AssignmentNode *>(stmt))
+            {
+                assign(node->name, convert(eval(node->value.get()), node->targetType, node), node);
+                return Flow::Next;
+            }
+            if (auto *node = dynamic_cast<PrintStmtNode *>(stmt))
+            {
+                print(node->exprType, eval(node->expr.get()), node);
+                return Flow::Next;
+            }
+            if (auto *node = dynamic_cast<IfStmtNode *>(stmt))
+            {
+                if (eval(node->condition.get()).bits)
+                    return exec(node->thenBlock.get());
+                return node->elseBlock ? exec(node->elseBlock.get()) : Flow::Next;
+            }
+            if (auto *node = dynamic_cast<MatchNode *>(stmt))
+                return match(node);
+            if (auto *node = dynamic_cast<RepeatStmtNode *>(stmt))
+            {
+                // The body runs first; skip goes on to the condition.
+                while (exec(node->body.get()) != Flow::Break && eval(node->condition.get()).bits)
+                    ;
+                return Flow::Next;
+            }
+            if (auto *node = dynamic_cast<RepeatRangeNode *>(stmt))
+                return range(node);
+            if (auto *node = dynamic_cast<BlockNode *>(stmt))
+            {
+                scopes.emplace_back();
+                for (const auto &inner : node->statements)
+                {
+                    Flow flow = exec(inner.get());
+                    if (flow != Flow::Next)
+                    {
+                        leaveScope();
+                        return flow;
+                    }
+                }
+                leaveScope();
+                return Flow::Next;
+            }
+            if (dynamic_cast<BreakNode *>(stmt))
+                return Flow::Break;
+            if (dynamic_cast<ContinueNode *>(stmt))
+                return Flow::Continue;
+            if (auto *node = dynamic_cast<BuiltinCallNode *>(stmt))
+            {
+                eval(node);
+                return Flow::Next;
+            }
+            if (dynamic_cast<InputStmtNode *>(stmt))
+                throw Stop{stmt->lineNumber, "reads input"};
+            if (dynamic_cast<ParallelRepeatNode *>(stmt) || dynamic_cast<SpawnNode *>(stmt) ||
+                dynamic_cast<SyncNode *>(stmt))
+                throw Stop{stmt->lineNumber, "runs tasks"};
+            if (dynamic_cast<GenNode *>(stmt) || dynamic_cast<YieldNode *>(stmt) || dynamic_cast<RepeatInNode *>(stmt))
+                throw Stop{stmt->lineNumber, "uses a generator"};
+            if (dynamic_cast<ImportNode *>(stmt))
+                throw Stop{stmt->lineNumber, "imports a library"};
+            throw Stop{stmt->lineNumber, "not evaluated at compile time"};
+        }
+
+        Flow match(MatchNode *node)
+        {
+            uint64_t subject = convert(eval(node->subject.get()), node->subjectType, node).bits;
+            for (const MatchNode::Arm &arm : node->arms)
+            {
+                for (unsigned long long value : arm.values)
+                {
+                    if (value == subject)
+                        return exec(arm.body.get());
+                }
+            }
+            return node->elseBlock ? exec(node->elseBlock.get()) : Flow::Next;
+        }
+
+        // As RepeatRangeNode::codegen counts: the distance between the
+        // bounds in the index type's width, unsigned, over the step.
+        Flow range(RepeatRangeNode *node)
+        {
+            const string &type = node->indexType;
+            IntTypeInfo info = intTypeInfo(type);
+            uint64_t first = convert(eval(node->lo.get()), type, node).bits;
+            uint64_t limit = convert(eval(node->hi.get()), type, node).bits;
+
+            bool enter;
+            if (info.isSigned)
+                enter = node->descending ? static_cast<int64_t>(first) > static_cast<int64_t>(limit)
+                                         : static_cast<int64_t>(first) < static_cast<int64_t>(limit);
+            else
+                enter = node->descending ? first > limit : first < limit;
+            if (!enter)
+                return Flow::Next;
+
+            uint64_t mask = info.bits == 64 ? ~uint64_t(0) : (uint64_t(1) << info.bits) - 1;
+            uint64_t distance = (node->descending ? first - limit : limit - first) & mask;
+            uint64_t tripCount = node->stepSize == 1 ? distance : (distance - 1) / node->stepSize + 1;
+
+            Value index;
+            index.type = type;
+            index.bits = first;
+            for (uint64_t k = 0; k < tripCount; ++k)
+            {
+                scopes.emplace_back();
+                declare(node->var, index, nullptr);
+                Flow flow = exec(node->body.get());
+                leaveScope();
+                if (flow == Flow::Break)
+                    break;
+                index.bits = fit(node->descending ? index.bits - node->stepSize : index.bits + node->stepSize, type);
+            }
+            return Flow::Next;
+        }
+    };
+
+    // A literal the generated code turns into value, of the variable's type.
+    ASTNodePtr literalFor(const Value &value, string_view type, int line)
+    {
+        if (isIntegerType(type))
+        {
+            // The bits as unsigned digits: the literal is read in the type's
+            // width, so a negative value comes out as it was.
+            IntTypeInfo info = intTypeInfo(type);
+            uint64_t bits = info.bits == 64 ? value.bits : value.bits & ((uint64_t(1) << info.bits) - 1);
+            auto literal = makeIntLiteral(bits, line);
+            literal->intType = string(type);
+            return literal;
+        }
+        if (type == "float")
+        {
+            // Nine significant digits read back as the same float.
+            char text[32];
+            int length = snprintf(text, sizeof(text), "%.9g", static_cast<double>(value.number));
+            char *kept = allocateText(length);
+            memcpy(kept, text, length);
+            auto literal = make_unique<LiteralNode>(LiteralNode::Type::Float, string_view(kept, length));
+            literal->lineNumber = line;
+            return literal;
+        }
+        if (type == "bool")
+            return makeBoolLiteral(value.bits != 0, line);
+
+        char *kept = allocateText(value.text.size());
+        memcpy(kept, value.text.data(), value.text.size());
+        return makeStringLiteral(string_view(kept, value.text.size()), line);
+    }
+}
+
+size_t evaluatePrefix(ProgramNode *root, const EvalBudget &budget, bool remarks)
+{
+    if (!root || root->statements.empty() || budget.steps == 0)
+        return 0;
+
+    Evaluator evaluator(budget);
+    size_t done = 0;
+    Stop stop{0, nullptr};
+    for (; done < root->statements.size(); ++done)
+    {
+        try
+        {
+            evaluator.runTopLevel(root->statements[done].get());
+        }
+        catch (const Stop &reason)
+        {
+            stop = reason;
+            break;
+        }
+    }
+
+    int firstLine = root->statements.front()->lineNumber;
+    if (remarks)
+    {
+        if (done > 0)
+            cerr << "line " << firstLine << ": remark [partial-eval]: " << done << " of "
+                 << root->statements.size() << " top-level statements run at compile time, writing "
+                 << evaluator.output.size() << " bytes\n";
+        if (stop.reason)
+            cerr << "line " << stop.line << ": remark [partial-eval]: missed: stopped: " << stop.reason << "\n";
+    }
+    if (done == 0)
+        return 0;
+
+    // The text, then the variables as the statements left them, in place of
+    // the statements. Dead code elimination drops the ones nothing reads.
+    vector<ASTNodePtr> statements;
+    if (!evaluator.output.empty())
+    {
+        char *kept = allocateText(evaluator.output.size());
+        memcpy(kept, evaluator.output.data(), evaluator.output.size());
+        auto output = make_unique<OutputNode>(string_view(kept, evaluator.output.size()));
+        output->lineNumber = firstLine;
+        statements.push_back(move(output));
+    }
+    for (DeclarationNode *declared : evaluator.globals)
+    {
+        auto declaration = makeDeclaration(declared->typeName, declared->identifier,
+                                           literalFor(evaluator.valueOf(declared->identifier), declared->typeName,
+                                                      declared->lineNumber),
+                                           declared->lineNumber);
+        declaration->exprType = string(declared->typeName);
+        statements.push_back(move(declaration));
+    }
+    for (size_t k = done; k < root->statements.size(); ++k)
+        statements.push_back(move(root->statements[k]));
+    root->statements = move(statements);
+    return done;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class ProgramNode;
+
+// Partial evaluation of an analyzed program. Many programs read nothing and
+// print the same text on every run; evaluatePrefix runs the top-level
+// statements at compile time, in order, until one needs what only a run can
+// provide: input, random numbers, tasks, generators, a library or another
+// file's variables. The statements before it are replaced by one write of
+// the text they printed and a declaration of each top-level variable they
+// declared, initialized to its value at that point. The rest of the program
+// is left as it is and runs after them.
+//
+// Evaluation follows the generated code: integers wrap at their width,
+// floats are 32-bit, output is formatted as printf and the runtime would.
+// Whatever it cannot reproduce exactly, such as a division that would trap,
+// ends the prefix too. A statement is replaced only if it finishes within the
+// budget; one that runs out of it starts the rest of the program, as if
+// evaluation had never started it.
+struct EvalBudget
+{
+    uint64_t steps = 1000000;           // statements and expressions evaluated
+    uint64_t memory = uint64_t(64) << 20; // bytes of output and of strings held at once
+};
+
+// Returns the number of top-level statements replaced. With remarks, reports
+// how far evaluation got and why it stopped, in the form of -Rpass remarks.
+size_t evaluatePrefix(ProgramNode *root, const EvalBudget &budget, bool remarks);
@@ -0,0 +1,83 @@
+// frontend.cpp
+#include "driver.h"
+#include "ast_interface.h"
+#include "deadcode.h"
+#include "interface.h"
+#include "source.h"
+#include <iostream>
+
+extern "C" {
+    int yyparse();
+}
+
+extern int yylineno;
+
+void resetFrontEnd()
+{
+    astRoot.reset();
+    symbolTable = SymbolTable();
+    semanticError = false;
+    yylineno = 1;
+}
+
+bool parseFile(const char *path)
+{
+    // Symbols are kept: later files of a program see earlier declarations.
+    // The tree goes first, as it points into the source being replaced.
+    astRoot.reset();
+
+    if (!loadSource(path)) {
+        std::cerr << "Could not open file: " << path << "\n";
+        return false;
+    }
+    scanSource();
+
+    int status = yyparse();
+
+    if (status != 0) {
+        std::cerr << "Parsing failed.\n";
+        return false;
+    }
+    if (!astRoot) {
+        std::cerr << "AST root is null.\n";
+        return false;
+    }
+    return true;
+}
+
+bool analyzeProgram()
+{
+    try {
+        std::string resultType = astRoot->analyze(symbolTable);
+        if (semanticError || resultType == "Error") {
+            std::cerr << "Semantic analysis failed. Aborting.\n";
+            return false;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Semantic error: " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool analyzeStatements(ProgramNode *part)
+{
+    try {
+        for (const auto &stmt : part->statements)
+            stmt->analyze(symbolTable);
+    } catch (const std::exception &e) {
+        std::cerr << "Semantic error: " << e.what() << "\n";
+        semanticError = true;
+    }
+    return !semanticError;
+}
+
+int checkFile(const char *path)
+{
+    resetFrontEnd();
+    Importer importer; // libraries without a current interface are checked, not built
+    if (!importer.parse(path) || !analyzeProgram())
+        return 1;
+    eliminateDeadCode(astRoot.get(), nullptr); // for its warnings
+    return 0;
+}
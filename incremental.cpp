@@ -0,0 +1,270 @@
+// incremental.cpp
+#include "incremental.h"
+#include "ast.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    const char *CACHE_MAGIC = "flec-incremental 3";
+
+    // FNV-1a, seeded so that keys chain.
+    uint64_t hashBytes(uint64_t seed, const char *data, size_t size)
+    {
+        uint64_t h = seed ^ 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < size; ++i)
+        {
+            h ^= static_cast<unsigned char>(data[i]);
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    template <typename T>
+    uint64_t hashValue(uint64_t seed, const T &value)
+    {
+        return hashBytes(seed, reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    // Names are hashed with their terminator so that adjacent ones cannot
+    // run together.
+    uint64_t hashString(uint64_t seed, const std::string &text)
+    {
+        return hashBytes(seed, text.c_str(), text.size() + 1);
+    }
+
+    std::string absoluteSource(const std::string &sourcePath)
+    {
+        std::error_code error;
+        std::filesystem::path absolute = std::filesystem::absolute(sourcePath, error);
+        return error ? sourcePath : absolute.lexically_normal().string();
+    }
+}
+
+std::vector<size_t> IncrementalCache::partition(ProgramNode *root)
+{
+    const auto &stmts = root->statements;
+
+    // The last top-level statement resuming each generator, if the program
+    // declares any at the top level.
+    std::unordered_map<std::string_view, size_t> lastUse;
+    bool generators = std::any_of(stmts.begin(), stmts.end(),
+                                  [](const ASTNodePtr &stmt) { return dynamic_cast<GenNode *>(stmt.get()); });
+    if (generators)
+    {
+        size_t k = 0;
+        std::function<void(ASTNode *)> findUses = [&](ASTNode *node)
+        {
+            if (auto *repeatIn = dynamic_cast<RepeatInNode *>(node))
+                lastUse[repeatIn->generator] = k;
+            node->forEachChild(findUses);
+        };
+        for (; k < stmts.size(); ++k)
+            findUses(stmts[k].get());
+    }
+
+    std::vector<size_t> starts;
+    size_t keep = 0; // the current region has to reach this statement
+    int firstLine = 0;
+    for (size_t k = 0; k < stmts.size(); ++k)
+    {
+        if (starts.empty() || (k > keep && stmts[k]->lineNumber >= firstLine + REGION_LINES))
+        {
+            starts.push_back(k);
+            firstLine = stmts[k]->lineNumber;
+        }
+        if (auto *gen = dynamic_cast<GenNode *>(stmts[k].get()))
+        {
+            auto use = lastUse.find(gen->name);
+            if (use != lastUse.end())
+                keep = std::max(keep, use->second);
+        }
+    }
+    return starts;
+}
+
+std::vector<uint64_t> IncrementalCache::hashRegions(const ProgramNode *root, std::string_view source,
+                                                    const std::vector<size_t> &starts)
+{
+    // Offsets of the first character of each line (line numbers are 1-based).
+    std::vector<size_t> lineStart = {0, 0};
+    for (size_t i = 0; i < source.size(); ++i)
+    {
+        if (source[i] == '\n')
+            lineStart.push_back(i + 1);
+    }
+    auto offsetOfLine = [&](int line) -> size_t
+    {
+        if (line < 1)
+            return 0;
+        if (static_cast<size_t>(line) >= lineStart.size())
+            return source.size();
+        return lineStart[line];
+    };
+
+    // A region owns the source from its first line up to the first line of
+    // the next one; the first region owns what comes before it as well, and
+    // the last one the rest of the file.
+    const auto &stmts = root->statements;
+    std::vector<uint64_t> hashes;
+    for (size_t k = 0; k < starts.size(); ++k)
+    {
+        int line = stmts[starts[k]]->lineNumber;
+        size_t begin = k == 0 ? 0 : offsetOfLine(line);
+        size_t end = k + 1 < starts.size() ? offsetOfLine(stmts[starts[k + 1]]->lineNumber) : source.size();
+        if (end < begin)
+            end = begin;
+        hashes.push_back(hashValue(hashBytes(0, source.data() + begin, end - begin), line));
+    }
+    return hashes;
+}
+
+uint64_t IncrementalCache::regionKey(uint64_t hash, uint64_t state)
+{
+    return hashValue(hashValue(0, hash), state);
+}
+
+uint64_t IncrementalCache::nextState(uint64_t state, const Region &region)
+{
+    uint64_t h = state;
+    for (const Symbol &symbol : region.exports)
+    {
+        h = hashString(h, symbol.name);
+        h = hashString(h, symbol.type);
+        h = hashValue(h, symbol.lineDeclared);
+        h = hashValue(h, symbol.readOnly);
+    }
+    h = hashValue(h, region.exports.size());
+    for (const std::string &name : region.pendingWrites)
+        h = hashString(h, name);
+    return hashValue(h, region.pendingWrites.size());
+}
+
+const IncrementalCache::Region *IncrementalCache::find(uint64_t key) const
+{
+    if (!valid)
+        return nullptr;
+    auto found = byKey.find(key);
+    return found == byKey.end() ? nullptr : &regions[found->second];
+}
+
+bool IncrementalCache::upToDate(const std::string &sourcePath, const std::string &outputPath,
+                                const std::vector<uint64_t> &keys) const
+{
+    if (!valid || keys.size() != regions.size() || source != absoluteSource(sourcePath))
+        return false;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (regions[i].key != keys[i])
+            return false;
+    }
+    SourceStamp stamp;
+    return stampSource(outputPath, stamp) && stamp == output;
+}
+
+// The cache file is a build product of the machine that wrote it: a text
+// header, then for each region a line of counts, its exports, pending
+// writes and hinted loops one per line, and its bitcode as raw bytes.
+bool IncrementalCache::load()
+{
+    clear();
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+
+    std::string magic, storedConfig;
+    std::getline(in, magic);
+    std::getline(in, storedConfig);
+    if (magic != CACHE_MAGIC || storedConfig != config)
+        return false;
+    std::getline(in, source);
+
+    size_t count = 0;
+    in >> output.size >> output.time >> count;
+    for (size_t i = 0; in && i < count; ++i)
+    {
+        Region region;
+        size_t exports = 0, pending = 0, hinted = 0, bytes = 0;
+        in >> std::hex >> region.key >> std::dec >> exports >> pending >> hinted >> bytes;
+        for (size_t e = 0; in && e < exports; ++e)
+        {
+            std::string name, type;
+            int line = 0;
+            bool readOnly = false;
+            in >> name >> type >> line >> readOnly;
+            region.exports.emplace_back(name, type, line, readOnly);
+        }
+        region.pendingWrites.resize(pending);
+        for (std::string &name : region.pendingWrites)
+            in >> name;
+        for (size_t h = 0; in && h < hinted; ++h)
+        {
+            int line = 0;
+            LoopHints hints;
+            in >> line >> hints.unroll >> hints.unrollCount >> hints.vectorize >> hints.interleaveCount;
+            region.hintedLoops.emplace_back(line, hints);
+        }
+        in.get(); // the newline before the bitcode
+        region.bitcode.resize(bytes);
+        in.read(&region.bitcode[0], bytes);
+        regions.push_back(std::move(region));
+    }
+    if (!in)
+    {
+        clear();
+        return false;
+    }
+
+    for (size_t i = 0; i < regions.size(); ++i)
+        byKey.emplace(regions[i].key, i);
+    valid = true;
+    return true;
+}
+
+bool IncrementalCache::store(const std::string &sourcePath, const std::string &outputPath, std::vector<Region> built)
+{
+    clear();
+    SourceStamp stamp;
+    if (!stampSource(outputPath, stamp))
+        return false;
+
+    source = absoluteSource(sourcePath);
+    output = stamp;
+    regions = std::move(built);
+    for (size_t i = 0; i < regions.size(); ++i)
+        byKey.emplace(regions[i].key, i);
+    valid = true;
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out << CACHE_MAGIC << "\n"
+            << config << "\n"
+            << source << "\n"
+            << output.size << " " << output.time << " " << regions.size() << "\n";
+        for (const Region &region : regions)
+        {
+            out << std::hex << region.key << std::dec << " " << region.exports.size() << " "
+                << region.pendingWrites.size() << " " << region.hintedLoops.size() << " " << region.bitcode.size()
+                << "\n";
+            for (const Symbol &symbol : region.exports)
+                out << symbol.name << " " << symbol.type << " " << symbol.lineDeclared << " " << symbol.readOnly
+                    << "\n";
+            for (const std::string &name : region.pendingWrites)
+                out << name << "\n";
+            for (const auto &[line, hints] : region.hintedLoops)
+                out << line << " " << hints.unroll << " " << hints.unrollCount << " " << hints.vectorize << " "
+                    << hints.interleaveCount << "\n";
+            out.write(region.bitcode.data(), region.bitcode.size());
+            out << "\n";
+        }
+        if (!out)
+            return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "interface.h"
+#include "loop_hints.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class ProgramNode;
+
+// What an incremental build (--incremental, --watch) keeps between compiles.
+//
+// The top-level statements of a file are split into regions of about
+// REGION_LINES source lines, and each region is compiled into a module of
+// its own, the way the files of a multi-file program are: its top-level
+// variables become globals that the regions after it refer to. A region's
+// key covers its source text, the line it starts on and the symbol state it
+// starts from (the globals declared before it and the writes of spawn blocks
+// still pending), which is everything its analysis and code depend on. A
+// rebuild analyzes and generates only the regions whose key is not cached;
+// the others declare their globals from the cache and bring their module as
+// bitcode, and all of them are linked.
+//
+// The cache also records which source it describes and the size and
+// modification time of the output it wrote, so a cache is not taken for the
+// output of another source written to the same path since.
+class IncrementalCache
+{
+public:
+    static constexpr int REGION_LINES = 256;
+
+    struct Region
+    {
+        uint64_t key = 0;
+        std::vector<Symbol> exports;            // its top-level variables, in order
+        std::vector<std::string> pendingWrites; // pending when it ends
+        std::vector<std::pair<int, LoopHints>> hintedLoops;
+        std::string bitcode;                    // its module
+    };
+
+    // config names the compile options the cached output was built with; a
+    // cache written under different options is never used.
+    IncrementalCache(const std::string &cachePath, const std::string &config)
+        : path(cachePath), config(config) {}
+
+    // Index of the first statement of each region of root. A region also
+    // takes in every statement that resumes a generator it declares, since a
+    // generator can only be resumed in the module that defines it.
+    static std::vector<size_t> partition(ProgramNode *root);
+
+    // Hash of the source text and first line of each region, given the
+    // starts from partition.
+    static std::vector<uint64_t> hashRegions(const ProgramNode *root, std::string_view source,
+                                             const std::vector<size_t> &starts);
+
+    // Key of a region with hash from hashRegions, which starts from state.
+    static uint64_t regionKey(uint64_t hash, uint64_t state);
+
+    // The state the region after region starts from, when region starts from
+    // state.
+    static uint64_t nextState(uint64_t state, const Region &region);
+
+    // The cached region with key, or null.
+    const Region *find(uint64_t key) const;
+
+    // True when the cache holds exactly the regions with keys for sourcePath
+    // and outputPath is still the file it wrote.
+    bool upToDate(const std::string &sourcePath, const std::string &outputPath,
+                  const std::vector<uint64_t> &keys) const;
+
+    bool load();
+    // Record the regions of sourcePath once outputPath has been written.
+    bool store(const std::string &sourcePath, const std::string &outputPath, std::vector<Region> built);
+    void clear()
+    {
+        regions.clear();
+        byKey.clear();
+        valid = false;
+    }
+
+private:
+    std::string path;
+    std::string config;
+    std::string source; // absolute
+    SourceStamp output;
+    std::vector<Region> regions; // in program order
+    std::unordered_map<uint64_t, size_t> byKey;
+    bool valid = false;
+};
@@ -0,0 +1,394 @@
+// interface.cpp
+#include "interface.h"
+#include "ast_interface.h"
+#include "driver.h"
+#include "source.h"
+#include "types.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char INTERFACE_MAGIC[] = "flec-interface 3\n";
+
+    // The init function of the library at path (absolute): libraries with
+    // the same file name in different directories are linked together, so
+    // the name carries an FNV-1a hash of the whole path.
+    std::string libraryInitName(const std::string &path)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (char c : path)
+        {
+            h ^= static_cast<unsigned char>(c);
+            h *= 0x100000001b3ULL;
+        }
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(h));
+        return "flec.init.lib." + fs::path(path).stem().string() + "." + hash;
+    }
+
+    // Fields are in the host's byte order: an interface is a build product
+    // of the machine that wrote it, like the incremental cache.
+    class Writer
+    {
+    public:
+        std::string data;
+
+        template <typename T>
+        void put(T value)
+        {
+            data.append(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        void put(std::string_view text)
+        {
+            put(static_cast<uint32_t>(text.size()));
+            data.append(text);
+        }
+    };
+
+    // Reads the fields back out of the mapping; any read past its end makes
+    // ok false and returns zeros.
+    class Reader
+    {
+    public:
+        bool ok = true;
+
+        Reader(const char *data, size_t size) : next(data), limit(data + size) {}
+
+        template <typename T>
+        T get()
+        {
+            T value{};
+            if (take(sizeof(value)))
+                std::memcpy(&value, next - sizeof(value), sizeof(value));
+            return value;
+        }
+
+        std::string_view text()
+        {
+            uint32_t size = get<uint32_t>();
+            return take(size) ? std::string_view(next - size, size) : std::string_view();
+        }
+
+        std::string_view bytes(size_t size) { return take(size) ? std::string_view(next - size, size) : std::string_view(); }
+
+        void align(size_t alignment, const char *base)
+        {
+            size_t offset = (next - base) % alignment;
+            if (offset)
+                take(alignment - offset);
+        }
+
+    private:
+        const char *next;
+        const char *limit;
+
+        bool take(size_t size)
+        {
+            if (!ok || static_cast<size_t>(limit - next) < size)
+                return ok = false;
+            next += size;
+            return true;
+        }
+    };
+
+    // The bitcode starts at a multiple of this, as the reader prefers.
+    constexpr size_t BITCODE_ALIGNMENT = 8;
+}
+
+bool stampSource(const std::string &path, SourceStamp &stamp)
+{
+    std::error_code EC;
+    uintmax_t size = fs::file_size(path, EC);
+    if (EC)
+        return false;
+    fs::file_time_type time = fs::last_write_time(path, EC);
+    if (EC)
+        return false;
+    stamp.size = size;
+    stamp.time = time.time_since_epoch().count();
+    return true;
+}
+
+std::string interfacePath(const std::string &sourcePath)
+{
+    return fs::path(sourcePath).replace_extension(".fli").string();
+}
+
+ModuleInterface::~ModuleInterface()
+{
+    if (mapping)
+        munmap(mapping, mappedSize);
+}
+
+std::unique_ptr<ModuleInterface> ModuleInterface::load(const std::string &sourcePath, const SourceStamp &stamp,
+                                                       std::string_view config)
+{
+    int fd = open(interfacePath(sourcePath).c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return nullptr;
+
+    auto result = std::make_unique<ModuleInterface>();
+    result->mapping = mapping;
+    result->mappedSize = info.st_size;
+
+    const char *base = static_cast<const char *>(mapping);
+    Reader in(base, result->mappedSize);
+    if (in.bytes(sizeof(INTERFACE_MAGIC) - 1) != INTERFACE_MAGIC || in.text() != config)
+        return nullptr;
+
+    SourceStamp built;
+    built.size = in.get<uint64_t>();
+    built.time = in.get<int64_t>();
+    if (!in.ok || built != stamp)
+        return nullptr;
+
+    uint32_t importCount = in.get<uint32_t>();
+    for (uint32_t i = 0; i < importCount && in.ok; ++i)
+    {
+        Import import;
+        import.path = std::string(in.text());
+        import.stamp.size = in.get<uint64_t>();
+        import.stamp.time = in.get<int64_t>();
+        SourceStamp now;
+        if (!in.ok || !stampSource(import.path, now) || now != import.stamp)
+            return nullptr;
+        result->imports.push_back(std::move(import));
+    }
+
+    uint32_t symbolCount = in.get<uint32_t>();
+    for (uint32_t i = 0; i < symbolCount && in.ok; ++i)
+    {
+        std::string_view name = in.text();
+        std::string_view type = in.text();
+        int32_t line = in.get<int32_t>();
+        bool readOnly = in.get<uint8_t>() != 0;
+        result->symbols.emplace_back(name, type, line, readOnly);
+    }
+
+    result->initName = std::string(in.text());
+    in.align(BITCODE_ALIGNMENT, base);
+    uint64_t bitcodeSize = in.get<uint64_t>();
+    result->bitcode = in.bytes(bitcodeSize);
+    if (!in.ok || result->bitcode.empty())
+        return nullptr;
+    return result;
+}
+
+bool ModuleInterface::write(const std::string &sourcePath, std::string_view config, const SourceStamp &stamp,
+                            const std::vector<Import> &imports, const std::vector<Symbol> &symbols,
+                            const std::string &initName, std::string_view bitcode)
+{
+    Writer out;
+    out.data.append(INTERFACE_MAGIC, sizeof(INTERFACE_MAGIC) - 1);
+    out.put(config);
+    out.put(stamp.size);
+    out.put(stamp.time);
+
+    out.put(static_cast<uint32_t>(imports.size()));
+    for (const Import &import : imports)
+    {
+        out.put(std::string_view(import.path));
+        out.put(import.stamp.size);
+        out.put(import.stamp.time);
+    }
+
+    out.put(static_cast<uint32_t>(symbols.size()));
+    for (const Symbol &symbol : symbols)
+    {
+        out.put(std::string_view(symbol.name));
+        out.put(std::string_view(symbol.type));
+        out.put(static_cast<int32_t>(symbol.lineDeclared));
+        out.put(static_cast<uint8_t>(symbol.readOnly));
+    }
+
+    out.put(std::string_view(initName));
+    out.data.resize((out.data.size() + BITCODE_ALIGNMENT - 1) / BITCODE_ALIGNMENT * BITCODE_ALIGNMENT, '\0');
+    out.put(static_cast<uint64_t>(bitcode.size()));
+    out.data.append(bitcode);
+
+    // Written aside and renamed into place, so a compile that is importing
+    // the library at the same time maps either interface but never half of one.
+    const std::string path = interfacePath(sourcePath);
+    const std::string partial = path + ".tmp";
+    {
+        std::ofstream file(partial, std::ios::binary | std::ios::trunc);
+        file.write(out.data.data(), out.data.size());
+        if (!file)
+        {
+            std::cerr << "Could not write interface " << path << "\n";
+            return false;
+        }
+    }
+    std::error_code EC;
+    fs::rename(partial, path, EC);
+    if (EC)
+    {
+        std::cerr << "Could not write interface " << path << ": " << EC.message() << "\n";
+        fs::remove(partial, EC);
+        return false;
+    }
+    return true;
+}
+
+bool Importer::parse(const std::string &path)
+{
+    // A library importing the file being compiled is a cycle too.
+    std::string key = fs::absolute(path).lexically_normal().string();
+    active.insert(key);
+    std::vector<size_t> imports;
+    bool ok = parse(path, imports);
+    active.erase(key);
+    return ok;
+}
+
+bool Importer::parse(const std::string &path, std::vector<size_t> &imports)
+{
+    if (!parseFile(path.c_str()))
+        return false;
+
+    // Copied out of the tree: building a library replaces the source.
+    std::vector<std::pair<std::string, int>> wanted;
+    fs::path directory = fs::path(path).parent_path();
+    for (const auto &stmt : astRoot->statements)
+    {
+        if (auto *import = dynamic_cast<ImportNode *>(stmt.get()))
+            wanted.emplace_back(fs::absolute(directory / std::string(import->path)).lexically_normal().string(),
+                                import->lineNumber);
+    }
+    if (wanted.empty())
+        return true;
+
+    size_t buildsBefore = builds;
+    for (const auto &import : wanted)
+    {
+        size_t index;
+        if (!require(import.first, import.second, index))
+            return false;
+        imports.push_back(index);
+    }
+    if (builds != buildsBefore && !parseFile(path.c_str()))
+        return false;
+
+    size_t next = 0;
+    for (const auto &stmt : astRoot->statements)
+    {
+        if (auto *import = dynamic_cast<ImportNode *>(stmt.get()))
+            import->exports = &libraries[imports[next++]]->symbols;
+    }
+    return true;
+}
+
+bool Importer::require(const std::string &path, int line, size_t &index)
+{
+    auto found = byPath.find(path);
+    if (found != byPath.end())
+    {
+        index = found->second;
+        return true;
+    }
+    if (!active.insert(path).second)
+    {
+        std::cerr << "Line " << line << ": import cycle through " << path << "\n";
+        return false;
+    }
+
+    auto library = std::make_unique<Library>();
+    library->path = path;
+    bool ok = stampSource(path, library->stamp);
+    if (!ok)
+    {
+        std::cerr << "Line " << line << ": cannot import " << path << "\n";
+    }
+    else if ((library->interface = ModuleInterface::load(path, library->stamp, config)))
+    {
+        library->initName = library->interface->initName;
+        library->symbols = std::move(library->interface->symbols);
+        for (const auto &import : library->interface->imports)
+        {
+            size_t dependency;
+            if (!(ok = require(import.path, line, dependency)))
+                break;
+            library->imports.push_back(dependency);
+        }
+        ok = ok && loadLibrary(*library);
+    }
+    else
+    {
+        ok = build(*library);
+    }
+    active.erase(path);
+    if (!ok)
+        return false;
+
+    index = libraries.size();
+    byPath.emplace(path, index);
+    libraries.push_back(std::move(library));
+    return true;
+}
+
+bool Importer::build(Library &library)
+{
+    ++builds;
+
+    // The library is compiled on its own; the file importing it gets its
+    // symbols back afterwards.
+    SymbolTable outer = std::move(symbolTable);
+    bool outerError = semanticError;
+    resetFrontEnd();
+
+    // Diagnostics about the library's source name it.
+    bool ok;
+    {
+        DiagnosticFile file(library.path);
+        ok = parse(library.path, library.imports) && analyzeProgram();
+        if (ok)
+        {
+            std::set<std::string> imported;
+            for (size_t i : library.imports)
+            {
+                for (const Symbol &symbol : libraries[i]->symbols)
+                    imported.insert(symbol.name);
+            }
+            // Generators stay private: their code is not a global another
+            // module can resume.
+            for (const auto &entry : symbolTable.globals())
+            {
+                if (!imported.count(entry.first) && !isGeneratorType(entry.second.type))
+                    library.symbols.push_back(entry.second);
+            }
+            std::sort(library.symbols.begin(), library.symbols.end(), [](const Symbol &a, const Symbol &b)
+                      { return a.lineDeclared != b.lineDeclared ? a.lineDeclared < b.lineDeclared : a.name < b.name; });
+
+            library.initName = libraryInitName(library.path);
+            ok = buildLibrary(library);
+        }
+    }
+    if (!ok)
+        std::cerr << "Could not import " << library.path << "\n";
+
+    astRoot.reset();
+    symbolTable = std::move(outer);
+    semanticError = outerError;
+    return ok;
+}
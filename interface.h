@@ -0,0 +1,128 @@
+#pragma once
+#include "SymbolTable.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Precompiled library interfaces. `import "lib.flec"` needs what lib.flec
+// declares at the top level and its code. The first compile that imports it
+// writes both to lib.fli next to it; later imports map that file instead of
+// running the front end over the library again.
+//
+// An interface holds, after a magic line:
+//   - the options its code was generated with (-g),
+//   - the size and modification time of the source it was built from,
+//   - the libraries that source imports, with theirs at the time,
+//   - the symbols analysis declared at its top level,
+//   - the name of the function running its top-level statements,
+//   - its module, as bitcode.
+// It is current while none of those files changed and the options match. A library refers to
+// what it imports only by symbol, so a change rebuilds the libraries that
+// import the changed one and not those further up.
+
+// When a source file last changed, as far as interfaces are concerned.
+struct SourceStamp
+{
+    uint64_t size = 0;
+    int64_t time = 0;
+
+    bool operator==(const SourceStamp &other) const { return size == other.size && time == other.time; }
+    bool operator!=(const SourceStamp &other) const { return !(*this == other); }
+};
+
+// Returns false if path cannot be examined.
+bool stampSource(const std::string &path, SourceStamp &stamp);
+
+// lib.flec -> lib.fli
+std::string interfacePath(const std::string &sourcePath);
+
+// A library's interface file, mapped into memory.
+class ModuleInterface
+{
+public:
+    struct Import
+    {
+        std::string path;
+        SourceStamp stamp;
+    };
+
+    std::vector<Import> imports;
+    std::vector<Symbol> symbols;
+    std::string initName;
+    std::string_view bitcode; // in the mapping
+
+    ModuleInterface() = default;
+    ModuleInterface(const ModuleInterface &) = delete;
+    ModuleInterface &operator=(const ModuleInterface &) = delete;
+    ~ModuleInterface();
+
+    // Map the interface of sourcePath, whose source is now at stamp, for a
+    // compile with options config. Returns null when there is none or it is
+    // not current.
+    static std::unique_ptr<ModuleInterface> load(const std::string &sourcePath, const SourceStamp &stamp,
+                                                 std::string_view config);
+
+    // Write the interface of sourcePath as built from the source at stamp.
+    // Reports and returns false if it cannot be written.
+    static bool write(const std::string &sourcePath, std::string_view config, const SourceStamp &stamp,
+                      const std::vector<Import> &imports, const std::vector<Symbol> &symbols,
+                      const std::string &initName, std::string_view bitcode);
+
+private:
+    void *mapping = nullptr;
+    size_t mappedSize = 0;
+};
+
+// Resolves the imports of the files being compiled: a library is loaded from
+// its interface when that is current, and parsed and analyzed here
+// otherwise. That uses the front end's globals, so parse() parses the
+// importing file again after it.
+class Importer
+{
+public:
+    struct Library
+    {
+        std::string path; // absolute
+        SourceStamp stamp;
+        std::string initName;
+        std::vector<Symbol> symbols;                // what importing it declares
+        std::vector<size_t> imports;                // indices into libraries
+        std::unique_ptr<ModuleInterface> interface; // null if it was built in this run
+    };
+
+    // Every library imported so far, each after the ones it imports.
+    std::vector<std::unique_ptr<Library>> libraries;
+
+    // Options that change the code of a library; interfaces written with
+    // others are not current.
+    std::string config;
+
+    virtual ~Importer() = default;
+
+    // Parse path into astRoot, as parseFile, and point its import statements
+    // at their libraries. Reports and returns false on failure.
+    bool parse(const std::string &path);
+
+protected:
+    // Called for a library loaded from its interface, once its imports are.
+    // Returning false fails the import.
+    virtual bool loadLibrary(Library &) { return true; }
+
+    // Called for a library without a current interface once it is analyzed:
+    // astRoot is its tree and symbolTable holds its declarations. Returning
+    // false fails the import.
+    virtual bool buildLibrary(Library &) { return true; }
+
+private:
+    std::map<std::string, size_t> byPath;
+    std::set<std::string> active; // being imported: meeting one again is a cycle
+    size_t builds = 0;
+
+    bool parse(const std::string &path, std::vector<size_t> &imports);
+    bool require(const std::string &path, int line, size_t &index);
+    bool build(Library &library);
+};
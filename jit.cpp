@@ -0,0 +1,179 @@
+// jit.cpp
+#include "jit.h"
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/TargetSelect.h>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <unistd.h>
+
+using namespace llvm;
+
+namespace
+{
+    // Writes /tmp/perf-<pid>.map, where perf looks up code that is in no
+    // file: a line per function with its address, size and name, in hex.
+    class PerfMapListener : public JITEventListener
+    {
+    public:
+        PerfMapListener()
+        {
+            const std::string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+            file = std::fopen(path.c_str(), "w");
+            if (!file)
+                std::cerr << "Could not write " << path << "\n";
+        }
+
+        ~PerfMapListener() override
+        {
+            if (file)
+                std::fclose(file);
+        }
+
+        void notifyObjectLoaded(ObjectKey, const object::ObjectFile &object,
+                                const RuntimeDyld::LoadedObjectInfo &info) override
+        {
+            if (!file)
+                return;
+            // The object as loaded: its sections are at their addresses in
+            // memory, and so are its symbols.
+            object::OwningBinary<object::ObjectFile> loaded = info.getObjectForDebug(object);
+            if (!loaded.getBinary())
+                return;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto &entry : object::computeSymbolSizes(*loaded.getBinary()))
+            {
+                const object::SymbolRef &symbol = entry.first;
+                Optional<object::SymbolRef::Type> type = expectedToOptional(symbol.getType());
+                Optional<StringRef> name = expectedToOptional(symbol.getName());
+                Optional<uint64_t> address = expectedToOptional(symbol.getAddress());
+                if (!type || *type != object::SymbolRef::ST_Function || !name || !address || !entry.second)
+                    continue;
+                std::fprintf(file, "%" PRIx64 " %" PRIx64 " %s\n", *address, entry.second, name->str().c_str());
+            }
+            std::fflush(file);
+        }
+
+    private:
+        std::FILE *file = nullptr;
+        std::mutex mutex; // objects can be loaded from several threads
+    };
+
+    // libflecrt.so is built next to the compiler; programs compiled to files
+    // load it from the working directory (lli -load=./libflecrt.so).
+    std::string findRuntime()
+    {
+        static int anchor;
+        std::string executable = sys::fs::getMainExecutable(nullptr, &anchor);
+        if (!executable.empty())
+        {
+            SmallString<256> path(sys::path::parent_path(executable));
+            sys::path::append(path, "libflecrt.so");
+            if (sys::fs::exists(path))
+                return std::string(path);
+        }
+        return "./libflecrt.so";
+    }
+
+    int reportError(Error error)
+    {
+        std::cerr << "JIT error: " << toString(std::move(error)) << "\n";
+        return 1;
+    }
+}
+
+int runModule(Module &module, bool usesRuntime, bool perfMap)
+{
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+
+    // The JIT owns the module it compiles and its context; the compile keeps
+    // its own, so it gets a copy.
+    SmallVector<char, 0> bitcode;
+    raw_svector_ostream out(bitcode);
+    WriteBitcodeToFile(module, out);
+    auto llvmContext = std::make_unique<LLVMContext>();
+    Expected<std::unique_ptr<Module>> copy =
+        parseBitcodeFile(MemoryBufferRef(StringRef(bitcode.data(), bitcode.size()), module.getName()), *llvmContext);
+    if (!copy)
+        return reportError(copy.takeError());
+
+    // Declared before the JIT, which reports to them until it is destroyed.
+    // The jitdump listener is LLVM's and is null when LLVM was built without
+    // perf support.
+    std::unique_ptr<PerfMapListener> perfMapListener;
+    JITEventListener *jitdumpListener = nullptr;
+    if (perfMap)
+    {
+        perfMapListener = std::make_unique<PerfMapListener>();
+        jitdumpListener = JITEventListener::createPerfJITEventListener();
+        if (!jitdumpListener)
+            std::cerr << "This LLVM cannot write jitdump files; only the perf map is written\n";
+    }
+
+    // RuntimeDyld rather than JITLink: event listeners attach to it.
+    auto jit = orc::LLJITBuilder()
+                   .setObjectLinkingLayerCreator(
+                       [&](orc::ExecutionSession &session, const Triple &) -> Expected<std::unique_ptr<orc::ObjectLayer>>
+                       {
+                           auto layer = std::make_unique<orc::RTDyldObjectLinkingLayer>(
+                               session, [] { return std::make_unique<SectionMemoryManager>(); });
+                           if (perfMapListener)
+                               layer->registerJITEventListener(*perfMapListener);
+                           if (jitdumpListener)
+                               layer->registerJITEventListener(*jitdumpListener);
+                           return std::unique_ptr<orc::ObjectLayer>(std::move(layer));
+                       })
+                   .create();
+    if (!jit)
+        return reportError(jit.takeError());
+
+    orc::JITDylib &mainLibrary = (*jit)->getMainJITDylib();
+    const char prefix = (*jit)->getDataLayout().getGlobalPrefix();
+    auto process = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(prefix);
+    if (!process)
+        return reportError(process.takeError());
+    mainLibrary.addGenerator(std::move(*process));
+    if (usesRuntime)
+    {
+        const std::string runtimePath = findRuntime();
+        auto runtime = orc::DynamicLibrarySearchGenerator::Load(runtimePath.c_str(), prefix);
+        if (!runtime)
+        {
+            consumeError(runtime.takeError());
+            std::cerr << "Could not load the Flec runtime " << runtimePath << "\n";
+            return 1;
+        }
+        mainLibrary.addGenerator(std::move(*runtime));
+    }
+
+    if (Error error = (*jit)->addIRModule(orc::ThreadSafeModule(std::move(*copy), std::move(llvmContext))))
+        return reportError(std::move(error));
+    if (Error error = (*jit)->initialize(mainLibrary))
+        return reportError(std::move(error));
+    Expected<JITEvaluatedSymbol> mainSymbol = (*jit)->lookup("main");
+    if (!mainSymbol)
+        return reportError(mainSymbol.takeError());
+
+    // The program prints through C stdio, the compiler through iostreams.
+    std::cout.flush();
+    auto *programMain = jitTargetAddressToFunction<int (*)()>(mainSymbol->getAddress());
+    int result = programMain();
+    std::fflush(stdout);
+
+    if (Error error = (*jit)->deinitialize(mainLibrary))
+        return reportError(std::move(error));
+    return result;
+}
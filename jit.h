@@ -0,0 +1,24 @@
+#pragma once
+
+namespace llvm
+{
+    class Module;
+}
+
+// Run the finished program in this process with LLVM's JIT (--run) instead
+// of writing it out. A copy of module is compiled for the host; the C library
+// comes from this process and, if usesRuntime, the Flec runtime from the
+// libflecrt.so next to the compiler or in the working directory. Returns
+// what the program's main returns, or 1 if it cannot be run.
+//
+// With perfMap (--perf-map) perf can name the JIT-compiled code, outlined
+// loop bodies and task functions included:
+//   - /tmp/perf-<pid>.map gets a line per function, which `perf top` and
+//     `perf report` read as they are;
+//   - LLVM's jitdump listener writes jit-<pid>.dump (under $JITDUMPDIR or
+//     ~/.debug/jit), which after `perf record -k 1` and `perf inject --jit`
+//     adds the code itself and, with -g, its source lines.
+// Both are written once, while the code is loaded, so the program runs at
+// full speed. Loading costs a line per function for the map and a copy of
+// the code and its line table for the dump.
+int runModule(llvm::Module &module, bool usesRuntime, bool perfMap);
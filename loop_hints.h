@@ -0,0 +1,13 @@
+#pragma once
+
+// Optimization hints written before a loop: @unroll, @unroll(n), @vectorize,
+// @novectorize, @interleave(n). Lowered to llvm.loop metadata.
+struct LoopHints
+{
+    bool unroll = false;    // @unroll or @unroll(n)
+    int unrollCount = 0;    // n of @unroll(n); 0 lets LLVM choose
+    int vectorize = -1;     // -1: no hint, 0: @novectorize, 1: @vectorize
+    int interleaveCount = 0; // n of @interleave(n)
+
+    bool empty() const { return !unroll && vectorize < 0 && interleaveCount == 0; }
+};
@@ -1,79 +1,185 @@
-#include "ast_interface.h"
-#include "codegen.h"
-#include <llvm/Support/raw_ostream.h>
-#include <llvm/Support/FileSystem.h>
+#include "driver.h"
+#include "incremental.h"
+#include "server.h"
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
-#include <fstream>
-#include <exception>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <vector>
 
-bool semanticError = false;
-
-extern "C" {
-    int yyparse();
-}
-
-extern FILE* yyin;
-extern std::unique_ptr<ProgramNode> astRoot;
-
-int main(int argc, char** argv)
+// Poll the source file and recompile whenever it changes. Never returns
+// unless the file disappears.
+static int watchFile(const char *path, const CompileOptions &options, IncrementalCache &cache)
 {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <source file>\n";
+    namespace fs = std::filesystem;
+    std::error_code EC;
+    fs::file_time_type lastWrite = fs::last_write_time(path, EC);
+    if (EC) {
+        std::cerr << "Could not open file: " << path << "\n";
         return 1;
     }
 
-    yyin = fopen(argv[1], "r");
-    if (!yyin) {
-        std::cerr << "Could not open file: " << argv[1] << "\n";
-        return 1;
-    }
+    std::cout << "Watching " << path << " for changes (Ctrl-C to stop)\n";
+    compileFile(path, options, &cache);
+    std::cout.flush();
 
-    if (yyparse() != 0) {
-        std::cerr << "Parsing failed.\n";
-        fclose(yyin);
-        return 1;
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        fs::file_time_type current = fs::last_write_time(path, EC);
+        if (EC) {
+            std::cerr << "Lost " << path << ": " << EC.message() << "\n";
+            return 1;
+        }
+        if (current == lastWrite)
+            continue;
+        lastWrite = current;
+
+        auto start = std::chrono::steady_clock::now();
+        compileFile(path, options, &cache);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+        std::cout << "Rebuild finished in " << elapsed.count() / 1000.0 << " ms" << std::endl;
     }
+}
+
+// The number in an option like --eval-steps=N. Returns false unless text is
+// all decimal digits.
+static bool parseCount(const char *text, uint64_t &count)
+{
+    char *end;
+    errno = 0;
+    unsigned long long value = std::strtoull(text, &end, 10);
+    if (!std::isdigit(static_cast<unsigned char>(*text)) || *end != '\0' || errno == ERANGE)
+        return false;
+    count = value;
+    return true;
+}
 
-    if (astRoot) {
-        try {
-            std::cout << "Parsed successfully.\n";
-            std::cout << "Running semantic analysis...\n";
+int main(int argc, char** argv)
+{
+    bool incremental = false;
+    bool watch = false;
+    bool check = false;
+    bool server = false;
+    bool client = false;
+    CompileOptions options;
+    std::string serverCommand;
+    std::string socketPath = defaultSocketPath();
+    std::vector<std::string> sources;
 
-            // Assuming semantic analysis is done here:
-            std::string resultType = astRoot->analyze(symbolTable);
-            if (semanticError || resultType == "Error") {
-                std::cerr << "Semantic analysis failed. Aborting.\n";
-                fclose(yyin);
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--incremental") == 0) {
+            incremental = true;
+        } else if (std::strcmp(argv[i], "--watch") == 0) {
+            watch = true;
+            incremental = true;
+        } else if (std::strncmp(argv[i], "--emit=", 7) == 0) {
+            if (!parseEmitKind(argv[i] + 7, options.emit)) {
+                std::cerr << "Unknown output kind: " << argv[i] + 7 << " (expected ll or bc)\n";
                 return 1;
             }
-
-            CodeGenContext context;
-            context.generateCode(astRoot.get());
-
-            std::error_code EC;
-            llvm::raw_fd_ostream outFile("output.ll", EC, llvm::sys::fs::OF_None);
-            if (EC) {
-                std::cerr << "Error opening output file: " << EC.message() << "\n";
-                fclose(yyin);
+        } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options.outputPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--print-ir") == 0) {
+            options.printIR = true;
+        } else if (std::strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' && argv[i][2] <= '3' &&
+                   argv[i][3] == '\0') {
+            options.optLevel = argv[i][2] - '0';
+        } else if (std::strcmp(argv[i], "-Rpass") == 0) {
+            options.remarks = true;
+        } else if (std::strncmp(argv[i], "-Rpass=", 7) == 0) {
+            options.remarks = true;
+            options.remarkFilter = argv[i] + 7;
+        } else if (std::strcmp(argv[i], "--rt-stats") == 0) {
+            options.rtStats = true;
+        } else if (std::strcmp(argv[i], "-g") == 0) {
+            options.debugInfo = true;
+        } else if (std::strcmp(argv[i], "--run") == 0) {
+            options.run = true;
+        } else if (std::strcmp(argv[i], "--perf-map") == 0) {
+            options.perfMap = true;
+        } else if (std::strncmp(argv[i], "--eval-steps=", 13) == 0) {
+            if (!parseCount(argv[i] + 13, options.evalBudget.steps)) {
+                std::cerr << "Invalid step budget: " << argv[i] + 13 << "\n";
+                return 1;
+            }
+        } else if (std::strncmp(argv[i], "--eval-memory=", 14) == 0) {
+            if (!parseCount(argv[i] + 14, options.evalBudget.memory)) {
+                std::cerr << "Invalid memory budget: " << argv[i] + 14 << "\n";
                 return 1;
             }
-            context.module->print(outFile, nullptr);
-            outFile.close();
+        } else if (std::strncmp(argv[i], "-march=", 7) == 0 || std::strncmp(argv[i], "-mcpu=", 6) == 0) {
+            options.cpu = std::strchr(argv[i], '=') + 1;
+        } else if (std::strcmp(argv[i], "--multiversion") == 0) {
+            options.multiversion = true;
+        } else if (std::strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (std::strcmp(argv[i], "--server") == 0) {
+            server = true;
+        } else if (std::strcmp(argv[i], "--client") == 0) {
+            client = true;
+        } else if (std::strcmp(argv[i], "--server-stats") == 0) {
+            serverCommand = "STATS";
+        } else if (std::strcmp(argv[i], "--server-stop") == 0) {
+            serverCommand = "SHUTDOWN";
+        } else if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (argv[i][0] == '-') {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 1;
+        } else {
+            sources.push_back(argv[i]);
+        }
+    }
+
+    if (server)
+        return runServer(socketPath);
+    if (!serverCommand.empty())
+        return queryServer(socketPath, serverCommand);
 
-            std::cout << "LLVM IR written to output.ll\n";
-            std::cout << "Run it using: lli output.ll\n";
+    if (check && !sources.empty()) {
+        int result = 0;
+        for (const auto &source : sources)
+            result |= checkFile(source.c_str());
+        return result;
+    }
+
+    // A run has no output for the cache to find up to date.
+    if (sources.empty() || ((incremental || watch) && (sources.size() > 1 || options.run)) ||
+        (options.perfMap && !options.run) || (options.multiversion && !options.cpu.empty())) {
+        std::cerr << "Usage: " << argv[0] << " [--emit=ll|bc] [-o <path>] [-O0..-O3] [-Rpass[=<regex>]] [--eval-steps=N] [--eval-memory=BYTES] [-march=native|-mcpu=<cpu>|--multiversion] [--print-ir] [--rt-stats] [-g] [--incremental] [--watch] <source file>\n"
+                  << "       " << argv[0] << " [--emit=ll|bc] [-o <path>] [-O0..-O3] [-march=native|-mcpu=<cpu>|--multiversion] [-g] <source file> <source file>...\n"
+                  << "       " << argv[0] << " --run [--perf-map] [-O0..-O3] [--eval-steps=N] [--eval-memory=BYTES] [-march=native|-mcpu=<cpu>|--multiversion] [--rt-stats] [-g] <source file>...\n"
+                  << "       " << argv[0] << " --check <source file>\n"
+                  << "       " << argv[0] << " --server [--socket <path>]    (compiles one request at a time)\n"
+                  << "       " << argv[0] << " --client [--socket <path>] [compile options] <source file>...\n"
+                  << "       " << argv[0] << " --server-stats | --server-stop [--socket <path>]\n";
+        return 1;
+    }
 
-        } catch (const std::exception &e) {
-            std::cerr << "Semantic error: " << e.what() << "\n";
-            fclose(yyin);
+    if (client) {
+        // The program would run in the server, and the cache is this
+        // process's; neither is sent.
+        if (options.run || incremental) {
+            std::cerr << "--client cannot be combined with --run, --incremental or --watch\n";
             return 1;
         }
-    } else {
-        std::cerr << "AST root is null.\n";
-        fclose(yyin);
-        return 1;
+        return runClient(socketPath, sources, options);
     }
 
-    fclose(yyin);
-    return 0;
+    if (sources.size() > 1)
+        return compileProgram(sources, options);
+
+    IncrementalCache cache(options.resolvedOutputPath() + ".fp", optionsConfig(options));
+    if (incremental)
+        cache.load();
+
+    if (watch)
+        return watchFile(sources[0].c_str(), options, cache);
+
+    return compileFile(sources[0].c_str(), options, incremental ? &cache : nullptr);
 }
@@ -0,0 +1,370 @@
+// optimizer.cpp
+#include "optimizer.h"
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+
+using namespace llvm;
+
+namespace
+{
+    const char *DEFAULT_REMARK_FILTER = "^(loop-unroll|loop-vectorize|loop-delete|transform-warning)$";
+
+    struct Remark
+    {
+        int line;
+        std::string pass;
+        bool passed;
+        std::string message;
+    };
+
+    // Loop headers are named loop.line<N> by RepeatStmtNode::codegen; that is
+    // the only link from an IR loop back to its source line without -g.
+    int sourceLineOf(const Value *region)
+    {
+        const auto *block = dyn_cast_or_null<BasicBlock>(region);
+        if (!block)
+            return 0;
+        StringRef name = block->getName();
+        size_t pos = name.find(".line");
+        if (pos == StringRef::npos)
+            return 0;
+        int line = 0;
+        name.substr(pos + 5).consumeInteger(10, line);
+        return line;
+    }
+
+    // Remarks the hint report is based on are always collected; only those
+    // whose pass matches the user's filter are printed.
+    const char *HINT_PASSES = "^(loop-unroll|loop-vectorize|loop-delete)$";
+
+    class RemarkHandler : public DiagnosticHandler
+    {
+    public:
+        RemarkHandler(const std::string &filter, std::vector<Remark> &remarks)
+            : filter(filter), hintPasses(HINT_PASSES), remarks(remarks) {}
+
+        bool isAnalysisRemarkEnabled(StringRef) const override { return false; }
+        bool isMissedOptRemarkEnabled(StringRef pass) const override { return wanted(pass); }
+        bool isPassedOptRemarkEnabled(StringRef pass) const override { return wanted(pass); }
+        bool isAnyRemarkEnabled() const override { return true; }
+
+        bool handleDiagnostics(const DiagnosticInfo &DI) override
+        {
+            const auto *opt = dyn_cast<DiagnosticInfoIROptimization>(&DI);
+            if (!opt)
+                return false;
+
+            bool passed = isa<OptimizationRemark>(opt);
+            if (!passed && !isa<OptimizationRemarkMissed>(opt) && !isa<DiagnosticInfoOptimizationFailure>(opt))
+                return true;
+
+            Remark remark{sourceLineOf(opt->getCodeRegion()), opt->getPassName().str(), passed, opt->getMsg()};
+            if (filter.match(remark.pass))
+            {
+                std::cerr << "line " << remark.line << ": remark [" << remark.pass << "]: "
+                          << (passed ? "" : "missed: ") << remark.message << "\n";
+            }
+            remarks.push_back(remark);
+            return true;
+        }
+
+    private:
+        bool wanted(StringRef pass) const { return filter.match(pass) || hintPasses.match(pass); }
+
+        mutable Regex filter;
+        mutable Regex hintPasses;
+        std::vector<Remark> &remarks;
+    };
+
+    // The processor -mcpu= asks for and the features to go with it. A named
+    // processor needs none: the backend knows what each model has. For
+    // native they are the host's own, as the operating system can turn off
+    // some of what the model has (AVX-512 state, for one).
+    void resolveCPU(const std::string &requested, std::string &cpu, std::string &features)
+    {
+        if (requested != "native")
+        {
+            cpu = requested.empty() ? "generic" : requested;
+            return;
+        }
+        cpu = sys::getHostCPUName().str();
+        StringMap<bool> hostFeatures;
+        if (!sys::getHostCPUFeatures(hostFeatures))
+            return;
+        std::vector<std::string> list;
+        for (const auto &feature : hostFeatures)
+            list.push_back((feature.second ? "+" : "-") + feature.first().str());
+        std::sort(list.begin(), list.end());
+        features = join(list, ",");
+    }
+
+    std::unique_ptr<TargetMachine> createHostTargetMachine(const std::string &cpu, const std::string &features)
+    {
+
+        std::string triple = sys::getDefaultTargetTriple();
+        std::string error;
+        const Target *target = TargetRegistry::lookupTarget(triple, error);
+        if (!target)
+        {
+            std::cerr << "Could not find target " << triple << ": " << error << "\n";
+            return nullptr;
+        }
+        std::unique_ptr<MCSubtargetInfo> subtarget(target->createMCSubtargetInfo(triple, "", ""));
+        if (!subtarget || !subtarget->isCPUStringValid(cpu))
+        {
+            std::cerr << "Unknown processor " << cpu << " for " << triple << " (llc -mcpu=help lists them)\n";
+            return nullptr;
+        }
+        return std::unique_ptr<TargetMachine>(
+            target->createTargetMachine(triple, cpu, features, TargetOptions(), Reloc::PIC_));
+    }
+
+    // Built once per processor and kept: a compile server reuses them for
+    // every request. Compiles run one at a time, so the cache is not locked.
+    TargetMachine *hostTargetMachine(const std::string &cpu, const std::string &features)
+    {
+        static std::map<std::pair<std::string, std::string>, std::unique_ptr<TargetMachine>> machines;
+        InitializeNativeTarget();
+        std::unique_ptr<TargetMachine> &machine = machines[{cpu, features}];
+        if (!machine)
+            machine = createHostTargetMachine(cpu, features);
+        return machine.get();
+    }
+
+    // --multiversion: the x86-64 psABI levels each loop function is compiled
+    // for, in the order flec_cpu_level counts them.
+    struct IsaLevel
+    {
+        const char *suffix;
+        const char *cpu;
+    };
+    const IsaLevel ISA_LEVELS[] = {{"sse2", "x86-64"}, {"avx2", "x86-64-v3"}, {"avx512", "x86-64-v4"}};
+
+    // Generator bodies are coroutines until the coroutine passes split them,
+    // and a coroutine cannot be called through a stub.
+    bool hasLoop(Function &function)
+    {
+        if (function.isDeclaration() || function.hasFnAttribute("coroutine.presplit"))
+            return false;
+        DominatorTree dominators(function);
+        LoopInfo loops(dominators);
+        return !loops.empty();
+    }
+
+    // Make each function with a loop a stub that calls one of its clones
+    // through a pointer, set by a constructor from the processor the program
+    // is loaded on. An ifunc would do the same, but lli and the JIT run
+    // constructors and not ifunc resolvers. Until the constructor has run
+    // every pointer holds the baseline clone, so its order among the
+    // constructors does not matter.
+    void multiversion(Module &module, bool report)
+    {
+        std::vector<Function *> functions;
+        for (Function &function : module)
+        {
+            if (hasLoop(function))
+                functions.push_back(&function);
+        }
+        if (functions.empty())
+            return;
+
+        LLVMContext &context = module.getContext();
+        Function *resolver = Function::Create(FunctionType::get(Type::getVoidTy(context), false),
+                                              GlobalValue::InternalLinkage, "flec.multiversion.resolve", module);
+        IRBuilder<> resolve(BasicBlock::Create(context, "entry", resolver));
+        FunctionCallee cpuLevel = module.getOrInsertFunction("flec_cpu_level", resolve.getInt32Ty());
+        Value *level = resolve.CreateCall(cpuLevel, {}, "level");
+
+        for (Function *function : functions)
+        {
+            int line = 0;
+            for (const BasicBlock &block : *function)
+            {
+                if ((line = sourceLineOf(&block)))
+                    break;
+            }
+
+            GlobalVariable *pointer = nullptr;
+            Value *chosen = nullptr;
+            for (unsigned i = 0; i < std::size(ISA_LEVELS); ++i)
+            {
+                ValueToValueMapTy map;
+                Function *clone = CloneFunction(function, map);
+                clone->setName(function->getName() + "." + ISA_LEVELS[i].suffix);
+                clone->setLinkage(GlobalValue::InternalLinkage);
+                clone->addFnAttr("target-cpu", ISA_LEVELS[i].cpu);
+                if (i == 0)
+                {
+                    pointer = new GlobalVariable(module, function->getType(), false, GlobalValue::InternalLinkage,
+                                                 clone, function->getName() + ".impl");
+                    chosen = clone;
+                }
+                else
+                {
+                    chosen = resolve.CreateSelect(resolve.CreateICmpUGE(level, resolve.getInt32(i)), clone, chosen);
+                }
+            }
+            resolve.CreateStore(chosen, pointer);
+
+            // The function keeps its name, linkage and callers; only its body goes.
+            function->dropAllReferences();
+            IRBuilder<> stub(BasicBlock::Create(context, "entry", function));
+            std::vector<Value *> args;
+            for (Argument &arg : function->args())
+                args.push_back(&arg);
+            CallInst *call = stub.CreateCall(function->getFunctionType(),
+                                             stub.CreateLoad(function->getType(), pointer, "impl"), args);
+            call->setTailCall();
+            if (function->getReturnType()->isVoidTy())
+                stub.CreateRetVoid();
+            else
+                stub.CreateRet(call);
+
+            if (report)
+                std::cerr << "line " << line << ": remark [multiversion]: " << function->getName().str()
+                          << " cloned for sse2, avx2 and avx512\n";
+        }
+        resolve.CreateRetVoid();
+        appendToGlobalCtors(module, resolver, 65535);
+    }
+
+    bool hasPassedRemark(const std::vector<Remark> &remarks, int line, const std::string &pass,
+                         const std::string &text = "")
+    {
+        for (const auto &r : remarks)
+        {
+            if (r.line == line && r.passed && r.pass == pass && r.message.find(text) != std::string::npos)
+                return true;
+        }
+        return false;
+    }
+
+    void reportHints(const std::vector<Remark> &remarks, const std::vector<std::pair<int, LoopHints>> &hintedLoops)
+    {
+        for (const auto &loop : hintedLoops)
+        {
+            int line = loop.first;
+            // A loop whose result is computed in closed form is deleted before
+            // the unroller or vectorizer ever sees it.
+            bool deleted = hasPassedRemark(remarks, line, "loop-delete");
+            auto report = [&](const std::string &hint, bool honored)
+            {
+                std::cerr << "line " << line << ": " << hint
+                          << (honored ? " honored" : deleted ? " not honored (loop deleted)" : " not honored") << "\n";
+            };
+
+            const LoopHints &hints = loop.second;
+            if (hints.unroll)
+            {
+                std::string hint = hints.unrollCount ? "@unroll(" + std::to_string(hints.unrollCount) + ")" : "@unroll";
+                std::string text = hints.unrollCount ? "factor of " + std::to_string(hints.unrollCount) : "";
+                report(hint, hasPassedRemark(remarks, line, "loop-unroll", text));
+            }
+            if (hints.vectorize == 1)
+                report("@vectorize", hasPassedRemark(remarks, line, "loop-vectorize", "vectorized loop"));
+            if (hints.vectorize == 0)
+                report("@novectorize", !hasPassedRemark(remarks, line, "loop-vectorize", "vectorized loop"));
+            if (hints.interleaveCount)
+            {
+                std::string count = std::to_string(hints.interleaveCount);
+                report("@interleave(" + count + ")",
+                       hasPassedRemark(remarks, line, "loop-vectorize", "interleaved count: " + count));
+            }
+        }
+    }
+}
+
+bool optimizeModule(Module &module, int level, const CodeTarget &target, bool remarks,
+                    const std::string &remarkFilter, const std::vector<std::pair<int, LoopHints>> &hintedLoops)
+{
+    std::string cpu, features;
+    resolveCPU(target.cpu, cpu, features);
+    TargetMachine *machine = hostTargetMachine(cpu, features);
+    if (!machine)
+        return false;
+    module.setTargetTriple(machine->getTargetTriple().str());
+    module.setDataLayout(machine->createDataLayout());
+
+    // The attributes are what llc and the JIT go by once the module is
+    // written out; the pipeline below reads them too.
+    if (!target.cpu.empty())
+    {
+        for (Function &function : module)
+        {
+            if (function.isDeclaration())
+                continue;
+            function.addFnAttr("target-cpu", cpu);
+            if (!features.empty())
+                function.addFnAttr("target-features", features);
+        }
+    }
+    if (target.multiversion)
+    {
+        Regex filter(remarkFilter.empty() ? DEFAULT_REMARK_FILTER : remarkFilter);
+        multiversion(module, remarks && filter.match("multiversion"));
+    }
+
+    std::vector<Remark> collected;
+    LLVMContext &context = module.getContext();
+    std::unique_ptr<DiagnosticHandler> previousHandler;
+    if (remarks)
+    {
+        previousHandler = context.getDiagnosticHandler();
+        context.setDiagnosticHandler(std::make_unique<RemarkHandler>(
+            remarkFilter.empty() ? DEFAULT_REMARK_FILTER : remarkFilter, collected));
+    }
+
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+
+    PassBuilder PB(machine);
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    static const OptimizationLevel levels[] = {OptimizationLevel::O0, OptimizationLevel::O1,
+                                               OptimizationLevel::O2, OptimizationLevel::O3};
+    // CoroSplit does not visit a generator that nothing resumes, and the
+    // backend cannot lower the suspend points it would leave; it is dead.
+    for (auto it = module.begin(); it != module.end();)
+    {
+        Function &function = *it++;
+        if (function.hasLocalLinkage() && function.use_empty() && function.hasFnAttribute("coroutine.presplit"))
+            function.eraseFromParent();
+    }
+
+    ModulePassManager MPM = level <= 0 ? PB.buildO0DefaultPipeline(OptimizationLevel::O0)
+                                       : PB.buildPerModuleDefaultPipeline(levels[level > 3 ? 3 : level]);
+    MPM.run(module, MAM);
+
+    if (remarks)
+    {
+        reportHints(collected, hintedLoops);
+        context.setDiagnosticHandler(std::move(previousHandler));
+    }
+    return true;
+}
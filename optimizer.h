@@ -0,0 +1,30 @@
+#pragma once
+#include "loop_hints.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm
+{
+    class Module;
+}
+
+// Where the generated code is to run. Without either option it targets the
+// host's triple with a generic x86-64 processor.
+struct CodeTarget
+{
+    // -march=/-mcpu=: an LLVM processor name, or "native" for the host's
+    // processor and exactly the features it has.
+    std::string cpu;
+    // --multiversion: compile each function with a loop for SSE2, AVX2 and
+    // AVX-512, and pick one when the program is loaded (see flec_cpu_level).
+    bool multiversion = false;
+};
+
+// Run LLVM's standard pipeline for level 0-3 over module, targeting the host
+// with target's processor. When remarks is set, optimization remarks from
+// passes whose name matches remarkFilter (default: the loop transforms) are
+// printed, followed by whether each loop hint in hintedLoops (source line,
+// hints) was honored. Returns false for a processor LLVM does not know.
+bool optimizeModule(llvm::Module &module, int level, const CodeTarget &target, bool remarks,
+                    const std::string &remarkFilter, const std::vector<std::pair<int, LoopHints>> &hintedLoops);
@@ -32,34 +32,42 @@ extern std::unique_ptr<ASTNode> root;
 %code requires {
     #include "ast.h"
     #include "ast_interface.h"
+    #include "source.h"
 }
 
 %union {
-    int ival;
+    unsigned long long ival;
     float fval;
     char cval;
-    char* sval;
+    TokenText text;
     int bval;
     ASTNode* node;
     BlockNode* block;
     DeclarationNode* declarationNodePtr;
     PrintStmtNode* printStmtNodePtr;
     IfStmtNode* ifStmtNodePtr;
+    std::vector<MatchNode::Arm>* matchArms;
     RepeatStmtNode* repeatStmtNodePtr;
     ReturnStmtNode* returnStmtNodePtr;
     std::vector<std::unique_ptr<ASTNode>>* stmtList;
+    LoopHints* loopHints;
+    std::vector<ParallelRepeatNode::Reduction>* reductions;
     const char* typeName;
 }
 
 %token <ival> INTEGER_LITERAL
 %token <fval> FLOAT_LITERAL
-%token <sval> STRING_LITERAL IDENTIFIER
+%token <text> STRING_LITERAL IDENTIFIER LOOP_HINT
 %token <cval> CHAR_LITERAL
 %token <bval> TRUE FALSE
 
 %token INT FLOAT STRING BOOL
+%token INT8 INT16 INT32 INT64 UINT8 UINT16 UINT32 UINT64
 %token PRINT INPUT CLEAR TYPEOF RANDINT
-%token IF ELSE REPEAT RETURN BREAK CONTINUE
+%token IF ELSE MATCH ARROW REPEAT RETURN BREAK CONTINUE
+%token PARALLEL IN REDUCE DOTDOT COLON STEP
+%token SPAWN SYNC GEN YIELD
+%token IMPORT
 %token PLUS MINUS STAR SLASH ASSIGN
 %token EQ NEQ LEQ GEQ LT GT
 %token LPAREN RPAREN LBRACE RBRACE SEMICOLON COMMA
@@ -69,9 +77,13 @@ extern std::unique_ptr<ASTNode> root;
 
 
 %type <node> expression statement declaration print_stmt if_stmt repeat_stmt return_stmt assignment_stmt
+%type <node> parallel_repeat_stmt match_stmt step_clause
 %type <block> block
-%type <stmtList> statement_list
+%type <stmtList> statement_list argument_list arguments
 %type <typeName> type input_call
+%type <loopHints> loop_hints
+%type <reductions> reduce_clause reduction_list
+%type <matchArms> match_arms
 
 
 %left OR
@@ -87,6 +99,9 @@ program:
     program statement {
         if ($2) addToProgram(std::unique_ptr<ASTNode>($2)); // ✅ avoid null
     }
+  | program IMPORT STRING_LITERAL end {
+        addToProgram(makeImport($3.view(), @2.first_line)); // top level only
+    }
   | /* empty */ {
         makeProgram();
     }
@@ -97,10 +112,17 @@ statement:
   | assignment_stmt end        { $$ = $1; }
   | print_stmt end             { $$ = $1; }
   | if_stmt                    { $$ = $1; }
+  | match_stmt                 { $$ = $1; }
   | repeat_stmt                { $$ = $1; }
+  | parallel_repeat_stmt       { $$ = $1; }
   | return_stmt end            { $$ = $1; }
   | BREAK end                  { $$ = makeBreak(@1.first_line).release(); } 
   | CONTINUE end               { $$ = makeContinue(@1.first_line).release(); }
+  | SPAWN block                { $$ = makeSpawn(std::unique_ptr<BlockNode>($2), @1.first_line).release(); }
+  | SYNC end                   { $$ = makeSync(@1.first_line).release(); }
+  | GEN IDENTIFIER block       { $$ = makeGen($2.view(), std::unique_ptr<BlockNode>($3), @1.first_line).release(); }
+  | YIELD expression end       { $$ = makeYield(std::unique_ptr<ASTNode>($2), @1.first_line).release(); }
+  | CLEAR LPAREN RPAREN end    { $$ = makeBuiltinCall("clear", {}, @1.first_line).release(); }
   | NEWLINE                    { $$ = nullptr; } //  harmless, handled above
 ;
 
@@ -116,15 +138,23 @@ statement_list:
 
 declaration:
     type IDENTIFIER ASSIGN expression {
-        $$ = makeDeclaration($1, $2, std::unique_ptr<ASTNode>($4), @2.first_line).release();
+        $$ = makeDeclaration($1, $2.view(), std::unique_ptr<ASTNode>($4), @2.first_line).release();
     }
 ;
 
 type:
-    INT                         { $$ = strdup("int"); }
-  | FLOAT                       { $$ = strdup("float"); }
-  | STRING                      { $$ = strdup("string"); }
-  | BOOL                        { $$ = strdup("bool"); }
+    INT                         { $$ = "int"; }
+  | INT8                        { $$ = "int8"; }
+  | INT16                       { $$ = "int16"; }
+  | INT32                       { $$ = "int"; }
+  | INT64                       { $$ = "int64"; }
+  | UINT8                       { $$ = "uint8"; }
+  | UINT16                      { $$ = "uint16"; }
+  | UINT32                      { $$ = "uint32"; }
+  | UINT64                      { $$ = "uint64"; }
+  | FLOAT                       { $$ = "float"; }
+  | STRING                      { $$ = "string"; }
+  | BOOL                        { $$ = "bool"; }
 ;
 
 print_stmt:
@@ -142,10 +172,117 @@ if_stmt:
     }
 ;
 
+/* match (code) { 1 => { ... } 2, 3 => { ... } else => { ... } } */
+match_stmt:
+    MATCH LPAREN expression RPAREN LBRACE match_arms RBRACE {
+        $$ = makeMatch(std::unique_ptr<ASTNode>($3), std::move(*$6), nullptr, @1.first_line).release();
+        delete $6;
+    }
+  | MATCH LPAREN expression RPAREN LBRACE match_arms ELSE ARROW block newlines RBRACE {
+        $$ = makeMatch(std::unique_ptr<ASTNode>($3), std::move(*$6), std::unique_ptr<BlockNode>($9), @1.first_line).release();
+        delete $6;
+    }
+;
+
+match_arms:
+    /* empty */ {
+        $$ = new std::vector<MatchNode::Arm>();
+    }
+  | match_arms NEWLINE {
+        $$ = $1;
+    }
+  | match_arms arguments ARROW block {
+        addMatchArm(*$1, std::move(*$2), std::unique_ptr<BlockNode>($4), @3.first_line);
+        delete $2;
+        $$ = $1;
+    }
+;
+
+newlines:
+    newlines NEWLINE
+  | /* empty */
+;
+
 repeat_stmt:
     REPEAT LPAREN expression RPAREN block {
         $$ = makeRepeatStmt(std::unique_ptr<ASTNode>($3), std::unique_ptr<BlockNode>($5), @1.first_line).release();
     }
+  | REPEAT IDENTIFIER IN IDENTIFIER block {
+        $$ = makeRepeatIn($2.view(), $4.view(), std::unique_ptr<BlockNode>($5), @1.first_line).release();
+    }
+  | loop_hints REPEAT LPAREN expression RPAREN block {
+        $$ = makeRepeatStmt(std::unique_ptr<ASTNode>($4), std::unique_ptr<BlockNode>($6), *$1, @2.first_line).release();
+        delete $1;
+    }
+  | REPEAT IDENTIFIER IN expression DOTDOT expression step_clause block {
+        $$ = makeRepeatRange($2.view(), std::unique_ptr<ASTNode>($4), std::unique_ptr<ASTNode>($6),
+                             std::unique_ptr<ASTNode>($7), std::unique_ptr<BlockNode>($8), LoopHints(), @1.first_line).release();
+    }
+  | loop_hints REPEAT IDENTIFIER IN expression DOTDOT expression step_clause block {
+        $$ = makeRepeatRange($3.view(), std::unique_ptr<ASTNode>($5), std::unique_ptr<ASTNode>($7),
+                             std::unique_ptr<ASTNode>($8), std::unique_ptr<BlockNode>($9), *$1, @2.first_line).release();
+        delete $1;
+    }
+;
+
+step_clause:
+    STEP expression             { $$ = $2; }
+  | /* empty */                 { $$ = nullptr; }
+;
+
+parallel_repeat_stmt:
+    PARALLEL REPEAT IDENTIFIER IN expression DOTDOT expression reduce_clause block {
+        $$ = makeParallelRepeat($3.view(), std::unique_ptr<ASTNode>($5), std::unique_ptr<ASTNode>($7),
+                                std::move(*$8), std::unique_ptr<BlockNode>($9), @1.first_line).release();
+        delete $8;
+    }
+;
+
+reduce_clause:
+    REDUCE LPAREN reduction_list RPAREN { $$ = $3; }
+  | /* empty */                         { $$ = new std::vector<ParallelRepeatNode::Reduction>(); }
+;
+
+/* reduce(+: sum, max: peak) */
+reduction_list:
+    PLUS COLON IDENTIFIER {
+        $$ = new std::vector<ParallelRepeatNode::Reduction>();
+        addReduction(*$$, "+", $3.view(), @1.first_line);
+    }
+  | STAR COLON IDENTIFIER {
+        $$ = new std::vector<ParallelRepeatNode::Reduction>();
+        addReduction(*$$, "*", $3.view(), @1.first_line);
+    }
+  | IDENTIFIER COLON IDENTIFIER {
+        $$ = new std::vector<ParallelRepeatNode::Reduction>();
+        addReduction(*$$, $1.view(), $3.view(), @1.first_line);
+    }
+  | reduction_list COMMA PLUS COLON IDENTIFIER       { addReduction(*$1, "+", $5.view(), @3.first_line); $$ = $1; }
+  | reduction_list COMMA STAR COLON IDENTIFIER       { addReduction(*$1, "*", $5.view(), @3.first_line); $$ = $1; }
+  | reduction_list COMMA IDENTIFIER COLON IDENTIFIER { addReduction(*$1, $3.view(), $5.view(), @3.first_line); $$ = $1; }
+;
+
+/* @unroll(4) @vectorize ... before a repeat, optionally on their own lines */
+loop_hints:
+    LOOP_HINT {
+        $$ = new LoopHints();
+        addLoopHint(*$$, $1.view(), 0, false, @1.first_line);
+    }
+  | LOOP_HINT LPAREN INTEGER_LITERAL RPAREN {
+        $$ = new LoopHints();
+        addLoopHint(*$$, $1.view(), $3, true, @1.first_line);
+    }
+  | loop_hints LOOP_HINT {
+        addLoopHint(*$1, $2.view(), 0, false, @2.first_line);
+        $$ = $1;
+    }
+  | loop_hints LOOP_HINT LPAREN INTEGER_LITERAL RPAREN {
+        addLoopHint(*$1, $2.view(), $4, true, @2.first_line);
+        $$ = $1;
+    }
+  | loop_hints NEWLINE {
+        $$ = $1;
+    }
 ;
 
 return_stmt:
@@ -156,10 +293,10 @@ return_stmt:
 
 assignment_stmt:
     IDENTIFIER ASSIGN input_call {
-        $$ = makeInputStmt($3, $1, @1.first_line).release(); // input assignment
+        $$ = makeInputStmt($3, $1.view(), @1.first_line).release(); // input assignment
     }
   | IDENTIFIER ASSIGN expression {
-        $$ = makeAssignment($1, std::unique_ptr<ASTNode>($3), @1.first_line).release(); // normal expr assignment
+        $$ = makeAssignment($1.view(), std::unique_ptr<ASTNode>($3), @1.first_line).release(); // normal expr assignment
     }
 ;
 
@@ -172,11 +309,24 @@ block:
 expression:
     INTEGER_LITERAL           { $$ = makeIntLiteral($1, @1.first_line).release(); }
   | FLOAT_LITERAL             { $$ = makeFloatLiteral($1, @1.first_line).release(); }
-  | STRING_LITERAL            { $$ = makeStringLiteral($1, @1.first_line).release(); }
+  | STRING_LITERAL            { $$ = makeStringLiteral($1.view(), @1.first_line).release(); }
   | CHAR_LITERAL              { $$ = makeCharLiteral($1, @1.first_line).release(); }
   | TRUE                      { $$ = makeBoolLiteral(true, @1.first_line).release(); }
   | FALSE                     { $$ = makeBoolLiteral(false, @1.first_line).release(); }
-  | IDENTIFIER                { $$ = makeIdentifier($1, @1.first_line).release(); }
+  | IDENTIFIER                { $$ = makeIdentifier($1.view(), @1.first_line).release(); }
+  | IDENTIFIER LPAREN argument_list RPAREN {
+        $$ = makeBuiltinCall($1.view(), std::move(*$3), @1.first_line).release();
+        delete $3;
+    }
+  | RANDINT LPAREN argument_list RPAREN {
+        $$ = makeBuiltinCall("randint", std::move(*$3), @1.first_line).release();
+        delete $3;
+    }
+  | TYPEOF LPAREN expression RPAREN {
+        std::vector<std::unique_ptr<ASTNode>> args;
+        args.push_back(std::unique_ptr<ASTNode>($3));
+        $$ = makeBuiltinCall("typeof", std::move(args), @1.first_line).release();
+    }
   | expression PLUS expression  { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Add, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
   | expression MINUS expression { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Sub, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
   | expression STAR expression  { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Mul, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
@@ -194,6 +344,22 @@ expression:
   | MINUS expression            { $$ = makeUnaryExpr(UnaryExprNode::Op::Minus, std::unique_ptr<ASTNode>($2), @1.first_line).release(); }
 ;
 
+argument_list:
+    arguments                   { $$ = $1; }
+  | /* empty */                 { $$ = new std::vector<std::unique_ptr<ASTNode>>(); }
+;
+
+arguments:
+    expression {
+        $$ = new std::vector<std::unique_ptr<ASTNode>>();
+        $$->push_back(std::unique_ptr<ASTNode>($1));
+    }
+  | arguments COMMA expression {
+        $1->push_back(std::unique_ptr<ASTNode>($3));
+        $$ = $1;
+    }
+;
+
 input_call:
     INPUT LPAREN type RPAREN {
         $$ = $3;  // typeName (e.g., "int", "float")
@@ -209,5 +375,5 @@ end:
 %%
 
 void yyerror(const char *s) {
-    fprintf(stderr, "Parse error: %s at line %d\n", s, yylineno);
+    std::cerr << "Parse error: " << s << " at line " << yylineno << "\n";
 }
@@ -0,0 +1,329 @@
+// runtime.cpp
+#include "runtime.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Task
+    {
+        // Spawned block
+        flec_task_fn fn = nullptr;
+        void *env = nullptr;
+        int64_t *group = nullptr;
+
+        // Range of a parallel loop, split in half while larger than grain
+        flec_range_fn body = nullptr;
+        int64_t lo = 0, hi = 0, grain = 0;
+    };
+
+    // Chase-Lev work-stealing deque (Lê et al., "Correct and Efficient
+    // Work-Stealing for Weak Memory Models"). The owner pushes and pops at the
+    // bottom without locking; thieves take from the top with a CAS. Arrays
+    // that were grown out of stay allocated until the deque is destroyed, as
+    // a thief may still be reading them.
+    class TaskDeque
+    {
+    public:
+        TaskDeque() { array.store(allocate(256), std::memory_order_relaxed); }
+
+        void push(Task *task)
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            Array *a = array.load(std::memory_order_relaxed);
+            if (b - t > a->capacity - 1)
+                a = grow(a, t, b);
+            a->put(b, task);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        Task *pop()
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            Array *a = array.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b)
+            {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            Task *task = a->get(b);
+            if (t == b)
+            {
+                // Last task: race the thieves for it.
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    task = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return task;
+        }
+
+        Task *steal()
+        {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return nullptr;
+            Array *a = array.load(std::memory_order_acquire);
+            Task *task = a->get(t);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return task;
+        }
+
+    private:
+        struct Array
+        {
+            int64_t capacity;
+            std::unique_ptr<std::atomic<Task *>[]> slots;
+
+            explicit Array(int64_t capacity) : capacity(capacity), slots(new std::atomic<Task *>[capacity]) {}
+            Task *get(int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+            void put(int64_t i, Task *task) { slots[i & (capacity - 1)].store(task, std::memory_order_relaxed); }
+        };
+
+        Array *allocate(int64_t capacity)
+        {
+            arrays.push_back(std::make_unique<Array>(capacity));
+            return arrays.back().get();
+        }
+
+        Array *grow(Array *old, int64_t t, int64_t b)
+        {
+            Array *a = allocate(old->capacity * 2);
+            for (int64_t i = t; i < b; ++i)
+                a->put(i, old->get(i));
+            array.store(a, std::memory_order_release);
+            return a;
+        }
+
+        std::atomic<int64_t> top{0};
+        std::atomic<int64_t> bottom{0};
+        std::atomic<Array *> array{nullptr};
+        std::vector<std::unique_ptr<Array>> arrays; // owner only
+    };
+
+    // Index of the deque this thread owns; 0 for the program's own thread.
+    thread_local unsigned workerIndex = 0;
+
+    class Scheduler
+    {
+    public:
+        explicit Scheduler(unsigned size) : deques(size)
+        {
+            for (auto &deque : deques)
+                deque = std::make_unique<TaskDeque>();
+            for (unsigned i = 1; i < size; ++i)
+                threads.emplace_back([this, i]
+                                     { serve(i); });
+        }
+
+        ~Scheduler()
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto &thread : threads)
+                thread.join();
+        }
+
+        unsigned size() const { return static_cast<unsigned>(deques.size()); }
+
+        void submit(Task *task)
+        {
+            __atomic_fetch_add(task->group, 1, __ATOMIC_RELAXED);
+            deques[workerIndex]->push(task);
+            // Only the first queued task wakes a sleeper; a worker that finds
+            // more waiting behind it wakes the next one (see find).
+            if (queued.fetch_add(1, std::memory_order_seq_cst) <= 0)
+                wakeOne();
+        }
+
+        void wait(int64_t *group)
+        {
+            while (__atomic_load_n(group, __ATOMIC_ACQUIRE) > 0)
+            {
+                if (Task *task = find())
+                    execute(task);
+                else
+                    std::this_thread::yield();
+            }
+        }
+
+        void execute(Task *task)
+        {
+            int64_t *group = task->group;
+            if (task->fn)
+            {
+                task->fn(task->env);
+                std::free(task->env);
+            }
+            else
+            {
+                runRange(task);
+            }
+            delete task;
+            __atomic_fetch_sub(group, 1, __ATOMIC_RELEASE);
+        }
+
+    private:
+        void runRange(Task *task)
+        {
+            // Lazy binary splitting: hand the upper half back to the pool
+            // until the piece left is small enough to run.
+            while (task->hi - task->lo > task->grain)
+            {
+                int64_t mid = task->lo + (task->hi - task->lo) / 2;
+                submit(new Task{nullptr, task->env, task->group, task->body, mid, task->hi, task->grain});
+                task->hi = mid;
+            }
+            task->body(task->lo, task->hi, task->env);
+        }
+
+        Task *find()
+        {
+            unsigned self = workerIndex;
+            Task *task = deques[self]->pop();
+            for (unsigned i = 1; !task && i < size(); ++i)
+                task = deques[(self + i) % size()]->steal();
+            if (task && queued.fetch_sub(1, std::memory_order_seq_cst) > 1)
+                wakeOne();
+            return task;
+        }
+
+        void wakeOne()
+        {
+            if (sleepers.load(std::memory_order_seq_cst) > 0)
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                wake.notify_one();
+            }
+        }
+
+        void serve(unsigned self)
+        {
+            workerIndex = self;
+            for (;;)
+            {
+                if (Task *task = find())
+                {
+                    execute(task);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                sleepers.fetch_add(1, std::memory_order_seq_cst);
+                wake.wait(lock, [this]
+                          { return stopping || queued.load(std::memory_order_seq_cst) > 0; });
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+                if (stopping)
+                    return;
+            }
+        }
+
+        std::vector<std::unique_ptr<TaskDeque>> deques;
+        std::vector<std::thread> threads;
+
+        std::atomic<int64_t> queued{0}; // tasks sitting in some deque
+        std::atomic<int> sleepers{0};
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        bool stopping = false;
+    };
+
+    unsigned poolSize()
+    {
+        if (const char *env = std::getenv("FLEC_THREADS"))
+        {
+            int n = std::atoi(env);
+            if (n > 0)
+                return static_cast<unsigned>(n);
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    Scheduler &scheduler()
+    {
+        static Scheduler instance(poolSize());
+        return instance;
+    }
+
+    std::mutex reductionMutex;
+}
+
+extern "C" void flec_parallel_for(int64_t lo, int64_t hi, flec_range_fn body, void *env)
+{
+    if (hi <= lo)
+        return;
+    Scheduler &s = scheduler();
+    if (s.size() == 1)
+    {
+        body(lo, hi, env);
+        return;
+    }
+
+    int64_t group = 0;
+    int64_t grain = std::max<int64_t>(1, (hi - lo) / (s.size() * 8));
+    s.submit(new Task{nullptr, env, &group, body, lo, hi, grain});
+    s.wait(&group);
+}
+
+extern "C" void flec_spawn(int64_t *group, flec_task_fn body, void *env)
+{
+    Scheduler &s = scheduler();
+    if (s.size() == 1)
+    {
+        // Nothing could run it sooner; skip the queue.
+        body(env);
+        std::free(env);
+        return;
+    }
+    s.submit(new Task{body, env, group});
+}
+
+extern "C" void flec_sync(int64_t *group)
+{
+    if (__atomic_load_n(group, __ATOMIC_ACQUIRE) > 0)
+        scheduler().wait(group);
+}
+
+extern "C" void flec_rt_lock(void)
+{
+    reductionMutex.lock();
+}
+
+extern "C" void flec_rt_unlock(void)
+{
+    reductionMutex.unlock();
+}
+
+extern "C" int32_t flec_cpu_level(void)
+{
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    // The checks include the operating system saving the AVX and AVX-512
+    // registers, not only the processor having them.
+    __builtin_cpu_init();
+    bool v3 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2") &&
+              __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c") && __builtin_cpu_supports("lzcnt") &&
+              __builtin_cpu_supports("movbe");
+    bool v4 = v3 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+              __builtin_cpu_supports("avx512cd") && __builtin_cpu_supports("avx512dq") &&
+              __builtin_cpu_supports("avx512vl");
+    return v4 ? 2 : v3 ? 1 : 0;
+#else
+    return 0;
+#endif
+}
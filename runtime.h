@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+
+// Flec runtime library (libflecrt). Generated code calls these with the C
+// ABI; keep the signatures in sync with CodeGenContext::runtimeFunction users.
+// Strings are in runtime_string.cpp, memory in runtime_arena.cpp, random
+// numbers in runtime_random.cpp, the scheduler and the processor check in
+// runtime.cpp.
+//
+// All parallelism goes through one scheduler: a fixed set of worker threads,
+// each owning a lock-free work-stealing deque. The pool size comes from
+// FLEC_THREADS, else the number of hardware threads; the thread that calls in
+// first (the program's main) is worker 0.
+
+extern "C"
+{
+    // Body of a parallel loop: runs iterations [lo, hi) with the captured
+    // variables in env.
+    typedef void (*flec_range_fn)(int64_t lo, int64_t hi, void *env);
+
+    // Body of a spawned block.
+    typedef void (*flec_task_fn)(void *env);
+
+    // Run body over [lo, hi) on the pool and return when every iteration has
+    // finished.
+    void flec_parallel_for(int64_t lo, int64_t hi, flec_range_fn body, void *env);
+
+    // Queue body(env) as a task of group, a zero-initialized counter owned by
+    // the spawning frame. env must come from malloc; the runtime frees it
+    // after the task has run.
+    void flec_spawn(int64_t *group, flec_task_fn body, void *env);
+
+    // Wait until every task spawned into group has finished, running queued
+    // tasks meanwhile.
+    void flec_sync(int64_t *group);
+
+    // Serialize the final combine step of reductions.
+    void flec_rt_lock(void);
+    void flec_rt_unlock(void);
+
+    // --multiversion: the best x86-64 psABI level this processor and the
+    // operating system support, 0 (SSE2, the baseline) to 2 (AVX-512: v4).
+    // The constructor that picks each function's clone calls it.
+    int32_t flec_cpu_level(void);
+
+    // Memory for runtime values comes from arenas and is never freed one
+    // allocation at a time. Each thread has a stack of regions: a block whose
+    // allocations cannot outlive it (see BlockNode::temporaries) enters one
+    // on entry and exits it on every way out, which releases everything
+    // allocated in it at once. Everything else goes to the global arena,
+    // released with the process.
+
+    // Open a region on this thread and return its mark.
+    int64_t flec_region_enter(void);
+
+    // Release the region with this mark and every region opened after it.
+    void flec_region_exit(int64_t mark);
+
+    // size bytes, 16-byte aligned: from the innermost region when temporary
+    // is set and a region is open, else from the global arena.
+    void *flec_alloc(int64_t size, int32_t temporary);
+
+    // --rt-stats: count allocations from now on and print the totals to
+    // stderr when the program exits.
+    void flec_rt_stats(void);
+
+    // The calling thread's xoshiro256** state for randint, which generated
+    // code advances inline. Seeded on first use from FLEC_SEED if set (each
+    // thread gets its own stream), else from the clock and the thread.
+    uint64_t *flec_rng_state(void);
+
+    // Flec `string`: 16 bytes, passed and returned in two registers. Strings
+    // of up to FLEC_STR_INLINE bytes live in the value itself, zero-padded so
+    // equal short strings have equal data words; longer ones point at their
+    // bytes, which are not NUL-terminated. FLEC_STR_OWNED in len marks a
+    // runtime buffer with a flec_strbuf header in front of the bytes; without
+    // it the bytes belong to a literal or another string. FLEC_STR_TEMP marks
+    // bytes that may be in a region, which must be copied before they are
+    // kept past it.
+    // Generated code passes each string as its two words, (len, data).
+    enum : int64_t
+    {
+        FLEC_STR_INLINE = 8,
+        FLEC_STR_OWNED = INT64_MIN,
+        FLEC_STR_TEMP = INT64_C(1) << 62,
+        FLEC_STR_LENGTH = FLEC_STR_TEMP - 1,
+    };
+
+    struct flec_str
+    {
+        int64_t len; // length in bytes, plus FLEC_STR_OWNED and FLEC_STR_TEMP
+        union
+        {
+            char small[FLEC_STR_INLINE];
+            const char *ptr;
+        };
+    };
+
+    // The functions that build a string take temporary, which says whether
+    // the result may be allocated in the innermost region.
+
+    // a + b. When a ends its buffer and the buffer has room, b is appended in
+    // place, so building a string in a loop copies each byte O(1) times.
+    flec_str flec_str_concat(int64_t alen, int64_t adata, int64_t blen, int64_t bdata, int32_t temporary);
+
+    // count bytes from start, both clamped to the string. Long results share
+    // the bytes of s unless a temporary s has to be copied out.
+    flec_str flec_str_substr(int64_t len, int64_t data, int64_t start, int64_t count, int32_t temporary);
+
+    // s, copied to the global arena if its bytes may be in a region.
+    flec_str flec_str_keep(int64_t len, int64_t data);
+
+    // <0, 0 or >0 as a sorts before, equal to or after b, bytewise.
+    int32_t flec_str_cmp(int64_t alen, int64_t adata, int64_t blen, int64_t bdata);
+
+    // a == b. Generated code checks the lengths and compares inline strings
+    // itself, and calls this only for long strings of equal length.
+    int32_t flec_str_eq(int64_t alen, int64_t adata, int64_t blen, int64_t bdata);
+
+    // print(s): s and a newline on stdout.
+    void flec_str_print(int64_t len, int64_t data);
+
+    // input(string): the next whitespace-delimited word on stdin.
+    flec_str flec_str_input(int32_t temporary);
+}
@@ -0,0 +1,179 @@
+// runtime_arena.cpp
+#include "runtime.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    constexpr int64_t ALIGN = 16;
+    constexpr int64_t CHUNK_SIZE = 64 * 1024;
+
+    // Chunks of an arena are linked newest first; the bytes follow the
+    // header.
+    struct alignas(ALIGN) Chunk
+    {
+        Chunk *prev;
+        char *end;
+    };
+
+    // Bump allocator over a list of chunks.
+    struct Arena
+    {
+        Chunk *chunk = nullptr;
+        char *cur = nullptr;
+        char *end = nullptr;
+        Chunk *spare = nullptr; // released standard-size chunks, for reuse
+    };
+
+    // Where the region arena stood when a region was entered.
+    struct Mark
+    {
+        Chunk *chunk;
+        char *cur;
+        int64_t used;
+    };
+
+    // Both arenas are per thread, so allocation takes no lock. Strings in
+    // the global arena may still be shared between threads: nothing in it
+    // is released before the process exits.
+    thread_local Arena globalArena;
+    thread_local Arena regionArena;
+    thread_local std::vector<Mark> marks;
+    thread_local int64_t regionUsed = 0; // bytes allocated in the open regions
+
+    // --rt-stats counters, shared by all threads.
+    std::atomic<bool> statsEnabled{false};
+    std::atomic<int64_t> globalBytes{0};
+    std::atomic<int64_t> regionBytes{0};
+    std::atomic<int64_t> inUse{0};
+    std::atomic<int64_t> peakInUse{0};
+    std::atomic<int64_t> resets{0};
+
+    [[noreturn]] void outOfMemory()
+    {
+        std::fputs("flec: out of memory\n", stderr);
+        std::abort();
+    }
+
+    void count(std::atomic<int64_t> &bytes, int64_t size)
+    {
+        bytes.fetch_add(size, std::memory_order_relaxed);
+        int64_t now = inUse.fetch_add(size, std::memory_order_relaxed) + size;
+        int64_t peak = peakInUse.load(std::memory_order_relaxed);
+        while (now > peak && !peakInUse.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Give arena a new chunk with room for size bytes. Large requests get a
+    // chunk of their own size, which is not reused once released.
+    void grow(Arena &arena, int64_t size)
+    {
+        Chunk *chunk = nullptr;
+        if (size <= CHUNK_SIZE && arena.spare)
+        {
+            chunk = arena.spare;
+            arena.spare = chunk->prev;
+        }
+        else
+        {
+            int64_t bytes = std::max(size, CHUNK_SIZE);
+            chunk = static_cast<Chunk *>(std::malloc(sizeof(Chunk) + bytes));
+            if (!chunk)
+                outOfMemory();
+            chunk->end = reinterpret_cast<char *>(chunk + 1) + bytes;
+        }
+        chunk->prev = arena.chunk;
+        arena.chunk = chunk;
+        arena.cur = reinterpret_cast<char *>(chunk + 1);
+        arena.end = chunk->end;
+    }
+
+    void *bump(Arena &arena, int64_t size)
+    {
+        size = (size + ALIGN - 1) & ~(ALIGN - 1);
+        if (arena.end - arena.cur < size)
+            grow(arena, size);
+        void *result = arena.cur;
+        arena.cur += size;
+        return result;
+    }
+
+    bool standardSize(const Chunk *chunk)
+    {
+        return chunk->end - reinterpret_cast<const char *>(chunk + 1) == CHUNK_SIZE;
+    }
+}
+
+extern "C" int64_t flec_region_enter(void)
+{
+    marks.push_back({regionArena.chunk, regionArena.cur, regionUsed});
+    return static_cast<int64_t>(marks.size()) - 1;
+}
+
+extern "C" void flec_region_exit(int64_t mark)
+{
+    if (mark < 0 || mark >= static_cast<int64_t>(marks.size()))
+        return;
+    const Mark m = marks[mark];
+    marks.resize(mark);
+
+    Arena &arena = regionArena;
+    while (arena.chunk != m.chunk)
+    {
+        Chunk *chunk = arena.chunk;
+        arena.chunk = chunk->prev;
+        if (standardSize(chunk))
+        {
+            chunk->prev = arena.spare;
+            arena.spare = chunk;
+        }
+        else
+        {
+            std::free(chunk);
+        }
+    }
+    arena.cur = m.cur;
+    arena.end = m.chunk ? m.chunk->end : nullptr;
+
+    if (statsEnabled.load(std::memory_order_relaxed))
+    {
+        inUse.fetch_sub(regionUsed - m.used, std::memory_order_relaxed);
+        resets.fetch_add(1, std::memory_order_relaxed);
+    }
+    regionUsed = m.used;
+}
+
+extern "C" void *flec_alloc(int64_t size, int32_t temporary)
+{
+    bool stats = statsEnabled.load(std::memory_order_relaxed);
+    if (temporary && !marks.empty())
+    {
+        regionUsed += size;
+        if (stats)
+            count(regionBytes, size);
+        return bump(regionArena, size);
+    }
+    if (stats)
+        count(globalBytes, size);
+    return bump(globalArena, size);
+}
+
+extern "C" void flec_rt_stats(void)
+{
+    if (statsEnabled.exchange(true))
+        return;
+    std::atexit([]
+                {
+                    long long global = globalBytes.load(), region = regionBytes.load();
+                    std::fprintf(stderr,
+                                 "flec: %lld bytes allocated (%lld in regions, %lld global), "
+                                 "peak %lld bytes in use, %lld region resets\n",
+                                 global + region, region, global,
+                                 static_cast<long long>(peakInUse.load()),
+                                 static_cast<long long>(resets.load()));
+                });
+}
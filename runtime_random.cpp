@@ -0,0 +1,49 @@
+// runtime_random.cpp
+#include "runtime.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+namespace
+{
+    struct RandomState
+    {
+        uint64_t s[4] = {0, 0, 0, 0};
+        bool seeded = false;
+    };
+
+    thread_local RandomState threadState;
+    std::atomic<uint64_t> streams{0};
+
+    // splitmix64: spreads one seed over the four state words, which must
+    // not all be zero.
+    uint64_t splitmix(uint64_t &x)
+    {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    void seed(RandomState &state)
+    {
+        uint64_t stream = streams.fetch_add(1, std::memory_order_relaxed);
+        uint64_t x;
+        if (const char *fixed = std::getenv("FLEC_SEED"))
+            x = std::strtoull(fixed, nullptr, 10);
+        else
+            x = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+                reinterpret_cast<uintptr_t>(&state);
+        x += stream * 0xd1b54a32d192ed03ULL;
+        for (uint64_t &word : state.s)
+            word = splitmix(x);
+        state.seeded = true;
+    }
+}
+
+extern "C" uint64_t *flec_rng_state(void)
+{
+    if (!threadState.seeded)
+        seed(threadState);
+    return threadState.s;
+}
@@ -0,0 +1,262 @@
+// runtime_string.cpp
+#include "runtime.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Header in front of the bytes of an owned string. used is how far the
+    // buffer has been filled: a string whose end is at used may grow in place,
+    // since no other string can see the bytes past its end. Buffers come
+    // from flec_alloc and are released with their arena or region.
+    struct flec_strbuf
+    {
+        int64_t used;
+        int64_t cap;
+    };
+
+    flec_str make(int64_t len, int64_t data)
+    {
+        flec_str s;
+        s.len = len;
+        std::memcpy(s.small, &data, sizeof(data));
+        return s;
+    }
+
+    int64_t length(const flec_str &s)
+    {
+        return s.len & FLEC_STR_LENGTH;
+    }
+
+    // The bytes of s; for an inline string they are in s itself.
+    const char *bytes(const flec_str &s)
+    {
+        return length(s) <= FLEC_STR_INLINE ? s.small : s.ptr;
+    }
+
+    flec_strbuf *header(const flec_str &s)
+    {
+        return reinterpret_cast<flec_strbuf *>(const_cast<char *>(s.ptr)) - 1;
+    }
+
+    flec_str small(const char *a, int64_t alen, const char *b, int64_t blen)
+    {
+        flec_str s;
+        s.len = alen + blen;
+        std::memset(s.small, 0, sizeof(s.small));
+        if (alen)
+            std::memcpy(s.small, a, alen);
+        if (blen)
+            std::memcpy(s.small + alen, b, blen);
+        return s;
+    }
+
+    // A new owned buffer of at least cap bytes holding a followed by b.
+    flec_str allocate(int64_t cap, const char *a, int64_t alen, const char *b, int64_t blen, bool temporary)
+    {
+        auto *buf = static_cast<flec_strbuf *>(flec_alloc(sizeof(flec_strbuf) + cap, temporary));
+        char *data = reinterpret_cast<char *>(buf + 1);
+        std::memcpy(data, a, alen);
+        if (blen)
+            std::memcpy(data + alen, b, blen);
+        buf->used = alen + blen;
+        buf->cap = cap;
+
+        flec_str s;
+        s.len = (alen + blen) | FLEC_STR_OWNED | (temporary ? FLEC_STR_TEMP : int64_t(0));
+        s.ptr = data;
+        return s;
+    }
+
+    // a followed by the lb bytes at b. A result that must outlive the
+    // innermost region never grows a temporary buffer in place.
+    flec_str append(flec_str a, const char *b, int64_t lb, bool temporary)
+    {
+        int64_t la = length(a);
+        int64_t n = la + lb;
+        if (lb == 0)
+            return a;
+        if (n <= FLEC_STR_INLINE)
+            return small(bytes(a), la, b, lb);
+
+        if ((a.len & FLEC_STR_OWNED) && (temporary || !(a.len & FLEC_STR_TEMP)))
+        {
+            // Claim the space after a; another string may have claimed it
+            // first, possibly on another thread.
+            flec_strbuf *buf = header(a);
+            int64_t expected = la;
+            if (buf->cap >= n &&
+                __atomic_compare_exchange_n(&buf->used, &expected, n, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            {
+                std::memcpy(const_cast<char *>(a.ptr) + la, b, lb);
+                a.len = n | (a.len & ~FLEC_STR_LENGTH);
+                return a;
+            }
+        }
+
+        // Appending to an owned string is the string-building case: leave
+        // room for the next appends so the copies stay linear overall.
+        int64_t cap = (a.len & FLEC_STR_OWNED) ? std::max(n, 2 * la) : n;
+        return allocate(cap, bytes(a), la, b, lb, temporary);
+    }
+
+    // Up to this many bytes, one or two unaligned 16-byte compares beat a
+    // call into libc. Longer strings go to memcmp, which libc already
+    // dispatches to the widest vector unit (3x an SSE2 loop at 4 KiB).
+    constexpr int64_t SHORT_COMPARE = 32;
+
+    // Index of the first byte where a and b differ within n bytes, or n.
+    int64_t mismatch(const char *a, const char *b, int64_t n)
+    {
+        int64_t i = 0;
+#ifdef __SSE2__
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+            unsigned same = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+            if (same != 0xFFFF)
+                return i + __builtin_ctz(~same);
+        }
+#endif
+        while (i < n && a[i] == b[i])
+            ++i;
+        return i;
+    }
+
+    // Whether the n bytes at a and b are equal, n > FLEC_STR_INLINE. Short
+    // strings are covered by two blocks that overlap in the middle, so there
+    // is no loop and no byte-at-a-time tail.
+    bool equalBytes(const char *a, const char *b, int64_t n)
+    {
+        if (a == b)
+            return true;
+        if (n > SHORT_COMPARE)
+            return std::memcmp(a, b, n) == 0;
+#ifdef __SSE2__
+        if (n >= 16)
+        {
+            auto block = [&](int64_t i)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                return _mm_cmpeq_epi8(x, y);
+            };
+            return _mm_movemask_epi8(_mm_and_si128(block(0), block(n - 16))) == 0xFFFF;
+        }
+#endif
+        uint64_t x0, y0, x1, y1;
+        std::memcpy(&x0, a, 8);
+        std::memcpy(&y0, b, 8);
+        std::memcpy(&x1, a + n - 8, 8);
+        std::memcpy(&y1, b + n - 8, 8);
+        if (n <= 16)
+            return x0 == y0 && x1 == y1;
+        return x0 == y0 && x1 == y1 && std::memcmp(a + 8, b + 8, n - 16) == 0;
+    }
+}
+
+extern "C" flec_str flec_str_concat(int64_t alen, int64_t adata, int64_t blen, int64_t bdata, int32_t temporary)
+{
+    flec_str b = make(blen, bdata);
+    return append(make(alen, adata), bytes(b), length(b), temporary);
+}
+
+extern "C" flec_str flec_str_substr(int64_t len, int64_t data, int64_t start, int64_t count, int32_t temporary)
+{
+    flec_str s = make(len, data);
+    int64_t n = length(s);
+    start = std::min(std::max<int64_t>(start, 0), n);
+    count = std::min(std::max<int64_t>(count, 0), n - start);
+    if (count <= FLEC_STR_INLINE)
+        return small(bytes(s) + start, count, nullptr, 0);
+
+    if ((s.len & FLEC_STR_TEMP) && !temporary)
+        return allocate(count, s.ptr + start, count, nullptr, 0, false);
+
+    // A view: it has no header of its own, so it never grows in place.
+    flec_str view;
+    view.len = count | (s.len & FLEC_STR_TEMP);
+    view.ptr = s.ptr + start;
+    return view;
+}
+
+extern "C" flec_str flec_str_keep(int64_t len, int64_t data)
+{
+    flec_str s = make(len, data);
+    if (!(s.len & FLEC_STR_TEMP))
+        return s;
+    return allocate(length(s), s.ptr, length(s), nullptr, 0, false);
+}
+
+extern "C" int32_t flec_str_cmp(int64_t alen, int64_t adata, int64_t blen, int64_t bdata)
+{
+    flec_str a = make(alen, adata);
+    flec_str b = make(blen, bdata);
+    int64_t la = length(a), lb = length(b);
+    int64_t n = std::min(la, lb);
+    const char *x = bytes(a);
+    const char *y = bytes(b);
+    if (x != y)
+    {
+        if (n > SHORT_COMPARE)
+        {
+            int c = std::memcmp(x, y, n);
+            if (c != 0)
+                return c < 0 ? -1 : 1;
+        }
+        else
+        {
+            int64_t i = mismatch(x, y, n);
+            if (i < n)
+                return static_cast<unsigned char>(x[i]) < static_cast<unsigned char>(y[i]) ? -1 : 1;
+        }
+    }
+    return la < lb ? -1 : la > lb ? 1 : 0;
+}
+
+extern "C" int32_t flec_str_eq(int64_t alen, int64_t adata, int64_t blen, int64_t bdata)
+{
+    flec_str a = make(alen, adata);
+    flec_str b = make(blen, bdata);
+    int64_t n = length(a);
+    if (n != length(b))
+        return 0;
+    if (n <= FLEC_STR_INLINE)
+        return adata == bdata; // inline bytes are zero-padded
+    return equalBytes(a.ptr, b.ptr, n);
+}
+
+extern "C" void flec_str_print(int64_t len, int64_t data)
+{
+    flec_str s = make(len, data);
+    std::fwrite(bytes(s), 1, length(s), stdout);
+    std::fputc('\n', stdout);
+}
+
+extern "C" flec_str flec_str_input(int32_t temporary)
+{
+    int c = std::getchar();
+    while (c != EOF && std::isspace(c))
+        c = std::getchar();
+
+    flec_str s = small(nullptr, 0, nullptr, 0);
+    char chunk[64];
+    int64_t n = 0;
+    while (c != EOF && !std::isspace(c))
+    {
+        chunk[n++] = static_cast<char>(c);
+        if (n == sizeof(chunk))
+        {
+            s = append(s, chunk, n, temporary);
+            n = 0;
+        }
+        c = std::getchar();
+    }
+    return append(s, chunk, n, temporary);
+}
@@ -0,0 +1,483 @@
+// scanner.cpp
+// Hand-written scanner with the interface of the flex one in lexer.l (yylex,
+// yyin, yylineno, yyrestart; values in yylval and lines in yylloc), selected
+// with `make SCANNER=simd`. It returns the same tokens for the same input.
+//
+// The input is scanned whole, in place: the source loaded by source.h, or
+// all of yyin after a yyrestart, with zero padding after it. Token text
+// points into it. The long runs -- whitespace, newlines, comments,
+// identifiers, numbers and string bodies -- are classified a block at a
+// time: 16 bytes with SSE2, 32 when built with AVX2 (-mavx2 or a -march that
+// has it). No token contains a zero byte, so every run stops in the padding
+// at the latest.
+#include "parser.tab.h"
+#include "source.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+extern "C" int yylex(void);
+extern bool semanticError;
+
+FILE *yyin = nullptr;
+int yylineno = 1;
+
+namespace
+{
+    using Mask = uint32_t; // bit i: byte i of the block is in the class
+
+#if defined(__AVX2__)
+    constexpr int WIDTH = 32;
+    constexpr Mask FULL = 0xFFFFFFFFu;
+    using Vec = __m256i;
+
+    Vec load(const char *p) { return _mm256_loadu_si256(reinterpret_cast<const Vec *>(p)); }
+    Vec splat(char c) { return _mm256_set1_epi8(c); }
+    Vec eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+    Vec gt(Vec a, Vec b) { return _mm256_cmpgt_epi8(a, b); }
+    Vec both(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+    Vec either(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+    Mask bits(Vec v) { return static_cast<Mask>(_mm256_movemask_epi8(v)); }
+#elif defined(__SSE2__)
+    constexpr int WIDTH = 16;
+    constexpr Mask FULL = 0xFFFFu;
+    using Vec = __m128i;
+
+    Vec load(const char *p) { return _mm_loadu_si128(reinterpret_cast<const Vec *>(p)); }
+    Vec splat(char c) { return _mm_set1_epi8(c); }
+    Vec eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+    Vec gt(Vec a, Vec b) { return _mm_cmpgt_epi8(a, b); }
+    Vec both(Vec a, Vec b) { return _mm_and_si128(a, b); }
+    Vec either(Vec a, Vec b) { return _mm_or_si128(a, b); }
+    Mask bits(Vec v) { return static_cast<Mask>(_mm_movemask_epi8(v)); }
+#else
+    constexpr int WIDTH = 16;
+    constexpr Mask FULL = 0xFFFFu;
+#endif
+
+    bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    bool isLetter(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    // Bytes are compared as signed, so anything past ASCII is below lo.
+    Vec inRange(Vec x, char lo, char hi) { return both(gt(x, splat(lo - 1)), gt(splat(hi + 1), x)); }
+
+    Mask byteMask(const char *p, char c) { return bits(eq(load(p), splat(c))); }
+    Mask spaceMask(const char *p)
+    {
+        Vec x = load(p);
+        return bits(either(either(eq(x, splat(' ')), eq(x, splat('\t'))), eq(x, splat('\r'))));
+    }
+    Mask digitMask(const char *p) { return bits(inRange(load(p), '0', '9')); }
+    Mask wordMask(const char *p)
+    {
+        Vec x = load(p);
+        Vec lower = either(x, splat(0x20)); // folds A-Z onto a-z and nothing else onto them
+        return bits(either(either(inRange(lower, 'a', 'z'), inRange(x, '0', '9')), eq(x, splat('_'))));
+    }
+#else
+    bool isWord(char c) { return isLetter(c) || isDigit(c); }
+
+    template <typename In>
+    Mask scalarMask(const char *p, In in)
+    {
+        Mask m = 0;
+        for (int i = 0; i < WIDTH; ++i)
+            m |= static_cast<Mask>(in(p[i])) << i;
+        return m;
+    }
+
+    Mask byteMask(const char *p, char c)
+    {
+        return scalarMask(p, [c](char x) { return x == c; });
+    }
+    Mask spaceMask(const char *p)
+    {
+        return scalarMask(p, [](char x) { return x == ' ' || x == '\t' || x == '\r'; });
+    }
+    Mask digitMask(const char *p) { return scalarMask(p, isDigit); }
+    Mask wordMask(const char *p) { return scalarMask(p, isWord); }
+#endif
+
+    Mask newlineMask(const char *p) { return byteMask(p, '\n'); }
+    Mask quoteMask(const char *p) { return byteMask(p, '"') | byteMask(p, '\\'); }
+    Mask starMask(const char *p) { return byteMask(p, '*'); }
+
+    // End of the run of class bytes starting at p.
+    template <Mask (*InClass)(const char *)>
+    const char *skipRun(const char *p)
+    {
+        for (;; p += WIDTH)
+        {
+            Mask rest = ~InClass(p) & FULL;
+            if (rest)
+                return p + __builtin_ctz(rest);
+        }
+    }
+
+    // First byte in [p, end) that is in the class, or end.
+    template <Mask (*InClass)(const char *)>
+    const char *find(const char *p, const char *end)
+    {
+        for (; p < end; p += WIDTH)
+        {
+            Mask m = InClass(p);
+            if (m)
+                return std::min(p + __builtin_ctz(m), end);
+        }
+        return end;
+    }
+
+    int countNewlines(const char *p, const char *end)
+    {
+        int n = 0;
+        for (; p + WIDTH <= end; p += WIDTH)
+            n += __builtin_popcount(newlineMask(p));
+        for (; p < end; ++p)
+            n += *p == '\n';
+        return n;
+    }
+
+    struct Keyword
+    {
+        const char *text;
+        size_t length;
+        int token;
+    };
+
+#define KEYWORD(text, token) {text, sizeof(text) - 1, token}
+    const Keyword KEYWORDS[] = {
+        KEYWORD("int", INT), KEYWORD("int8", INT8), KEYWORD("int16", INT16), KEYWORD("int32", INT32),
+        KEYWORD("int64", INT64), KEYWORD("uint8", UINT8), KEYWORD("uint16", UINT16), KEYWORD("uint32", UINT32),
+        KEYWORD("uint64", UINT64), KEYWORD("float", FLOAT), KEYWORD("string", STRING), KEYWORD("bool", BOOL),
+        KEYWORD("true", TRUE), KEYWORD("false", FALSE), KEYWORD("print", PRINT), KEYWORD("input", INPUT),
+        KEYWORD("clear", CLEAR), KEYWORD("typeof", TYPEOF), KEYWORD("randint", RANDINT), KEYWORD("if", IF),
+        KEYWORD("else", ELSE), KEYWORD("repeat", REPEAT), KEYWORD("parallel", PARALLEL), KEYWORD("in", IN),
+        KEYWORD("reduce", REDUCE), KEYWORD("spawn", SPAWN), KEYWORD("sync", SYNC), KEYWORD("gen", GEN),
+        KEYWORD("yield", YIELD), KEYWORD("return", RETURN), KEYWORD("stop", BREAK), KEYWORD("skip", CONTINUE),
+        KEYWORD("import", IMPORT), KEYWORD("match", MATCH), KEYWORD("step", STEP), KEYWORD("and", AND), KEYWORD("or", OR), KEYWORD("not", NOT),
+    };
+#undef KEYWORD
+
+    static_assert(SOURCE_PADDING >= WIDTH, "a block must fit in the padding");
+
+    // yyin's contents, when it is scanned instead of a buffer from source.h.
+    std::vector<char> fileBuffer;
+    const char *cur = nullptr;
+    const char *end = nullptr;
+    bool loaded = false;
+
+    void start(const char *text, size_t size)
+    {
+        cur = text;
+        end = text + size;
+        loaded = true;
+    }
+
+    void load()
+    {
+        fileBuffer.clear();
+        FILE *in = yyin ? yyin : stdin;
+        char chunk[1 << 16];
+        size_t n;
+        while ((n = std::fread(chunk, 1, sizeof(chunk), in)) > 0)
+            fileBuffer.insert(fileBuffer.end(), chunk, chunk + n);
+        size_t size = fileBuffer.size();
+        fileBuffer.resize(size + SOURCE_PADDING, '\0');
+        start(fileBuffer.data(), size);
+    }
+
+    int token(int kind)
+    {
+        yylloc.first_line = yylloc.last_line = yylineno;
+        return kind;
+    }
+
+    TokenText span(const char *p, const char *q)
+    {
+        return {p, static_cast<uint32_t>(q - p)};
+    }
+
+    // The body of a string literal with its escapes replaced, as lexer.l's
+    // translateString does it, in the text arena.
+    TokenText translateString(const char *p, const char *q)
+    {
+        char *text = allocateText(q - p);
+        char *out = text;
+        for (; p < q; ++p)
+        {
+            if (*p != '\\')
+            {
+                *out++ = *p;
+                continue;
+            }
+            switch (*++p)
+            {
+            case 'n':
+                *out++ = '\n';
+                break;
+            case 't':
+                *out++ = '\t';
+                break;
+            case 'r':
+                *out++ = '\r';
+                break;
+            default:
+                *out++ = *p;
+                break;
+            }
+        }
+        return span(text, out);
+    }
+
+    // End of the string literal whose opening quote is at p: `\` escapes any
+    // byte but a newline. Null when the literal is not closed; escaped says
+    // whether there is a `\` in it.
+    const char *stringEnd(const char *p, bool &escaped)
+    {
+        escaped = false;
+        for (const char *q = p + 1;;)
+        {
+            q = find<quoteMask>(q, end);
+            if (q == end)
+                return nullptr;
+            if (*q == '"')
+                return q + 1;
+            if (q + 1 >= end || q[1] == '\n')
+                return nullptr;
+            escaped = true;
+            q += 2;
+        }
+    }
+
+    // End of the block comment opened at p, or null when it is not closed.
+    const char *commentEnd(const char *p)
+    {
+        for (const char *q = p + 2;; ++q)
+        {
+            q = find<starMask>(q, end);
+            if (q == end)
+                return nullptr;
+            if (q + 1 < end && q[1] == '/')
+                return q + 2;
+        }
+    }
+
+    int word(const char *p)
+    {
+        const char *q = skipRun<wordMask>(p + 1);
+        cur = q;
+        size_t length = q - p;
+        for (const Keyword &keyword : KEYWORDS)
+        {
+            if (keyword.length == length && std::memcmp(keyword.text, p, length) == 0)
+            {
+                if (keyword.token == TRUE || keyword.token == FALSE)
+                    yylval.bval = keyword.token == TRUE;
+                return token(keyword.token);
+            }
+        }
+        yylval.text = span(p, q);
+        return token(IDENTIFIER);
+    }
+
+    int number(const char *p)
+    {
+        const char *q = skipRun<digitMask>(p);
+        if (q + 1 < end && *q == '.' && isDigit(q[1]))
+        {
+            q = skipRun<digitMask>(q + 1);
+            cur = q;
+            std::string text(p, q);
+            yylval.fval = std::atof(text.c_str());
+            return token(FLOAT_LITERAL);
+        }
+        cur = q;
+        errno = 0;
+        yylval.ival = std::strtoull(p, nullptr, 10);
+        if (errno == ERANGE)
+        {
+            std::cerr << "Line " << yylineno << ": integer literal out of range\n";
+            semanticError = true;
+        }
+        return token(INTEGER_LITERAL);
+    }
+
+    // The scanner proper; yylex is outside this namespace, where ast.h's
+    // using-directives make names like end and isDigit ambiguous.
+    int scan()
+    {
+        if (!loaded)
+            load();
+
+        for (;;)
+        {
+            const char *p = cur;
+            if (p >= end)
+                return 0;
+
+            cur = p + 1;
+            char c = *p;
+            switch (c)
+            {
+            case ' ':
+            case '\t':
+            case '\r':
+                cur = skipRun<spaceMask>(p);
+                continue;
+            case '\n':
+                cur = skipRun<newlineMask>(p);
+                yylineno += cur - p;
+                return token(NEWLINE);
+            case '/':
+                if (p[1] == '/')
+                {
+                    cur = find<newlineMask>(p + 2, end);
+                    continue;
+                }
+                if (p[1] == '*')
+                {
+                    if (const char *q = commentEnd(p))
+                    {
+                        yylineno += countNewlines(p, q);
+                        cur = q;
+                        continue;
+                    }
+                }
+                return token(SLASH);
+            case '"':
+            {
+                bool escaped;
+                if (const char *q = stringEnd(p, escaped))
+                {
+                    yylineno += countNewlines(p, q);
+                    cur = q;
+                    yylval.text = escaped ? translateString(p + 1, q - 1) : span(p + 1, q - 1);
+                    return token(STRING_LITERAL);
+                }
+                return token(UNKNOWN);
+            }
+            case '\'':
+                if (p + 2 < end && p[1] != '\\' && p[2] == '\'')
+                {
+                    cur = p + 3;
+                    yylineno += p[1] == '\n';
+                    yylval.cval = p[1];
+                    return token(CHAR_LITERAL);
+                }
+                if (p + 3 < end && p[1] == '\\' && p[2] != '\n' && p[3] == '\'')
+                {
+                    cur = p + 4;
+                    yylval.cval = p[1];
+                    return token(CHAR_LITERAL);
+                }
+                return token(UNKNOWN);
+            case '@':
+            {
+                const char *q = p + 1;
+                while (q < end && isLetter(*q))
+                    ++q;
+                if (q == p + 1)
+                    return token(UNKNOWN);
+                cur = q;
+                yylval.text = span(p + 1, q);
+                return token(LOOP_HINT);
+            }
+            case '=':
+                if (p[1] == '=')
+                {
+                    cur = p + 2;
+                    return token(EQ);
+                }
+                if (p[1] == '>')
+                {
+                    cur = p + 2;
+                    return token(ARROW);
+                }
+                return token(ASSIGN);
+            case '!':
+                if (p[1] == '=')
+                {
+                    cur = p + 2;
+                    return token(NEQ);
+                }
+                return token(UNKNOWN);
+            case '<':
+                if (p[1] == '=')
+                {
+                    cur = p + 2;
+                    return token(LEQ);
+                }
+                return token(LT);
+            case '>':
+                if (p[1] == '=')
+                {
+                    cur = p + 2;
+                    return token(GEQ);
+                }
+                return token(GT);
+            case '.':
+                if (p[1] == '.')
+                {
+                    cur = p + 2;
+                    return token(DOTDOT);
+                }
+                return token(UNKNOWN);
+            case '+':
+                return token(PLUS);
+            case '-':
+                return token(MINUS);
+            case '*':
+                return token(STAR);
+            case '(':
+                return token(LPAREN);
+            case ')':
+                return token(RPAREN);
+            case '{':
+                return token(LBRACE);
+            case '}':
+                return token(RBRACE);
+            case ';':
+                return token(SEMICOLON);
+            case ',':
+                return token(COMMA);
+            case ':':
+                return token(COLON);
+            default:
+                if (isLetter(c))
+                    return word(p);
+                if (isDigit(c))
+                    return number(p);
+                return token(UNKNOWN);
+            }
+        }
+    }
+}
+
+void yyrestart(FILE *input_file)
+{
+    yyin = input_file;
+    loaded = false;
+}
+
+void scanBuffer(char *text, size_t size)
+{
+    start(text, size);
+    yylineno = 1;
+}
+
+extern "C" int yylex(void)
+{
+    return scan();
+}
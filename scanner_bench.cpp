@@ -0,0 +1,56 @@
+// scanner_bench.cpp
+// Scanner throughput. `make scanbench` builds this twice, against the flex
+// scanner (scanbench-flex) and against scanner.cpp (scanbench-simd); each
+// lexes the files it is given, loaded as the compiler loads them, and
+// reports the best of several rounds.
+#include "parser.tab.h"
+#include "source.h"
+#include <chrono>
+#include <iostream>
+
+extern "C" int yylex(void);
+extern int yylineno;
+
+// Normally defined by the parser, which is not linked in.
+YYSTYPE yylval;
+YYLTYPE yylloc;
+bool semanticError = false; // set by the scanners on an integer literal out of range
+
+int main(int argc, char **argv)
+{
+    const int rounds = 10;
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <source file>...\n";
+        return 1;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!loadSource(argv[i]))
+        {
+            std::cerr << "Could not open file: " << argv[i] << "\n";
+            return 1;
+        }
+
+        double best = 0;
+        long tokens = 0;
+        for (int round = 0; round < rounds; ++round)
+        {
+            scanSource();
+            tokens = 0;
+
+            auto start = std::chrono::steady_clock::now();
+            while (yylex() != 0)
+                ++tokens;
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (round == 0 || seconds < best)
+                best = seconds;
+        }
+
+        double megabytes = sourceText().size() / 1e6;
+        std::cout << argv[i] << ": " << tokens << " tokens, " << yylineno << " lines, " << megabytes / best
+                  << " MB/s\n";
+    }
+    return 0;
+}
@@ -0,0 +1,382 @@
+// server.cpp
+#include "server.h"
+#include "driver.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// Wire format, one request per connection:
+//   request:  "COMPILE <field>\t<field>...\n" | "STATS\n" | "SHUTDOWN\n"
+//   response: "<status> <length>\n" followed by <length> bytes of text
+// A COMPILE field is "source=<path>", once per source in order, or one of
+// the compile options, named as on the command line without the dashes:
+// "output=<path>", "emit=<ll|bc>", "O=<level>", "print-ir", "Rpass" or
+// "Rpass=<regex>", "rt-stats", "g", "eval-steps=<n>", "eval-memory=<n>",
+// "mcpu=<cpu>", "multiversion". Paths are absolute; the client resolves
+// them against its own cwd.
+
+namespace
+{
+    // The parser, symbol table, AST root and source arena are process
+    // globals, so requests are accepted concurrently but compiled one at a
+    // time (see server.h). A request's latency includes its wait here.
+    std::mutex compileMutex;
+
+    std::mutex statsMutex;
+    std::vector<double> latenciesMs;
+
+    std::atomic<bool> shuttingDown{false};
+    std::atomic<int> activeConnections{0};
+
+    // A peer that has gone away is a failed write, not a SIGPIPE that would
+    // take the whole server down with it.
+    bool writeAll(int fd, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool readLine(int fd, std::string &line)
+    {
+        line.clear();
+        char c;
+        while (read(fd, &c, 1) == 1)
+        {
+            if (c == '\n')
+                return true;
+            line.push_back(c);
+        }
+        return !line.empty();
+    }
+
+    bool readExact(int fd, std::string &data, size_t size)
+    {
+        data.resize(size);
+        size_t got = 0;
+        while (got < size)
+        {
+            ssize_t n = read(fd, &data[got], size - got);
+            if (n <= 0)
+                return false;
+            got += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    void sendResponse(int fd, int status, const std::string &text)
+    {
+        writeAll(fd, std::to_string(status) + " " + std::to_string(text.size()) + "\n" + text);
+    }
+
+    int connectTo(const std::string &socketPath)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    std::vector<std::string> encodeOptions(const CompileOptions &options)
+    {
+        std::vector<std::string> fields = {"output=" + std::filesystem::absolute(options.resolvedOutputPath()).string(),
+                                           std::string("emit=") + emitKindName(options.emit),
+                                           "O=" + std::to_string(options.optLevel),
+                                           "eval-steps=" + std::to_string(options.evalBudget.steps),
+                                           "eval-memory=" + std::to_string(options.evalBudget.memory)};
+        if (options.printIR)
+            fields.push_back("print-ir");
+        if (options.remarks)
+            fields.push_back(options.remarkFilter.empty() ? "Rpass" : "Rpass=" + options.remarkFilter);
+        if (options.rtStats)
+            fields.push_back("rt-stats");
+        if (options.debugInfo)
+            fields.push_back("g");
+        if (!options.cpu.empty())
+            fields.push_back("mcpu=" + options.cpu);
+        if (options.multiversion)
+            fields.push_back("multiversion");
+        return fields;
+    }
+
+    // Apply one field of a COMPILE request. Returns false for one this
+    // server does not know, so that a newer client is not half obeyed.
+    bool decodeField(const std::string &field, CompileOptions &options, std::vector<std::string> &sources)
+    {
+        size_t equals = field.find('=');
+        std::string name = field.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : field.substr(equals + 1);
+        if (name == "source")
+            sources.push_back(value);
+        else if (name == "output")
+            options.outputPath = value;
+        else if (name == "emit")
+            return parseEmitKind(value, options.emit);
+        else if (name == "O")
+            options.optLevel = std::atoi(value.c_str());
+        else if (name == "print-ir")
+            options.printIR = true;
+        else if (name == "Rpass")
+        {
+            options.remarks = true;
+            options.remarkFilter = value;
+        }
+        else if (name == "rt-stats")
+            options.rtStats = true;
+        else if (name == "g")
+            options.debugInfo = true;
+        else if (name == "eval-steps")
+            options.evalBudget.steps = std::strtoull(value.c_str(), nullptr, 10);
+        else if (name == "eval-memory")
+            options.evalBudget.memory = std::strtoull(value.c_str(), nullptr, 10);
+        else if (name == "mcpu")
+            options.cpu = value;
+        else if (name == "multiversion")
+            options.multiversion = true;
+        else
+            return false;
+        return true;
+    }
+
+    // Run one compile with std::cout/std::cerr redirected into the response.
+    int compileRequest(const std::vector<std::string> &sources, const CompileOptions &options,
+                       std::string &diagnostics)
+    {
+        std::lock_guard<std::mutex> lock(compileMutex);
+
+        std::ostringstream captured;
+        std::streambuf *oldOut = std::cout.rdbuf(captured.rdbuf());
+        std::streambuf *oldErr = std::cerr.rdbuf(captured.rdbuf());
+
+        int status = sources.size() == 1 ? compileFile(sources[0].c_str(), options, nullptr)
+                                         : compileProgram(sources, options);
+
+        std::cout.rdbuf(oldOut);
+        std::cerr.rdbuf(oldErr);
+        diagnostics = captured.str();
+        return status;
+    }
+
+    std::string latencyReport()
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        if (latenciesMs.empty())
+            return "no requests served\n";
+
+        std::vector<double> sorted = latenciesMs;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](double p)
+        {
+            size_t idx = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+            return sorted[idx];
+        };
+
+        std::ostringstream out;
+        out << "requests: " << sorted.size()
+            << "  p50: " << percentile(50) << " ms"
+            << "  p90: " << percentile(90) << " ms"
+            << "  p99: " << percentile(99) << " ms"
+            << "  max: " << sorted.back() << " ms\n";
+        return out.str();
+    }
+
+    void handleConnection(int fd, int listenFd)
+    {
+        std::string request;
+        if (!readLine(fd, request))
+        {
+            close(fd);
+            return;
+        }
+
+        if (request.rfind("COMPILE ", 0) == 0)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            CompileOptions options;
+            std::vector<std::string> sources;
+            std::string diagnostics;
+            std::istringstream args(request.substr(8));
+            for (std::string field; std::getline(args, field, '\t');)
+            {
+                if (!decodeField(field, options, sources))
+                    diagnostics += "unknown compile option: " + field + "\n";
+            }
+
+            int status = 1;
+            if (sources.empty())
+                diagnostics += "no source to compile\n";
+            else if (diagnostics.empty())
+                status = compileRequest(sources, options, diagnostics);
+            sendResponse(fd, status, diagnostics);
+
+            double ms = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+            std::lock_guard<std::mutex> lock(statsMutex);
+            latenciesMs.push_back(ms);
+        }
+        else if (request == "STATS")
+        {
+            sendResponse(fd, 0, latencyReport());
+        }
+        else if (request == "SHUTDOWN")
+        {
+            sendResponse(fd, 0, "server shutting down\n");
+            shuttingDown = true;
+            shutdown(listenFd, SHUT_RDWR);
+        }
+        else
+        {
+            sendResponse(fd, 1, "unknown request: " + request + "\n");
+        }
+        close(fd);
+    }
+
+    void serveConnection(int fd, int listenFd)
+    {
+        handleConnection(fd, listenFd);
+        --activeConnections;
+    }
+}
+
+std::string defaultSocketPath()
+{
+    return "/tmp/flec-" + std::to_string(getuid()) + ".sock";
+}
+
+int runServer(const std::string &socketPath)
+{
+    // A socket a server still answers on is in use; only one left behind by
+    // a server that is gone is replaced.
+    int existing = connectTo(socketPath);
+    if (existing >= 0)
+    {
+        close(existing);
+        std::cerr << "A flec server is already listening on " << socketPath << "\n";
+        return 1;
+    }
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0)
+    {
+        std::cerr << "Could not create socket: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(listenFd, 64) != 0)
+    {
+        std::cerr << "Could not listen on " << socketPath << ": " << std::strerror(errno) << "\n";
+        close(listenFd);
+        return 1;
+    }
+
+    std::cout << "flec server listening on " << socketPath << std::endl;
+
+    while (!shuttingDown)
+    {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (shuttingDown || errno != EINTR)
+                break;
+            continue;
+        }
+        ++activeConnections;
+        std::thread(serveConnection, fd, listenFd).detach();
+    }
+
+    while (activeConnections > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    close(listenFd);
+    unlink(socketPath.c_str());
+
+    std::cout << latencyReport();
+    return 0;
+}
+
+namespace
+{
+    int sendRequest(const std::string &socketPath, const std::string &request, std::string &text)
+    {
+        int fd = connectTo(socketPath);
+        if (fd < 0)
+        {
+            std::cerr << "Could not connect to flec server at " << socketPath << "\n";
+            return 1;
+        }
+
+        std::string header;
+        if (!writeAll(fd, request + "\n") || !readLine(fd, header))
+        {
+            std::cerr << "Lost connection to flec server\n";
+            close(fd);
+            return 1;
+        }
+
+        int status = 1;
+        size_t length = 0;
+        std::istringstream(header) >> status >> length;
+        if (!readExact(fd, text, length))
+        {
+            std::cerr << "Truncated response from flec server\n";
+            status = 1;
+        }
+        close(fd);
+        return status;
+    }
+}
+
+int runClient(const std::string &socketPath, const std::vector<std::string> &sources,
+              const CompileOptions &options)
+{
+    std::string request = "COMPILE ";
+    for (const auto &source : sources)
+        request += "source=" + std::filesystem::absolute(source).string() + "\t";
+    std::vector<std::string> fields = encodeOptions(options);
+    for (size_t i = 0; i < fields.size(); ++i)
+        request += (i ? "\t" : "") + fields[i];
+
+    std::string text;
+    int status = sendRequest(socketPath, request, text);
+    std::cout << text;
+    return status;
+}
+
+int queryServer(const std::string &socketPath, const std::string &command)
+{
+    std::string text;
+    int status = sendRequest(socketPath, command, text);
+    std::cout << text;
+    return status;
+}
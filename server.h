@@ -0,0 +1,32 @@
+#pragma once
+#include "driver.h"
+#include <string>
+#include <vector>
+
+// Resident compile server. `flec --server` listens on a Unix domain socket and
+// compiles the sources named by `flec --client` requests without paying
+// process start-up and LLVM initialization for every file.
+//
+// The server compiles one request at a time. The front end and the code
+// generator keep their state in process globals (the parser, the symbol
+// table, the AST root and the source arena), so connections are accepted
+// concurrently but each compile waits for the one before it. The latencies
+// --server-stats reports include that wait. To compile in parallel, run one
+// server per --socket.
+
+// Default socket location, unique per user.
+std::string defaultSocketPath();
+
+// Serve requests until a shutdown request arrives. Returns the exit code.
+int runServer(const std::string &socketPath);
+
+// Have the server compile sources, as one program if there are several,
+// with options as if given to this process: it writes the output and
+// the diagnostics it produced, --print-ir and remarks included, are echoed
+// here. --run, --perf-map and the incremental cache stay with a local
+// compile. Returns the server's exit status.
+int runClient(const std::string &socketPath, const std::vector<std::string> &sources,
+              const CompileOptions &options);
+
+// Ask the server for its request latency percentiles, or to shut down.
+int queryServer(const std::string &socketPath, const std::string &command);
@@ -0,0 +1,122 @@
+// source.cpp
+#include "source.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <vector>
+
+namespace
+{
+    std::vector<char> buffer; // the source and its padding
+    size_t length = 0;
+
+    // The text arena: chunks are handed out front to back and kept when it
+    // is cleared, so compiling again does not allocate until a file needs
+    // more than the ones before it.
+    constexpr size_t CHUNK_SIZE = 1 << 16;
+
+    struct Chunk
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    std::vector<Chunk> chunks;
+    size_t current = 0; // the chunk being filled
+    size_t used = 0;    // bytes of it handed out
+
+    // Puts the current file's name in front of each line passed on to the
+    // buffer std::cerr had, which under the compile server is the capture
+    // sent back to the client.
+    class PrefixBuffer : public std::streambuf
+    {
+    public:
+        std::streambuf *target = nullptr;
+        std::string prefix;
+        bool lineStart = true;
+
+    protected:
+        int overflow(int c) override
+        {
+            if (c == traits_type::eof())
+                return traits_type::not_eof(c);
+            if (lineStart && target->sputn(prefix.data(), prefix.size()) != std::streamsize(prefix.size()))
+                return traits_type::eof();
+            lineStart = c == '\n';
+            return target->sputc(char(c));
+        }
+
+        int sync() override { return target->pubsync(); }
+    };
+    PrefixBuffer prefixed;
+}
+
+bool loadSource(const char *path)
+{
+    FILE *in = std::fopen(path, "rb");
+    if (!in)
+        return false;
+    buffer.clear();
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), in)) > 0)
+        buffer.insert(buffer.end(), chunk, chunk + n);
+    bool ok = !std::ferror(in);
+    std::fclose(in);
+
+    length = buffer.size();
+    buffer.resize(length + SOURCE_PADDING, '\0');
+    current = used = 0;
+    return ok;
+}
+
+std::string_view sourceText()
+{
+    return {buffer.data(), length};
+}
+
+char *allocateText(size_t size)
+{
+    while (current < chunks.size() && used + size > chunks[current].size)
+    {
+        ++current;
+        used = 0;
+    }
+    if (current == chunks.size())
+    {
+        size_t chunkSize = std::max(size, CHUNK_SIZE);
+        chunks.push_back({std::unique_ptr<char[]>(new char[chunkSize]), chunkSize});
+    }
+    char *text = chunks[current].data.get() + used;
+    used += size;
+    return text;
+}
+
+void scanSource()
+{
+    if (buffer.empty())
+        buffer.resize(SOURCE_PADDING, '\0');
+    scanBuffer(buffer.data(), length);
+}
+
+DiagnosticFile::DiagnosticFile(const std::string &path)
+{
+    if (!prefixed.target)
+    {
+        prefixed.target = std::cerr.rdbuf(&prefixed);
+        prefixed.lineStart = true;
+    }
+    previous = std::move(prefixed.prefix);
+    prefixed.prefix = path + ": ";
+}
+
+DiagnosticFile::~DiagnosticFile()
+{
+    prefixed.prefix = std::move(previous);
+    if (prefixed.prefix.empty())
+    {
+        std::cerr.rdbuf(prefixed.target);
+        prefixed.target = nullptr;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// The text of the file being compiled, and where the text of its tokens
+// lives. The scanner hands identifiers, loop hints and string literals to
+// the parser as spans of the loaded source, and the AST keeps them as
+// string_views; only a string literal with escapes is rewritten, into the
+// text arena. Both stay valid until the next loadSource.
+
+// The source is followed by this many zero bytes: flex needs two at the end
+// of a buffer it scans in place, scanner.cpp reads whole blocks past the end.
+constexpr size_t SOURCE_PADDING = 64;
+
+// A token's text. Plain data so it can be a member of the parser's value
+// union.
+struct TokenText
+{
+    const char *data;
+    uint32_t length;
+
+    std::string_view view() const { return {data, length}; }
+};
+
+// Read path as the source to compile, dropping the previous source and
+// everything in the text arena. Returns false if it cannot be read.
+bool loadSource(const char *path);
+
+std::string_view sourceText();
+
+// Uninitialized space for text that is not in the source as written,
+// released by the next loadSource.
+char *allocateText(size_t size);
+
+// Point the scanner at size bytes of text, followed by SOURCE_PADDING zero
+// bytes, and start over at line 1. Defined by the scanner (lexer.l or
+// scanner.cpp); tokens already returned must stay intact.
+void scanBuffer(char *text, size_t size);
+
+// Start scanning the loaded source.
+void scanSource();
+
+// While one is alive, every line written to std::cerr starts with "path: ",
+// so that the diagnostics of a build that reads several files say which
+// file they are about. Scopes nest: an import built while its importer is
+// being compiled names the import until it ends.
+class DiagnosticFile
+{
+public:
+    explicit DiagnosticFile(const std::string &path);
+    ~DiagnosticFile();
+
+    DiagnosticFile(const DiagnosticFile &) = delete;
+    DiagnosticFile &operator=(const DiagnosticFile &) = delete;
+
+private:
+    std::string previous; // the enclosing scope's prefix, if any
+};
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Diagnostics test: each program in tests/errors must fail to check, and the
+# `Line N: ...` diagnostics it reports must be those in its .expected file.
+# `make test` runs this from the top of the tree.
+#
+# usage: tests/diagnostics.sh [checker]
+CHECKER=${1:-./flec-check}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failed=0
+for program in tests/errors/*.flec; do
+    if "$CHECKER" "$program" >"$WORK/log" 2>&1; then
+        echo "FAIL $program: accepted"
+        failed=1
+        continue
+    fi
+    grep '^Line ' "$WORK/log" >"$WORK/diagnostics"
+    if diff -u "${program%.flec}.expected" "$WORK/diagnostics" >"$WORK/diff"; then
+        echo "ok   $program"
+    else
+        echo "FAIL $program: wrong diagnostics"
+        cat "$WORK/diff"
+        failed=1
+    fi
+done
+exit $failed
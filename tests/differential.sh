@@ -0,0 +1,45 @@
+#!/bin/sh
+# Differential test of the compile-time evaluator: every sample program is
+# compiled at -O0, where the evaluator is off, and at -O2, where it runs the
+# leading statements at compile time, and the two programs must print the
+# same output. A program with a .expected file must also print exactly that.
+# `make test` runs this from the top of the tree.
+#
+# usage: tests/differential.sh [compiler] [runtime library]
+COMPILER=${1:-./parser}
+RUNTIME=${2:-./libflecrt.so}
+LLI=${LLI:-lli}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failed=0
+for program in test.prog tests/programs/*.flec; do
+    for level in 0 2; do
+        if ! "$COMPILER" -O$level "$program" -o "$WORK/O$level.ll" >"$WORK/log" 2>&1; then
+            echo "FAIL $program: does not compile at -O$level"
+            cat "$WORK/log"
+            failed=1
+            continue 2
+        fi
+        "$LLI" -load="$RUNTIME" "$WORK/O$level.ll" >"$WORK/O$level.out" 2>&1
+        echo "exit $?" >>"$WORK/O$level.out"
+    done
+    if ! diff -u "$WORK/O0.out" "$WORK/O2.out" >"$WORK/diff"; then
+        echo "FAIL $program: -O0 and -O2 outputs differ"
+        cat "$WORK/diff"
+        failed=1
+        continue
+    fi
+    expected=${program%.*}.expected
+    if [ -f "$expected" ]; then
+        { cat "$expected"; echo "exit 0"; } >"$WORK/expected"
+        if ! diff -u "$WORK/expected" "$WORK/O0.out" >"$WORK/diff"; then
+            echo "FAIL $program: output differs from $expected"
+            cat "$WORK/diff"
+            failed=1
+            continue
+        fi
+    fi
+    echo "ok   $program"
+done
+exit $failed
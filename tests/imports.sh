@@ -0,0 +1,36 @@
+#!/bin/sh
+# Import test: each program in tests/imports is compiled twice in a scratch
+# copy of the directory, first building its libraries and then loading them
+# from the interfaces that wrote, and both must print its .expected output.
+# `make test` runs this from the top of the tree.
+#
+# usage: tests/imports.sh [compiler] [runtime library]
+COMPILER=$(realpath "${1:-./parser}")
+RUNTIME=$(realpath "${2:-./libflecrt.so}")
+LLI=${LLI:-lli}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cp -R tests/imports "$WORK/src"
+
+failed=0
+for expected in "$WORK"/src/*.expected; do
+    program=${expected%.expected}.flec
+    name=tests/imports/$(basename "$program")
+    for pass in build load; do
+        if ! "$COMPILER" "$program" -o "$WORK/out.ll" >"$WORK/log" 2>&1; then
+            echo "FAIL $name: does not compile ($pass)"
+            cat "$WORK/log"
+            failed=1
+            continue 2
+        fi
+        "$LLI" -load="$RUNTIME" "$WORK/out.ll" >"$WORK/out" 2>&1
+        if ! diff -u "$expected" "$WORK/out" >"$WORK/diff"; then
+            echo "FAIL $name: wrong output ($pass)"
+            cat "$WORK/diff"
+            failed=1
+            continue 2
+        fi
+    done
+    echo "ok   $name"
+done
+exit $failed
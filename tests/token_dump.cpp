@@ -0,0 +1,102 @@
+// token_dump.cpp
+// The token stream of a scanner, one token per line. `make tokdump` links
+// this against the flex scanner (tokdump-flex) and against each build of
+// scanner.cpp (tokdump-simd, tokdump-scalar, and tokdump-avx2 where the
+// machine has AVX2); tests/tokens.sh compares what they print.
+#include "parser.tab.h"
+#include "source.h"
+#include <cstdio>
+#include <iostream>
+
+extern "C" int yylex(void);
+extern int yylineno;
+
+// Normally defined by the parser, which is not linked in.
+YYSTYPE yylval;
+YYLTYPE yylloc;
+bool semanticError = false; // set by the scanners on an integer literal out of range
+
+namespace
+{
+    void printText(TokenText text)
+    {
+        std::cout << " \"";
+        for (char c : text.view())
+        {
+            unsigned char u = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\')
+                std::cout << '\\' << c;
+            else if (u < 0x20 || u >= 0x7f)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\x%02x", u);
+                std::cout << escaped;
+            }
+            else
+                std::cout << c;
+        }
+        std::cout << "\"";
+    }
+
+    // The value the scanner left in yylval for a token of this kind.
+    void printValue(int token)
+    {
+        switch (token)
+        {
+        case INTEGER_LITERAL:
+            std::cout << " " << yylval.ival;
+            break;
+        case FLOAT_LITERAL:
+        {
+            char text[32];
+            std::snprintf(text, sizeof(text), " %.9g", yylval.fval);
+            std::cout << text;
+            break;
+        }
+        case STRING_LITERAL:
+        case IDENTIFIER:
+        case LOOP_HINT:
+            printText(yylval.text);
+            break;
+        case CHAR_LITERAL:
+            std::cout << " " << static_cast<int>(static_cast<unsigned char>(yylval.cval));
+            break;
+        case TRUE:
+        case FALSE:
+            std::cout << " " << yylval.bval;
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <source file>...\n";
+        return 1;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!loadSource(argv[i]))
+        {
+            std::cerr << "Could not open file: " << argv[i] << "\n";
+            return 1;
+        }
+        scanSource();
+        semanticError = false;
+
+        std::cout << argv[i] << ":\n";
+        for (int token; (token = yylex()) != 0;)
+        {
+            // Flush so that the scanners' diagnostics on stderr stay in place
+            // when both streams go to the same file.
+            std::cout << yylloc.first_line << " " << token;
+            printValue(token);
+            std::cout << std::endl;
+        }
+        std::cout << "end at line " << yylineno << (semanticError ? ", with errors" : "") << std::endl;
+    }
+    return 0;
+}
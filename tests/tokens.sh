@@ -0,0 +1,40 @@
+#!/bin/sh
+# Token-stream test of the scanners: the flex scanner from lexer.l and
+# scanner.cpp must produce the same tokens, values, lines and diagnostics for
+# the lexer edge cases and sample programs. `make tokdump` builds the dumpers
+# and `make test` runs this from the top of the tree.
+#
+# usage: tests/tokens.sh [reference dumper] [dumper]...
+# Every dumper named must have been built: a missing one fails the test
+# rather than passing it untested. The AVX2 dumper is only built, and only
+# named by default, on a machine that has AVX2.
+REFERENCE=${1:-./tokdump-flex}
+[ $# -gt 0 ] && shift
+if [ $# -eq 0 ]; then
+    set -- ./tokdump-simd ./tokdump-scalar
+    grep -qw avx2 /proc/cpuinfo 2>/dev/null && set -- "$@" ./tokdump-avx2
+fi
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+INPUTS="tests/lexer/*.flec tests/programs/*.flec *.prog"
+[ -x "$REFERENCE" ] || { echo "FAIL $REFERENCE: not built"; exit 1; }
+"$REFERENCE" $INPUTS >"$WORK/reference" 2>&1 || { echo "FAIL $REFERENCE"; cat "$WORK/reference"; exit 1; }
+
+failed=0
+for dumper in "$@"; do
+    if [ ! -x "$dumper" ]; then
+        echo "FAIL $dumper: not built"
+        failed=1
+        continue
+    fi
+    "$dumper" $INPUTS >"$WORK/tokens" 2>&1
+    if diff -u "$WORK/reference" "$WORK/tokens" >"$WORK/diff"; then
+        echo "ok   $dumper"
+    else
+        echo "FAIL $dumper: tokens differ from $REFERENCE"
+        head -40 "$WORK/diff"
+        failed=1
+    fi
+done
+exit $failed
@@ -0,0 +1,120 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Flec integer types: int8/int16/int/int64 and uint8/uint16/uint32/uint64.
+// `int32` is spelled `int` internally. Shared by analysis and codegen, so it
+// must not depend on LLVM.
+
+struct IntTypeInfo
+{
+    unsigned bits = 0; // 0 when the name is not an integer type
+    bool isSigned = true;
+};
+
+inline IntTypeInfo intTypeInfo(std::string_view type)
+{
+    if (type == "int8")
+        return {8, true};
+    if (type == "int16")
+        return {16, true};
+    if (type == "int" || type == "int32")
+        return {32, true};
+    if (type == "int64")
+        return {64, true};
+    if (type == "uint8")
+        return {8, false};
+    if (type == "uint16")
+        return {16, false};
+    if (type == "uint32")
+        return {32, false};
+    if (type == "uint64")
+        return {64, false};
+    return {};
+}
+
+inline bool isIntegerType(std::string_view type)
+{
+    return intTypeInfo(type).bits != 0;
+}
+
+inline bool isNumericType(std::string_view type)
+{
+    return isIntegerType(type) || type == "float";
+}
+
+inline std::string intTypeName(unsigned bits, bool isSigned)
+{
+    if (bits == 32 && isSigned)
+        return "int";
+    return (isSigned ? "int" : "uint") + std::to_string(bits);
+}
+
+// Common type of a binary operation on two integer types: the narrowest one
+// that holds every value of both. Of the same signedness that is the wider
+// type; an unsigned operand with a signed one takes a signed type wider than
+// the unsigned one, so `uint8 200 > int8 -1` holds, unlike under C's usual
+// arithmetic conversions. Empty for uint64 with a signed type, which no type
+// holds.
+inline std::string promoteIntTypes(std::string_view a, std::string_view b)
+{
+    IntTypeInfo x = intTypeInfo(a);
+    IntTypeInfo y = intTypeInfo(b);
+    if (x.isSigned == y.isSigned)
+        return intTypeName(x.bits > y.bits ? x.bits : y.bits, x.isSigned);
+    IntTypeInfo u = x.isSigned ? y : x;
+    IntTypeInfo s = x.isSigned ? x : y;
+    if (s.bits > u.bits)
+        return intTypeName(s.bits, true);
+    if (u.bits == 64)
+        return "";
+    return intTypeName(u.bits * 2, true);
+}
+
+// Whether a value of type `from` may be stored into `to` without a cast:
+// only conversions that preserve every value are implicit.
+inline bool isImplicitlyConvertible(std::string_view from, std::string_view to)
+{
+    if (from == to)
+        return true;
+    IntTypeInfo f = intTypeInfo(from);
+    IntTypeInfo t = intTypeInfo(to);
+    if (!f.bits || !t.bits)
+        return false;
+    if (f.isSigned == t.isSigned)
+        return t.bits >= f.bits;
+    return !f.isSigned && t.isSigned && t.bits > f.bits;
+}
+
+// Whether the integer constant (negative ? -magnitude : magnitude) fits type.
+inline bool integerFits(bool negative, unsigned long long magnitude, std::string_view type)
+{
+    IntTypeInfo info = intTypeInfo(type);
+    if (!info.bits)
+        return false;
+    if (!info.isSigned)
+    {
+        if (negative && magnitude != 0)
+            return false;
+        return info.bits == 64 || magnitude < (1ULL << info.bits);
+    }
+    unsigned long long limit = 1ULL << (info.bits - 1);
+    return negative ? magnitude <= limit : magnitude < limit;
+}
+
+// Generators: `gen g { yield ... }` gives g the type "gen<T>" where T is the
+// type of the values it yields.
+inline std::string generatorType(std::string_view elementType)
+{
+    return "gen<" + std::string(elementType) + ">";
+}
+
+inline bool isGeneratorType(std::string_view type)
+{
+    return type.compare(0, 4, "gen<") == 0 && type.back() == '>';
+}
+
+inline std::string generatorElementType(std::string_view type)
+{
+    return isGeneratorType(type) ? std::string(type.substr(4, type.size() - 5)) : std::string();
+}